@@ -47,6 +47,25 @@ class _cr_rparam(IntEnum):
 	output_filetype = 14
 	node_list = 15
 	blender_mode = 16
+	is_progressive = 17
+	time_limit_ms = 18
+	# float
+	noise_threshold = 19
+	# str
+	sampler = 20
+	# num
+	path_guiding = 21
+	denoise = 22
+	diffuse_bounces = 23
+	glossy_bounces = 24
+	transmission_bounces = 25
+	rr_start_depth = 26
+	# float
+	rr_min_probability = 27
+	indirect_clamp = 28
+	# num
+	median_of_means = 29
+	sort_shading = 30
 
 def _r_set_num(ptr, param, value):
 	return _lib.renderer_set_num_pref(ptr, param, value)
@@ -54,6 +73,12 @@ def _r_set_num(ptr, param, value):
 def _r_get_num(ptr, param):
 	return _lib.renderer_get_num_pref(ptr, param)
 
+def _r_set_float(ptr, param, value):
+	return _lib.renderer_set_float_pref(ptr, param, value)
+
+def _r_get_float(ptr, param):
+	return _lib.renderer_get_float_pref(ptr, param)
+
 def _r_set_str(ptr, param, value):
 	return _lib.renderer_set_str_pref(ptr, param, value)
 
@@ -211,6 +236,90 @@ class _pref:
 		_r_set_num(self.r_ptr, _cr_rparam.blender_mode, value)
 	blender_mode = property(_get_blender_mode, _set_blender_mode, None, "")
 
+	def _get_is_progressive(self):
+		return _r_get_num(self.r_ptr, _cr_rparam.is_progressive)
+	def _set_is_progressive(self, value):
+		_r_set_num(self.r_ptr, _cr_rparam.is_progressive, value)
+	is_progressive = property(_get_is_progressive, _set_is_progressive, None, "Render every tile one sample at a time before the next")
+
+	def _get_time_limit_ms(self):
+		return _r_get_num(self.r_ptr, _cr_rparam.time_limit_ms)
+	def _set_time_limit_ms(self, value):
+		_r_set_num(self.r_ptr, _cr_rparam.time_limit_ms, value)
+	time_limit_ms = property(_get_time_limit_ms, _set_time_limit_ms, None, "Wall-clock budget for a render in milliseconds, 0 = no limit")
+
+	def _get_noise_threshold(self):
+		return _r_get_float(self.r_ptr, _cr_rparam.noise_threshold)
+	def _set_noise_threshold(self, value):
+		_r_set_float(self.r_ptr, _cr_rparam.noise_threshold, value)
+	noise_threshold = property(_get_noise_threshold, _set_noise_threshold, None, "Relative error at which pixel blocks stop sampling, 0 = off")
+
+	def _get_sampler(self):
+		return _r_get_str(self.r_ptr, _cr_rparam.sampler)
+	def _set_sampler(self, value):
+		_r_set_str(self.r_ptr, _cr_rparam.sampler, value)
+	sampler = property(_get_sampler, _set_sampler, None, "Sampling pattern: halton, hammersley, random or sobol")
+
+	def _get_path_guiding(self):
+		return _r_get_num(self.r_ptr, _cr_rparam.path_guiding)
+	def _set_path_guiding(self, value):
+		_r_set_num(self.r_ptr, _cr_rparam.path_guiding, value)
+	path_guiding = property(_get_path_guiding, _set_path_guiding, None, "Learn incident light during the render, and guide diffuse bounces with it")
+
+	def _get_denoise(self):
+		return _r_get_num(self.r_ptr, _cr_rparam.denoise)
+	def _set_denoise(self, value):
+		_r_set_num(self.r_ptr, _cr_rparam.denoise, value)
+	denoise = property(_get_denoise, _set_denoise, None, "Filter the finished render with albedo and normal buffers")
+
+	def _get_diffuse_bounces(self):
+		return _r_get_num(self.r_ptr, _cr_rparam.diffuse_bounces)
+	def _set_diffuse_bounces(self, value):
+		_r_set_num(self.r_ptr, _cr_rparam.diffuse_bounces, value)
+	diffuse_bounces = property(_get_diffuse_bounces, _set_diffuse_bounces, None, "Max diffuse bounces, 0 = only bounces applies")
+
+	def _get_glossy_bounces(self):
+		return _r_get_num(self.r_ptr, _cr_rparam.glossy_bounces)
+	def _set_glossy_bounces(self, value):
+		_r_set_num(self.r_ptr, _cr_rparam.glossy_bounces, value)
+	glossy_bounces = property(_get_glossy_bounces, _set_glossy_bounces, None, "Max glossy bounces, 0 = only bounces applies")
+
+	def _get_transmission_bounces(self):
+		return _r_get_num(self.r_ptr, _cr_rparam.transmission_bounces)
+	def _set_transmission_bounces(self, value):
+		_r_set_num(self.r_ptr, _cr_rparam.transmission_bounces, value)
+	transmission_bounces = property(_get_transmission_bounces, _set_transmission_bounces, None, "Max transmission bounces, 0 = only bounces applies")
+
+	def _get_rr_start_depth(self):
+		return _r_get_num(self.r_ptr, _cr_rparam.rr_start_depth)
+	def _set_rr_start_depth(self, value):
+		_r_set_num(self.r_ptr, _cr_rparam.rr_start_depth, value)
+	rr_start_depth = property(_get_rr_start_depth, _set_rr_start_depth, None, "Bounce Russian roulette starts on")
+
+	def _get_rr_min_probability(self):
+		return _r_get_float(self.r_ptr, _cr_rparam.rr_min_probability)
+	def _set_rr_min_probability(self, value):
+		_r_set_float(self.r_ptr, _cr_rparam.rr_min_probability, value)
+	rr_min_probability = property(_get_rr_min_probability, _set_rr_min_probability, None, "Lowest probability Russian roulette lets a path survive with, above 0 and at most 1")
+
+	def _get_indirect_clamp(self):
+		return _r_get_float(self.r_ptr, _cr_rparam.indirect_clamp)
+	def _set_indirect_clamp(self, value):
+		_r_set_float(self.r_ptr, _cr_rparam.indirect_clamp, value)
+	indirect_clamp = property(_get_indirect_clamp, _set_indirect_clamp, None, "Max luminance one sample of indirect light can add, 0 = off")
+
+	def _get_median_of_means(self):
+		return _r_get_num(self.r_ptr, _cr_rparam.median_of_means)
+	def _set_median_of_means(self, value):
+		_r_set_num(self.r_ptr, _cr_rparam.median_of_means, value)
+	median_of_means = property(_get_median_of_means, _set_median_of_means, None, "Use the median of batch means per pixel, which leaves out single fireflies")
+
+	def _get_sort_shading(self):
+		return _r_get_num(self.r_ptr, _cr_rparam.sort_shading)
+	def _set_sort_shading(self, value):
+		_r_set_num(self.r_ptr, _cr_rparam.sort_shading, value)
+	sort_shading = property(_get_sort_shading, _set_sort_shading, None, "Experimental, off by default. Trace tiles a bounce at a time, and shade hits grouped by material. Currently slower on the bundled scenes")
+
 class _version:
 	def _get_semantic(self):
 		return _lib.get_version()
@@ -187,7 +187,7 @@ static PyObject *py_cr_renderer_get_num_pref(PyObject *self, PyObject *args) {
 	if (!PyArg_ParseTuple(args, "OI", &r_ext, &p)) {
 		return NULL;
 	}
-	if (p > cr_renderer_is_iterative) {
+	if (p >= cr_renderer_output_path && p <= cr_renderer_node_list) {
 		PyErr_SetString(PyExc_ValueError, "cr_renderer_param not a number type");
 		return NULL;
 	}
@@ -196,6 +196,32 @@ static PyObject *py_cr_renderer_get_num_pref(PyObject *self, PyObject *args) {
 	return PyLong_FromUnsignedLong(ret);
 }
 
+static PyObject *py_cr_renderer_set_float_pref(PyObject *self, PyObject *args) {
+	(void)self; (void)args;
+	PyObject *r_ext;
+	enum cr_renderer_param p;
+	double num;
+
+	if (!PyArg_ParseTuple(args, "OId", &r_ext, &p, &num)) {
+		return NULL;
+	}
+	struct cr_renderer *r = PyCapsule_GetPointer(r_ext, "cray.cr_renderer");
+	bool ret = cr_renderer_set_float_pref(r, p, num);
+	return PyBool_FromLong(ret);
+}
+
+static PyObject *py_cr_renderer_get_float_pref(PyObject *self, PyObject *args) {
+	(void)self; (void)args;
+	PyObject *r_ext;
+	enum cr_renderer_param p;
+	if (!PyArg_ParseTuple(args, "OI", &r_ext, &p)) {
+		return NULL;
+	}
+	struct cr_renderer *r = PyCapsule_GetPointer(r_ext, "cray.cr_renderer");
+	double ret = cr_renderer_get_float_pref(r, p);
+	return PyFloat_FromDouble(ret);
+}
+
 static PyObject *py_cr_renderer_get_result(PyObject *self, PyObject *args) {
 	(void)self;
 	PyObject *r_ext;
@@ -683,6 +709,8 @@ static PyMethodDef cray_methods[] = {
 	{ "renderer_toggle_pause", py_cr_renderer_toggle_pause, METH_VARARGS, "" },
 	{ "renderer_get_str_pref", py_cr_renderer_get_str_pref, METH_VARARGS, "" },
 	{ "renderer_get_num_pref", py_cr_renderer_get_num_pref, METH_VARARGS, "" },
+	{ "renderer_set_float_pref", py_cr_renderer_set_float_pref, METH_VARARGS, "" },
+	{ "renderer_get_float_pref", py_cr_renderer_get_float_pref, METH_VARARGS, "" },
 	{ "renderer_get_result", py_cr_renderer_get_result, METH_VARARGS, "" },
 	{ "renderer_render", py_cr_renderer_render, METH_VARARGS, "" },
 	{ "renderer_start_interactive", py_cr_renderer_start_interactive, METH_VARARGS, "" },
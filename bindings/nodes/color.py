@@ -110,6 +110,12 @@ class _color_arg_color_ramp(ct.Structure):
 		("element_count", ct.c_int)
 	]
 
+class _color_arg_cache(ct.Structure):
+	_fields_ = [
+		("color", ct.POINTER(_color)),
+		("resolution", ct.c_int)
+	]
+
 class _color_arg(ct.Union):
 	_fields_ = [
 		("constant", cr_color),
@@ -125,6 +131,7 @@ class _color_arg(ct.Union):
 		("gradient", _color_arg_gradient),
 		("color_mix", _color_arg_color_mix),
 		("color_ramp", _color_arg_color_ramp),
+		("cache", _color_arg_cache),
 	]
 
 class _color_type(IntEnum):
@@ -142,6 +149,7 @@ class _color_type(IntEnum):
 	gradient     = 11
 	color_mix    = 12
 	color_ramp   = 13
+	cache        = 14
 
 _color._anonymous_ = ("arg",)
 _color._fields_ = [
@@ -265,3 +273,11 @@ class NodeColorRamp(NodeColorBase):
 		self.elements = (ramp_element * len(elements))(*elements)
 		self.element_count = len(elements)
 		self.cr_struct.color_ramp = _color_arg_color_ramp(self.factor.castref(), self.color_mode, self.interpolation, self.elements, self.element_count)
+
+class NodeColorCache(NodeColorBase):
+	def __init__(self, color, resolution=0):
+		super().__init__()
+		self.color = color
+		self.resolution = resolution
+		self.cr_struct.type = _color_type.cache
+		self.cr_struct.cache = _color_arg_cache(self.color.castref(), self.resolution)
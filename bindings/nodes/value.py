@@ -100,6 +100,12 @@ class _value_arg_grayscale(ct.Structure):
 		("color", ct.POINTER(_color))
 	]
 
+class _value_arg_cache(ct.Structure):
+	_fields_ = [
+		("value", ct.POINTER(_value)),
+		("resolution", ct.c_int)
+	]
+
 class _value_arg(ct.Union):
 	_fields_ = [
 		("constant", ct.c_double),
@@ -109,7 +115,8 @@ class _value_arg(ct.Union):
 		("alpha", _value_arg_alpha),
 		("vec_to_value", _value_arg_vec_to_value),
 		("math", _value_arg_math),
-		("grayscale", _value_arg_grayscale)
+		("grayscale", _value_arg_grayscale),
+		("cache", _value_arg_cache)
 	]
 
 class _value_type(IntEnum):
@@ -122,6 +129,7 @@ class _value_type(IntEnum):
 	vec_to_value = 6
 	math         = 7
 	grayscale    = 8
+	cache        = 9
 
 _value._anonymous_ = ("arg",)
 _value._fields_ = [
@@ -209,3 +217,11 @@ class NodeValueGrayscale(NodeValueBase):
 		self.color = color
 		self.cr_struct.type = _value_type.grayscale
 		self.cr_struct.grayscale = _value_arg_grayscale(self.color.castref())
+
+class NodeValueCache(NodeValueBase):
+	def __init__(self, value, resolution=0):
+		super().__init__()
+		self.value = value
+		self.resolution = resolution
+		self.cr_struct.type = _value_type.cache
+		self.cr_struct.cache = _value_arg_cache(self.value.castref(), self.resolution)
@@ -63,6 +63,25 @@ enum cr_renderer_param {
 	cr_renderer_output_filetype,
 	cr_renderer_node_list,
 	cr_renderer_blender_mode,
+	cr_renderer_is_progressive,
+	cr_renderer_time_limit_ms,
+	// Float
+	cr_renderer_noise_threshold,
+	// String
+	cr_renderer_sampler, // "halton", "hammersley", "random" or "sobol"
+	// Num
+	cr_renderer_path_guiding,
+	cr_renderer_denoise,
+	cr_renderer_diffuse_bounces, // 0 = only cr_renderer_bounces applies
+	cr_renderer_glossy_bounces,
+	cr_renderer_transmission_bounces,
+	cr_renderer_rr_start_depth,
+	// Float
+	cr_renderer_rr_min_probability,
+	cr_renderer_indirect_clamp, // 0 = off
+	// Num
+	cr_renderer_median_of_means,
+	cr_renderer_sort_shading, // Experimental, off by default. Slower than plain path tracing on the bundled scenes
 };
 
 enum cr_tile_state {
@@ -119,6 +138,8 @@ CR_EXPORT void cr_renderer_restart_interactive(struct cr_renderer *ext);
 CR_EXPORT void cr_renderer_toggle_pause(struct cr_renderer *ext);
 CR_EXPORT const char *cr_renderer_get_str_pref(struct cr_renderer *ext, enum cr_renderer_param p);
 CR_EXPORT uint64_t cr_renderer_get_num_pref(struct cr_renderer *ext, enum cr_renderer_param p);
+CR_EXPORT bool cr_renderer_set_float_pref(struct cr_renderer *ext, enum cr_renderer_param p, double num);
+CR_EXPORT double cr_renderer_get_float_pref(struct cr_renderer *ext, enum cr_renderer_param p);
 
 struct cr_bitmap {
 	enum cr_bm_colorspace {
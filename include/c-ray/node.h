@@ -65,6 +65,7 @@ struct cr_value_node {
 		cr_vn_vec_to_value,
 		cr_vn_math,
 		cr_vn_grayscale,
+		cr_vn_cache,
 	} type;
 
 	union {
@@ -117,6 +118,12 @@ struct cr_value_node {
 			struct cr_color_node *color;
 		} grayscale;
 
+		// Evaluate value once per shading point, see cr_color_cache_params
+		struct cr_value_cache_params {
+			struct cr_value_node *value;
+			int resolution;
+		} cache;
+
 	} arg;
 };
 
@@ -138,6 +145,7 @@ struct cr_color_node {
 		cr_cn_gradient,
 		cr_cn_color_mix,
 		cr_cn_color_ramp,
+		cr_cn_cache,
 	} type;
 
 	union {
@@ -227,6 +235,13 @@ struct cr_color_node {
 
 			int element_count;
 		} color_ramp;
+
+		// Evaluate color once per instance, primitive, and UV rounded to 1/resolution (0 = default),
+		// and reuse the result for later hits there. For expensive inputs that don't use the sampler.
+		struct cr_color_cache_params {
+			struct cr_color_node *color;
+			int resolution;
+		} cache;
 	} arg;
 };
 
@@ -93,6 +93,29 @@ void parse_prefs(struct cr_renderer *ext, const cJSON *data) {
 	if (cJSON_IsNumber(bounces) && bounces->valueint >= 0)
 		cr_renderer_set_num_pref(ext, cr_renderer_bounces, bounces->valueint);
 
+	const cJSON *diffuse_bounces = cJSON_GetObjectItem(data, "diffuseBounces");
+	if (cJSON_IsNumber(diffuse_bounces) && diffuse_bounces->valueint >= 0)
+		cr_renderer_set_num_pref(ext, cr_renderer_diffuse_bounces, diffuse_bounces->valueint);
+
+	const cJSON *glossy_bounces = cJSON_GetObjectItem(data, "glossyBounces");
+	if (cJSON_IsNumber(glossy_bounces) && glossy_bounces->valueint >= 0)
+		cr_renderer_set_num_pref(ext, cr_renderer_glossy_bounces, glossy_bounces->valueint);
+
+	const cJSON *transmission_bounces = cJSON_GetObjectItem(data, "transmissionBounces");
+	if (cJSON_IsNumber(transmission_bounces) && transmission_bounces->valueint >= 0)
+		cr_renderer_set_num_pref(ext, cr_renderer_transmission_bounces, transmission_bounces->valueint);
+
+	const cJSON *rr_start_depth = cJSON_GetObjectItem(data, "rouletteStartDepth");
+	if (cJSON_IsNumber(rr_start_depth) && rr_start_depth->valueint >= 0)
+		cr_renderer_set_num_pref(ext, cr_renderer_rr_start_depth, rr_start_depth->valueint);
+
+	const cJSON *rr_min_probability = cJSON_GetObjectItem(data, "rouletteMinProbability");
+	if (cJSON_IsNumber(rr_min_probability)) {
+		if (!cr_renderer_set_float_pref(ext, cr_renderer_rr_min_probability, rr_min_probability->valuedouble)) {
+			logr(warning, "rouletteMinProbability must be above 0 and at most 1, using the default\n");
+		}
+	}
+
 	const cJSON *tile_width = cJSON_GetObjectItem(data, "tileWidth");
 	if (cJSON_IsNumber(tile_width) && tile_width->valueint > 0)
 		cr_renderer_set_num_pref(ext, cr_renderer_tile_width, tile_width->valueint);
@@ -106,6 +129,53 @@ void parse_prefs(struct cr_renderer *ext, const cJSON *data) {
 		cr_renderer_set_str_pref(ext, cr_renderer_tile_order, tile_order->valuestring);
 	}
 
+	const cJSON *sampler = cJSON_GetObjectItem(data, "sampler");
+	if (cJSON_IsString(sampler)) {
+		if (!cr_renderer_set_str_pref(ext, cr_renderer_sampler, sampler->valuestring)) {
+			logr(warning, "Unknown sampler \"%s\", using the default\n", sampler->valuestring);
+		}
+	}
+
+	const cJSON *progressive = cJSON_GetObjectItem(data, "progressive");
+	if (cJSON_IsBool(progressive)) {
+		cr_renderer_set_num_pref(ext, cr_renderer_is_progressive, cJSON_IsTrue(progressive));
+	}
+
+	const cJSON *path_guiding = cJSON_GetObjectItem(data, "pathGuiding");
+	if (cJSON_IsBool(path_guiding)) {
+		cr_renderer_set_num_pref(ext, cr_renderer_path_guiding, cJSON_IsTrue(path_guiding));
+	}
+
+	const cJSON *denoise = cJSON_GetObjectItem(data, "denoise");
+	if (cJSON_IsBool(denoise)) {
+		cr_renderer_set_num_pref(ext, cr_renderer_denoise, cJSON_IsTrue(denoise));
+	}
+
+	const cJSON *median_of_means = cJSON_GetObjectItem(data, "medianOfMeans");
+	if (cJSON_IsBool(median_of_means)) {
+		cr_renderer_set_num_pref(ext, cr_renderer_median_of_means, cJSON_IsTrue(median_of_means));
+	}
+
+	const cJSON *sort_shading = cJSON_GetObjectItem(data, "sortShading");
+	if (cJSON_IsBool(sort_shading)) {
+		cr_renderer_set_num_pref(ext, cr_renderer_sort_shading, cJSON_IsTrue(sort_shading));
+	}
+
+	const cJSON *indirect_clamp = cJSON_GetObjectItem(data, "indirectClamp");
+	if (cJSON_IsNumber(indirect_clamp) && indirect_clamp->valuedouble >= 0.0) {
+		cr_renderer_set_float_pref(ext, cr_renderer_indirect_clamp, indirect_clamp->valuedouble);
+	}
+
+	const cJSON *time_limit = cJSON_GetObjectItem(data, "timeLimitMs");
+	if (cJSON_IsNumber(time_limit) && time_limit->valuedouble >= 0) {
+		cr_renderer_set_num_pref(ext, cr_renderer_time_limit_ms, (uint64_t)time_limit->valuedouble);
+	}
+
+	const cJSON *noise_threshold = cJSON_GetObjectItem(data, "noiseThreshold");
+	if (cJSON_IsNumber(noise_threshold) && noise_threshold->valuedouble >= 0.0) {
+		cr_renderer_set_float_pref(ext, cr_renderer_noise_threshold, noise_threshold->valuedouble);
+	}
+
 	const cJSON *file_path = cJSON_GetObjectItem(data, "outputFilePath");
 	if (cJSON_IsString(file_path)) {
 		cr_renderer_set_str_pref(ext, cr_renderer_output_path, file_path->valuestring);
@@ -153,6 +153,15 @@ struct cr_value_node *cr_value_node_build(const struct cJSON *node) {
 			}
 		});
 	}
+	if (stringEquals(type->valuestring, "cache")) {
+		return vn_alloc((struct cr_value_node){
+			.type = cr_vn_cache,
+			.arg.cache = {
+				.value = cr_value_node_build(cJSON_GetObjectItem(node, "value")),
+				.resolution = cJSON_GetNumberValue(cJSON_GetObjectItem(node, "resolution"))
+			}
+		});
+	}
 	return vn_alloc((struct cr_value_node){
 		.type = cr_vn_grayscale,
 		.arg.grayscale.color = cr_color_node_build(cJSON_GetObjectItem(node, "color"))
@@ -191,6 +200,9 @@ void cr_value_node_free(struct cr_value_node *d) {
 			break;
 		case cr_vn_grayscale:
 			cr_color_node_free(d->arg.grayscale.color);
+			break;
+		case cr_vn_cache:
+			cr_value_node_free(d->arg.cache.value);
 	}
 	free(d);
 }
@@ -421,6 +433,15 @@ struct cr_color_node *cr_color_node_build(const struct cJSON *desc) {
 				}
 			});
 		}
+		if (stringEquals(type->valuestring, "cache")) {
+			return cn_alloc((struct cr_color_node){
+				.type = cr_cn_cache,
+				.arg.cache = {
+					.color = cr_color_node_build(cJSON_GetObjectItem(desc, "color")),
+					.resolution = cJSON_GetNumberValue(cJSON_GetObjectItem(desc, "resolution"))
+				}
+			});
+		}
 	}
 
 	logr(warning, "Failed to parse textureNode. Here's a dump:\n");
@@ -491,6 +512,9 @@ void cr_color_node_free(struct cr_color_node *d) {
 			cr_value_node_free(d->arg.color_ramp.factor);
 			if (d->arg.color_ramp.elements)
 				free(d->arg.color_ramp.elements);
+			break;
+		case cr_cn_cache:
+			cr_color_node_free(d->arg.cache.color);
 	}
 	free(d);
 }
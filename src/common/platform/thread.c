@@ -146,3 +146,20 @@ int thread_cond_broadcast(struct cr_cond *cond) {
 	return pthread_cond_broadcast(&cond->cond);
 #endif
 }
+
+#ifdef WINDOWS
+static BOOL CALLBACK once_stub(PINIT_ONCE once, PVOID param, PVOID *ctx) {
+	(void)once;
+	(void)ctx;
+	((void (*)(void))param)();
+	return TRUE;
+}
+#endif
+
+void thread_once(struct cr_once *once, void (*fn)(void)) {
+#ifdef WINDOWS
+	InitOnceExecuteOnce(&once->once, once_stub, (PVOID)fn, NULL);
+#else
+	pthread_once(&once->once, fn);
+#endif
+}
@@ -42,6 +42,21 @@ struct cr_cond {
 #endif
 };
 
+// For one-time setup of data shared by all threads, initialize with CR_ONCE_INIT
+struct cr_once {
+#ifdef WINDOWS
+	INIT_ONCE once;
+#else
+	pthread_once_t once;
+#endif
+};
+
+#ifdef WINDOWS
+	#define CR_ONCE_INIT { INIT_ONCE_STATIC_INIT }
+#else
+	#define CR_ONCE_INIT { PTHREAD_ONCE_INIT }
+#endif
+
 typedef struct cr_thread cr_thread;
 dyn_array_def(cr_thread)
 
@@ -68,3 +83,7 @@ int thread_cond_timed_wait(struct cr_cond *cond, struct cr_mutex *mutex, const s
 int thread_cond_signal(struct cr_cond *cond);
 
 int thread_cond_broadcast(struct cr_cond *cond);
+
+/// Run fn exactly once for a given once, no matter how many threads get here at the same time.
+/// Callers return after fn has finished.
+void thread_once(struct cr_once *once, void (*fn)(void));
@@ -6,6 +6,8 @@
 //  Copyright © 2024 Valtteri Koskivuori. All rights reserved.
 //
 
+#pragma once
+
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -11,6 +11,7 @@
 #include "texture.h"
 #include "logging.h"
 #include "assert.h"
+#include "platform/thread.h"
 #include <string.h>
 
 //General-purpose setPixel function
@@ -30,7 +31,11 @@ void setPixel(struct texture *t, struct color c, size_t x, size_t y) {
 	}
 }
 
-static struct color textureGetPixelInternal(const struct texture *t, size_t x, size_t y) {
+static inline float byteToFloat(unsigned char value, const float *lut) {
+	return lut ? lut[value] : value / 255.0f;
+}
+
+static struct color textureGetPixelInternal(const struct texture *t, size_t x, size_t y, const float *lut) {
 	struct color output = {0.0f, 0.0f, 0.0f, 0.0f};
 	x = x % t->width;
 	y = y % t->height;
@@ -42,7 +47,7 @@ static struct color textureGetPixelInternal(const struct texture *t, size_t x, s
 			output.blue  = output.red;
 			output.alpha = 1.0f;
 		} else {
-			output.red =   t->data.byte_p[(x + ((t->height - 1) - y) * t->width) * t->channels] / 255.0f;
+			output.red =   byteToFloat(t->data.byte_p[(x + ((t->height - 1) - y) * t->width) * t->channels], lut);
 			output.green = output.red;
 			output.blue =  output.red;
 			output.alpha = 1.0f;
@@ -54,31 +59,140 @@ static struct color textureGetPixelInternal(const struct texture *t, size_t x, s
 			output.blue  = t->data.float_p[(x + ((t->height - 1) - y) * t->width) * t->channels + 2];
 			output.alpha = t->channels > 3 ? t->data.float_p[(x + ((t->height - 1) - y) * t->width) * t->channels + 3] : 1.0f;
 		} else {
-			output.red =   t->data.byte_p[(x + ((t->height - 1) - y) * t->width) * t->channels + 0] / 255.0f;
-			output.green = t->data.byte_p[(x + ((t->height - 1) - y) * t->width) * t->channels + 1] / 255.0f;
-			output.blue =  t->data.byte_p[(x + ((t->height - 1) - y) * t->width) * t->channels + 2] / 255.0f;
+			output.red =   byteToFloat(t->data.byte_p[(x + ((t->height - 1) - y) * t->width) * t->channels + 0], lut);
+			output.green = byteToFloat(t->data.byte_p[(x + ((t->height - 1) - y) * t->width) * t->channels + 1], lut);
+			output.blue =  byteToFloat(t->data.byte_p[(x + ((t->height - 1) - y) * t->width) * t->channels + 2], lut);
 			output.alpha = t->channels > 3 ? t->data.byte_p[(x + ((t->height - 1) - y) * t->width) * t->channels + 3] / 255.0f : 1.0f;
 		}
 	}
 	return output;
 }
 
-//FIXME: This API is confusing. The semantic meaning of x and y change completely based on the filtered flag.
-struct color textureGetPixel(const struct texture *t, float x, float y, bool filtered) {
-	if (!filtered) return textureGetPixelInternal(t, (size_t)x, (size_t)y);
+static struct color textureGetPixelFiltered(const struct texture *t, float x, float y, const float *lut) {
 	x = x * t->width;
 	y = y * t->height;
 	float xcopy = x - 0.5f;
 	float ycopy = y - 0.5f;
 	int xint = (int)xcopy;
 	int yint = (int)ycopy;
-	struct color topleft = textureGetPixelInternal(t, xint, yint);
-	struct color topright = textureGetPixelInternal(t, xint + 1, yint);
-	struct color botleft = textureGetPixelInternal(t, xint, yint + 1);
-	struct color botright = textureGetPixelInternal(t, xint + 1, yint + 1);
+	struct color topleft = textureGetPixelInternal(t, xint, yint, lut);
+	struct color topright = textureGetPixelInternal(t, xint + 1, yint, lut);
+	struct color botleft = textureGetPixelInternal(t, xint, yint + 1, lut);
+	struct color botright = textureGetPixelInternal(t, xint + 1, yint + 1, lut);
 	return colorLerp(colorLerp(topleft, topright, xcopy - xint), colorLerp(botleft, botright, xcopy - xint), ycopy - yint);
 }
 
+//FIXME: This API is confusing. The semantic meaning of x and y change completely based on the filtered flag.
+struct color textureGetPixel(const struct texture *t, float x, float y, bool filtered) {
+	if (!filtered) return textureGetPixelInternal(t, (size_t)x, (size_t)y, NULL);
+	return textureGetPixelFiltered(t, x, y, NULL);
+}
+
+struct color textureGetPixelLUT(const struct texture *t, float x, float y, bool filtered, const float *lut) {
+	if (!filtered) return textureGetPixelInternal(t, (size_t)x, (size_t)y, lut);
+	return textureGetPixelFiltered(t, x, y, lut);
+}
+
+static inline const struct texture *mip_level(const struct texture *t, size_t level) {
+	return level ? &t->mips[level - 1] : t;
+}
+
+struct color textureGetPixelLOD(const struct texture *t, float x, float y, float lod, bool filtered, const float *lut) {
+	if (!filtered) {
+		const size_t level = lod > 0.0f ? min((size_t)(lod + 0.5f), t->mip_count) : 0;
+		const struct texture *m = mip_level(t, level);
+		return textureGetPixelInternal(m, (size_t)(x * m->width), (size_t)(y * m->height), lut);
+	}
+	if (lod <= 0.0f || !t->mip_count) return textureGetPixelFiltered(t, x, y, lut);
+	if (lod >= (float)t->mip_count) return textureGetPixelFiltered(mip_level(t, t->mip_count), x, y, lut);
+	const size_t level = (size_t)lod;
+	const struct color a = textureGetPixelFiltered(mip_level(t, level), x, y, lut);
+	const struct color b = textureGetPixelFiltered(mip_level(t, level + 1), x, y, lut);
+	return colorLerp(a, b, lod - (float)level);
+}
+
+// 2x2 box filter. Odd sizes repeat the last row or column. Color channels of sRGB
+// textures are averaged in linear, so fine detail doesn't darken in the distance.
+static void downsample(const struct texture *src, struct texture *dst, bool srgb, const float *lut) {
+	for (size_t y = 0; y < dst->height; ++y) {
+		const size_t y0 = min(2 * y, src->height - 1);
+		const size_t y1 = min(2 * y + 1, src->height - 1);
+		for (size_t x = 0; x < dst->width; ++x) {
+			const size_t x0 = min(2 * x, src->width - 1);
+			const size_t x1 = min(2 * x + 1, src->width - 1);
+			const size_t taps[4] = {
+				(x0 + y0 * src->width) * src->channels,
+				(x1 + y0 * src->width) * src->channels,
+				(x0 + y1 * src->width) * src->channels,
+				(x1 + y1 * src->width) * src->channels
+			};
+			const size_t out = (x + y * dst->width) * dst->channels;
+			for (size_t c = 0; c < src->channels; ++c) {
+				const bool encoded = srgb && c < 3;
+				float sum = 0.0f;
+				for (int i = 0; i < 4; ++i) {
+					if (src->precision == char_p) {
+						const unsigned char v = src->data.byte_p[taps[i] + c];
+						sum += encoded ? lut[v] : v / 255.0f;
+					} else {
+						const float v = src->data.float_p[taps[i] + c];
+						sum += encoded ? SRGBToLinear(v) : v;
+					}
+				}
+				const float avg = encoded ? linearToSRGB(sum * 0.25f) : sum * 0.25f;
+				if (src->precision == char_p) {
+					dst->data.byte_p[out + c] = (unsigned char)(min(max(avg, 0.0f), 1.0f) * 255.0f + 0.5f);
+				} else {
+					dst->data.float_p[out + c] = avg;
+				}
+			}
+		}
+	}
+}
+
+void texture_build_mips(struct texture *t, bool srgb) {
+	if (!t || t->mips || t->precision == none) return;
+	size_t count = 0;
+	for (size_t w = t->width, h = t->height; w > 1 || h > 1; w = max(w / 2, 1), h = max(h / 2, 1)) count++;
+	if (!count) return;
+	const float *lut = textureSRGBTable();
+	t->mips = calloc(count, sizeof(*t->mips));
+	const struct texture *prev = t;
+	for (size_t i = 0; i < count; ++i) {
+		struct texture *level = &t->mips[i];
+		*level = (struct texture){
+			.colorspace = t->colorspace,
+			.precision = t->precision,
+			.channels = t->channels,
+			.width = max(prev->width / 2, 1),
+			.height = max(prev->height / 2, 1)
+		};
+		const size_t prim_size = t->precision == char_p ? sizeof(char) : sizeof(float);
+		level->data.byte_p = malloc(level->width * level->height * level->channels * prim_size);
+		if (!level->data.byte_p) {
+			logr(warning, "Failed to allocate %zux%zu mip level.\n", level->width, level->height);
+			break;
+		}
+		downsample(prev, level, srgb, lut);
+		t->mip_count++;
+		prev = level;
+	}
+}
+
+static float g_srgb_lut[256];
+
+static void build_srgb_table(void) {
+	for (int i = 0; i < 256; ++i) {
+		g_srgb_lut[i] = SRGBToLinear(i / 255.0f);
+	}
+}
+
+const float *textureSRGBTable(void) {
+	static struct cr_once once = CR_ONCE_INIT;
+	thread_once(&once, build_srgb_table);
+	return g_srgb_lut;
+}
+
 struct texture *newTexture(enum precision p, size_t width, size_t height, size_t channels) {
 	struct texture *t = calloc(1, sizeof(*t));
 	t->width = width;
@@ -154,6 +268,10 @@ void tex_clear(struct texture *t) {
 
 void destroyTexture(struct texture *t) {
 	if (t) {
+		if (t->mips) {
+			for (size_t i = 0; i < t->mip_count; ++i) free(t->mips[i].data.byte_p);
+			free(t->mips);
+		}
 		free(t->data.byte_p);
 		free(t);
 		t = NULL;
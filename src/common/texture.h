@@ -34,11 +34,16 @@ struct texture {
 	size_t channels;
 	size_t width;
 	size_t height;
+	// Box filtered copies, each half the size of the previous one, down to 1x1.
+	// Empty until texture_build_mips() is called.
+	struct texture *mips;
+	size_t mip_count;
 };
 
 struct texture_asset {
 	char *path;
 	struct texture *t;
+	bool srgb; // Mips were averaged as sRGB. Nodes that disagree load their own copy
 };
 
 typedef struct texture_asset texture_asset;
@@ -56,6 +61,24 @@ void setPixel(struct texture *t, struct color c, size_t x, size_t y);
 /// @remarks When filtered == false, pass in the integer coordinates, otherwise pass in a 0.0f->1.0f coefficient
 struct color textureGetPixel(const struct texture *t, float x, float y, bool filtered);
 
+/// Same as textureGetPixel(), but the color channels of 8 bit textures are looked up in lut instead of scaled to 0.0f->1.0f
+/// @remarks Lookups happen before filtering. Alpha and float textures are passed through as is.
+struct color textureGetPixelLUT(const struct texture *t, float x, float y, bool filtered, const float *lut);
+
+/// Look up a color from mip level lod, where level 0 is the full resolution texture and each level after
+/// that is half the size. x and y are always 0.0f->1.0f coefficients. Filtered lookups are trilinear,
+/// unfiltered ones take the nearest pixel from the nearest level.
+/// @remarks With lod <= 0.0f, or without mips, this is the same as textureGetPixelLUT() on the full texture.
+struct color textureGetPixelLOD(const struct texture *t, float x, float y, float lod, bool filtered, const float *lut);
+
+/// Build the mip levels textureGetPixelLOD() reads. Does nothing if they're already there.
+/// @param srgb Average color channels in linear, for textures that get looked up with SRGB_TRANSFORM
+void texture_build_mips(struct texture *t, bool srgb);
+
+/// Lookup table for textureGetPixelLUT() that decodes 8 bit sRGB values to linear.
+/// Built on first use and shared by everyone.
+const float *textureSRGBTable(void);
+
 /// Convert texture from sRGB to linear color space
 /// @remarks The texture data will be modified directly.
 /// @param t Texture to convert
@@ -34,9 +34,15 @@ static void printUsage(const char *progname) {
 	printf("    [-t <w>x<h>]     -> Override tile  dimensions to <w>x<h>\n");
 	printf("    [-o <path>]      -> Override output file path to <path>\n");
 	printf("    [-c <cam_index>] -> Select camera. Defaults to 0\n");
+	printf("    [--time-limit <ms>] -> Adjust sample counts to finish the render in <ms> milliseconds\n");
+	printf("    [--noise-threshold <f>] -> Stop sampling pixel blocks once their relative error drops below f\n");
+	printf("    [--sampler <name>] -> Use halton, hammersley, random or sobol sampling\n");
 	printf("    [-v]             -> Enable verbose mode\n");
 	printf("    [-vv]            -> Enable very verbose mode\n");
 	printf("    [--iterative]    -> Start in iterative mode (Experimental)\n");
+	printf("    [--progressive]  -> Render all tiles one sample at a time, so a stopped render is still uniform\n");
+	printf("    [--guiding]      -> Learn where light comes from during the render, and aim diffuse bounces there\n");
+	printf("    [--denoise]      -> Filter out remaining noise once the render is done\n");
 	printf("    [--worker]       -> Start up as a network render worker (Experimental)\n");
 	printf("    [--nodes <list>] -> Use worker nodes in comma-separated ip:port list for a faster render (Experimental)\n");
 	printf("    [--shutdown]     -> Use in conjunction with a node list to send a shutdown command to a list of clients\n");
@@ -168,6 +174,34 @@ struct driver_args *args_parse(int argc, char **argv) {
 			}
 		}
 
+		if (stringEquals(argv[i], "--time-limit")) {
+			char *str = argv[i + 1];
+			if (str) {
+				int n = atoi(str);
+				n = n < 0 ? 0 : n;
+				setDatabaseInt(args, "time_limit_ms", n);
+			} else {
+				logr(warning, "Invalid --time-limit parameter given!\n");
+			}
+		}
+
+		if (stringEquals(argv[i], "--noise-threshold")) {
+			char *str = argv[i + 1];
+			if (str && atof(str) >= 0.0) {
+				setDatabaseString(args, "noise_threshold", str);
+			} else {
+				logr(warning, "Invalid --noise-threshold parameter given!\n");
+			}
+		}
+
+		if (stringEquals(argv[i], "--sampler")) {
+			if (argv[i + 1]) {
+				setDatabaseString(args, "sampler", argv[i + 1]);
+			} else {
+				logr(warning, "Invalid --sampler parameter given!\n");
+			}
+		}
+
 		if (stringEquals(argv[i], "--suite")) {
 			if (argv[i + 1]) {
 				setDatabaseString(args, "test_suite", argv[i + 1]);
@@ -208,6 +242,18 @@ struct driver_args *args_parse(int argc, char **argv) {
 			setDatabaseTag(args, "interactive");
 		}
 		
+		if (stringEquals(argv[i], "--progressive")) {
+			setDatabaseTag(args, "progressive");
+		}
+		
+		if (stringEquals(argv[i], "--guiding")) {
+			setDatabaseTag(args, "path_guiding");
+		}
+		
+		if (stringEquals(argv[i], "--denoise")) {
+			setDatabaseTag(args, "denoise");
+		}
+		
 		if (stringEquals(argv[i], "--shutdown")) {
 			setDatabaseTag(args, "shutdown");
 		}
@@ -6,6 +6,7 @@
 //  Copyright © 2015-2023 Valtteri Koskivuori. All rights reserved.
 //
 
+#include <stdlib.h>
 #include <c-ray/c-ray.h>
 
 #include "imagefile.h"
@@ -187,6 +188,39 @@ int main(int argc, char *argv[]) {
 			cr_renderer_set_num_pref(renderer, cr_renderer_is_iterative, 1);
 		}
 	}
+
+	if (args_is_set(opts, "time_limit_ms")) {
+		int limit = args_int(opts, "time_limit_ms");
+		logr(info, "Overriding time limit to %ims\n", limit);
+		cr_renderer_set_num_pref(renderer, cr_renderer_time_limit_ms, limit);
+	}
+
+	if (args_is_set(opts, "noise_threshold")) {
+		double threshold = atof(args_string(opts, "noise_threshold"));
+		logr(info, "Overriding noise threshold to %g\n", threshold);
+		cr_renderer_set_float_pref(renderer, cr_renderer_noise_threshold, threshold);
+	}
+
+	if (args_is_set(opts, "sampler")) {
+		const char *sampler = args_string(opts, "sampler");
+		if (cr_renderer_set_str_pref(renderer, cr_renderer_sampler, sampler)) {
+			logr(info, "Overriding sampler to %s\n", sampler);
+		} else {
+			logr(warning, "Unknown sampler \"%s\", using the default\n", sampler);
+		}
+	}
+
+	if (args_is_set(opts, "progressive")) {
+		cr_renderer_set_num_pref(renderer, cr_renderer_is_progressive, 1);
+	}
+
+	if (args_is_set(opts, "path_guiding")) {
+		cr_renderer_set_num_pref(renderer, cr_renderer_path_guiding, 1);
+	}
+
+	if (args_is_set(opts, "denoise")) {
+		cr_renderer_set_num_pref(renderer, cr_renderer_denoise, 1);
+	}
 	
 	struct usr_data usrdata = (struct usr_data){
 		.p = sdl_parse(cJSON_GetObjectItem(input_json, "display")),
@@ -15,7 +15,7 @@
 
 #define RAY_OFFSET_MULTIPLIER 0.0001f
 
-//FIXME: Should be configurable at runtime
+// Default for prefs.sampler, pick another one with --sampler or "sampler" in the renderer prefs
 #define SAMPLING_STRATEGY Halton
 
 #ifdef __GNUC__
@@ -50,7 +50,7 @@ typedef bool (*intersect_leaf_fn_t)(
 	const struct bvh *,
 	const struct lightRay *,
 	size_t, size_t,
-	struct hitRecord *);
+	struct hit *);
 
 // This structure has the same size as `index_type`
 struct bvh_index {
@@ -81,6 +81,11 @@ struct split {
 	size_t pos;
 };
 
+struct masked_mesh_data {
+	const struct mesh *mesh;
+	const value_node_ptr *masks;
+};
+
 struct top_level_data {
 	const struct instance *instances;
 	sampler *sampler;
@@ -470,7 +475,8 @@ static inline bool traverse_bvh_generic(
 	const struct bvh *bvh,
 	intersect_leaf_fn_t intersect_leaf,
 	const struct lightRay *ray,
-	struct hitRecord *isect)
+	struct hit *isect,
+	bool any_hit)
 {
 	if (bvh->node_count < 1) {
 		isect->instIndex = -1;
@@ -541,6 +547,8 @@ static inline bool traverse_bvh_generic(
 			top.first_child_or_prim + top.prim_count,
 			isect))
 		{
+			// Occlusion queries don't care which hit is the closest
+			if (any_hit) return true;
 			max_dist = isect->distance;
 			was_hit = true;
 		}
@@ -573,7 +581,7 @@ static inline bool intersect_bottom_level_leaf(
 	const struct bvh *bvh,
 	const struct lightRay *ray,
 	size_t begin, size_t end,
-	struct hitRecord *isect)
+	struct hit *isect)
 {
 	const struct mesh *mesh = user_data;
 	bool found = false;
@@ -587,12 +595,37 @@ static inline bool intersect_bottom_level_leaf(
 	return found;
 }
 
+// Same as above, but hits on cut-out materials only count where the mask says they're solid.
+// The mask texture is looked up right here, so a cut-out costs a texel fetch, not a whole bounce.
+static inline bool intersect_masked_bottom_level_leaf(
+	const void *user_data,
+	const struct bvh *bvh,
+	const struct lightRay *ray,
+	size_t begin, size_t end,
+	struct hit *isect)
+{
+	const struct masked_mesh_data *data = user_data;
+	bool found = false;
+	for (size_t i = begin; i < end; ++i) {
+		const size_t prim_index = bvh->prim_indices[i];
+		struct poly *p = &data->mesh->polygons.items[prim_index];
+		struct hit candidate = *isect;
+		if (!rayIntersectsWithPolygon(data->mesh, ray, p, &candidate)) continue;
+		const struct valueNode *mask = data->masks[p->materialIndex];
+		if (mask && !alpha_mask_test(mask, getTexMapMesh(data->mesh, p, candidate.bary), ray, (uint32_t)prim_index)) continue;
+		*isect = candidate;
+		isect->polygon = p;
+		found = true;
+	}
+	return found;
+}
+
 static inline bool intersect_top_level_leaf(
 	const void *user_data,
 	const struct bvh *bvh,
 	const struct lightRay *ray,
 	size_t begin, size_t end,
-	struct hitRecord *isect)
+	struct hit *isect)
 {
 	const struct top_level_data *top_level_data = user_data;
 	const struct instance *instances = top_level_data->instances;
@@ -623,23 +656,42 @@ struct bvh *build_top_level_bvh(const struct instance_arr instances) {
 bool traverse_bottom_level_bvh(
 	const struct mesh *mesh,
 	const struct lightRay *ray,
-	struct hitRecord *isect,
+	struct hit *isect,
+	const value_node_ptr *masks,
 	sampler *sampler)
 {
 	(void)sampler;
-	return traverse_bvh_generic(mesh, mesh->bvh, intersect_bottom_level_leaf, ray, isect);
+	if (masks) {
+		return traverse_bvh_generic(
+			&(struct masked_mesh_data) { mesh, masks },
+			mesh->bvh, intersect_masked_bottom_level_leaf, ray, isect, false);
+	}
+	return traverse_bvh_generic(mesh, mesh->bvh, intersect_bottom_level_leaf, ray, isect, false);
 }
 
 bool traverse_top_level_bvh(
 	const struct instance *instances,
 	const struct bvh *bvh,
 	const struct lightRay *ray,
-	struct hitRecord *isect,
+	struct hit *isect,
+	sampler *sampler)
+{
+	return traverse_bvh_generic(
+		&(struct top_level_data) { instances, sampler },
+		bvh, intersect_top_level_leaf, ray, isect, false);
+}
+
+bool traverse_top_level_bvh_occluded(
+	const struct instance *instances,
+	const struct bvh *bvh,
+	const struct lightRay *ray,
+	float max_distance,
 	sampler *sampler)
 {
+	struct hit isect = { .instIndex = -1, .distance = max_distance };
 	return traverse_bvh_generic(
 		&(struct top_level_data) { instances, sampler },
-		bvh, intersect_top_level_leaf, ray, isect);
+		bvh, intersect_top_level_leaf, ray, &isect, true);
 }
 
 void destroy_bvh(struct bvh *bvh) {
@@ -657,8 +709,7 @@ void bvh_build_task(void *arg) {
 }
 
 // FIXME: Add pthread_cancel() support
-void compute_accels(struct mesh_arr meshes) {
-	struct cr_thread_pool *pool = thread_pool_create(sys_get_cores());
+void compute_accels(struct cr_thread_pool *pool, struct mesh_arr meshes) {
 	logr(info, "Updating %zu BVHs: ", meshes.count);
 	struct timeval timer = { 0 };
 	timer_start(&timer);
@@ -669,6 +720,5 @@ void compute_accels(struct mesh_arr meshes) {
 
 	printSmartTime(timer_get_ms(timer));
 	logr(plain, "\n");
-	thread_pool_destroy(pool);
 }
 
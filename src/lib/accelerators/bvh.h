@@ -15,12 +15,13 @@
 #include <stddef.h>
 
 struct lightRay;
-struct hitRecord;
+struct hit;
 struct mesh;
 struct poly;
 struct boundingBox;
 
 struct bvh;
+struct cr_thread_pool;
 
 /// Returns the bounding box of the root of the given BVH
 struct boundingBox get_root_bbox(const struct bvh *bvh);
@@ -40,16 +41,29 @@ bool traverse_top_level_bvh(
 	const struct instance *instances,
 	const struct bvh *bvh,
 	const struct lightRay *ray,
-	struct hitRecord *isect,
+	struct hit *isect,
 	sampler *sampler);
 
+/// Check if anything in a scene top-level BVH blocks a ray before max_distance.
+/// Stops at the first hit, so it's cheaper than traverse_top_level_bvh() for shadow rays
+bool traverse_top_level_bvh_occluded(
+	const struct instance *instances,
+	const struct bvh *bvh,
+	const struct lightRay *ray,
+	float max_distance,
+	sampler *sampler);
+
+/// Intersect a ray with a mesh BVH
+/// @param masks Cut-out mask per material index, see bsdf_buffer. NULL if the mesh has none
 bool traverse_bottom_level_bvh(
 	const struct mesh *mesh,
 	const struct lightRay *ray,
-	struct hitRecord *isect,
+	struct hit *isect,
+	const value_node_ptr *masks,
 	sampler *sampler);
 
 /// Frees the memory allocated by the given BVH
 void destroy_bvh(struct bvh *);
 
-void compute_accels(struct mesh_arr meshes);
+/// Builds BVHs for all meshes that don't have one yet, using the given thread pool
+void compute_accels(struct cr_thread_pool *pool, struct mesh_arr meshes);
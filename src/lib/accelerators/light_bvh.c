@@ -0,0 +1,209 @@
+//
+//  light_bvh.c
+//  c-ray
+//
+
+#include "../../includes.h"
+#include "light_bvh.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+/*
+ * Light BVH, loosely based on "Importance Sampling of Many Lights with Adaptive Tree Splitting",
+ * by A. Conty Estevez and C. Kulla. Every node stores bounds, an orientation cone and the total
+ * power of the lights under it. Sampling walks down from the root, choosing a child in proportion
+ * to a conservative estimate of how much it could contribute at the shading point. Each leaf holds
+ * a single light, so the chance of picking a light is the product of the choices along its path.
+ */
+
+#define LEAF_BIT 0x80000000u
+
+struct light_bvh_node {
+	struct light_bounds bounds;
+	uint32_t child; // Index of the left child, the right one follows it. Light index with LEAF_BIT for leaves
+	uint32_t parent;
+};
+
+struct light_bvh {
+	struct light_bvh_node *nodes;
+	size_t node_count;
+	uint32_t *leaf_of; // Node index of each light's leaf
+};
+
+struct keyed_light {
+	float key;
+	uint32_t light;
+};
+
+static int compare_keyed_lights(const void *a, const void *b) {
+	const struct keyed_light *lhs = a;
+	const struct keyed_light *rhs = b;
+	return (lhs->key > rhs->key) - (lhs->key < rhs->key);
+}
+
+static inline struct vector bounds_center(const struct light_bounds *b) {
+	return vec_scale(vec_add(b->min, b->max), 0.5f);
+}
+
+// Axis rotated towards target by angle
+static inline struct vector rotate_towards(struct vector axis, struct vector target, float angle) {
+	const struct vector ortho = vec_sub(target, vec_scale(axis, vec_dot(axis, target)));
+	const float len = vec_length(ortho);
+	if (len < 1e-6f) return axis;
+	return vec_normalize(vec_add(vec_scale(axis, cosf(angle)), vec_scale(ortho, sinf(angle) / len)));
+}
+
+static struct light_bounds merge_bounds(struct light_bounds a, struct light_bounds b) {
+	struct light_bounds out = {
+		.min = vec_min(a.min, b.min),
+		.max = vec_max(a.max, b.max),
+		.power = a.power + b.power,
+		.axis = a.axis,
+		.theta_o = PI / 2.0f
+	};
+	if (a.theta_o >= PI / 2.0f || b.theta_o >= PI / 2.0f) return out;
+	// Two-sided cones, so flip b over to whichever side is closer
+	if (vec_dot(a.axis, b.axis) < 0.0f) b.axis = vec_negate(b.axis);
+	if (b.theta_o > a.theta_o) {
+		struct light_bounds tmp = a;
+		a = b;
+		b = tmp;
+	}
+	const float theta_d = acosf(clamp(vec_dot(a.axis, b.axis), -1.0f, 1.0f));
+	if (theta_d + b.theta_o <= a.theta_o) {
+		out.axis = a.axis;
+		out.theta_o = a.theta_o;
+		return out;
+	}
+	const float theta_o = 0.5f * (a.theta_o + theta_d + b.theta_o);
+	if (theta_o >= PI / 2.0f) return out;
+	out.axis = rotate_towards(a.axis, b.axis, theta_o - a.theta_o);
+	out.theta_o = theta_o;
+	return out;
+}
+
+// Upper bound of what the lights in this node could contribute at p
+static float importance(const struct light_bounds *b, struct vector p) {
+	if (b->power <= 0.0f) return 0.0f;
+	const struct vector center = bounds_center(b);
+	const struct vector to_p = vec_sub(p, center);
+	const float dist_sq = vec_length_squared(to_p);
+	const float radius = 0.5f * vec_length(vec_sub(b->max, b->min));
+	// Don't let points inside or right next to the node blow up the estimate
+	const float clamped_sq = max(dist_sq, radius * radius);
+	if (b->theta_o >= PI / 2.0f) return b->power / clamped_sq;
+
+	const float dist = sqrtf(dist_sq);
+	if (dist <= radius) return b->power / clamped_sq;
+	const float cos_theta = fabsf(vec_dot(b->axis, to_p)) / dist;
+	const float theta = acosf(clamp(cos_theta, 0.0f, 1.0f));
+	const float theta_u = asinf(radius / dist);
+	const float theta_p = max(theta - b->theta_o - theta_u, 0.0f);
+	// cosf() of an angle that rounds to pi / 2 can come out slightly negative
+	return b->power * max(cosf(theta_p), 0.0f) / clamped_sq;
+}
+
+static uint32_t build_recursive(struct light_bvh *bvh, const struct light_bounds *lights, struct keyed_light *keyed, size_t begin, size_t end, uint32_t node_idx) {
+	struct light_bvh_node *node = &bvh->nodes[node_idx];
+	if (end - begin == 1) {
+		node->bounds = lights[keyed[begin].light];
+		node->child = keyed[begin].light | LEAF_BIT;
+		bvh->leaf_of[keyed[begin].light] = node_idx;
+		return node_idx;
+	}
+	// Median split along the longest axis of the light centers
+	struct vector cmin = bounds_center(&lights[keyed[begin].light]);
+	struct vector cmax = cmin;
+	for (size_t i = begin + 1; i < end; ++i) {
+		const struct vector c = bounds_center(&lights[keyed[i].light]);
+		cmin = vec_min(cmin, c);
+		cmax = vec_max(cmax, c);
+	}
+	const struct vector extent = vec_sub(cmax, cmin);
+	const unsigned axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	for (size_t i = begin; i < end; ++i) {
+		const struct vector c = bounds_center(&lights[keyed[i].light]);
+		keyed[i].key = vec_component(&c, axis);
+	}
+	qsort(keyed + begin, end - begin, sizeof(*keyed), compare_keyed_lights);
+	const size_t mid = begin + (end - begin) / 2;
+
+	const uint32_t left = (uint32_t)bvh->node_count;
+	bvh->node_count += 2;
+	bvh->nodes[left].parent = node_idx;
+	bvh->nodes[left + 1].parent = node_idx;
+	build_recursive(bvh, lights, keyed, begin, mid, left);
+	build_recursive(bvh, lights, keyed, mid, end, left + 1);
+	// nodes may not move, it's allocated up front
+	node->child = left;
+	node->bounds = merge_bounds(bvh->nodes[left].bounds, bvh->nodes[left + 1].bounds);
+	return node_idx;
+}
+
+struct light_bvh *build_light_bvh(const struct light_bounds *lights, size_t count) {
+	if (!count || count >= LEAF_BIT) return NULL;
+	struct light_bvh *bvh = calloc(1, sizeof(*bvh));
+	bvh->nodes = calloc(2 * count - 1, sizeof(*bvh->nodes));
+	bvh->leaf_of = calloc(count, sizeof(*bvh->leaf_of));
+	struct keyed_light *keyed = malloc(count * sizeof(*keyed));
+	for (size_t i = 0; i < count; ++i) keyed[i] = (struct keyed_light){ .light = (uint32_t)i };
+	bvh->node_count = 1;
+	build_recursive(bvh, lights, keyed, 0, count, 0);
+	free(keyed);
+	return bvh;
+}
+
+// Chance of picking the left child of an inner node
+static inline float left_probability(const struct light_bvh *bvh, const struct light_bvh_node *node, struct vector p) {
+	const float left = importance(&bvh->nodes[node->child].bounds, p);
+	const float right = importance(&bvh->nodes[node->child + 1].bounds, p);
+	if (left + right <= 0.0f) return -1.0f;
+	return left / (left + right);
+}
+
+bool light_bvh_sample(const struct light_bvh *bvh, struct vector p, float u, size_t *light, float *pmf) {
+	if (!bvh) return false;
+	const struct light_bvh_node *node = &bvh->nodes[0];
+	float prob = 1.0f;
+	while (!(node->child & LEAF_BIT)) {
+		const float p_left = left_probability(bvh, node, p);
+		if (p_left < 0.0f) return false;
+		// Rescale u for the next level, so one random number is enough for the whole walk
+		if (u < p_left) {
+			u = min(u / p_left, 0.99999994f);
+			prob *= p_left;
+			node = &bvh->nodes[node->child];
+		} else {
+			u = min((u - p_left) / (1.0f - p_left), 0.99999994f);
+			prob *= 1.0f - p_left;
+			node = &bvh->nodes[node->child + 1];
+		}
+	}
+	if (prob <= 0.0f) return false;
+	*light = node->child & ~LEAF_BIT;
+	*pmf = prob;
+	return true;
+}
+
+float light_bvh_pmf(const struct light_bvh *bvh, struct vector p, size_t light) {
+	if (!bvh) return 0.0f;
+	uint32_t idx = bvh->leaf_of[light];
+	float prob = 1.0f;
+	while (idx != 0) {
+		const uint32_t parent = bvh->nodes[idx].parent;
+		const float p_left = left_probability(bvh, &bvh->nodes[parent], p);
+		if (p_left < 0.0f) return 0.0f;
+		prob *= idx == bvh->nodes[parent].child ? p_left : 1.0f - p_left;
+		idx = parent;
+	}
+	return prob;
+}
+
+void destroy_light_bvh(struct light_bvh *bvh) {
+	if (!bvh) return;
+	free(bvh->nodes);
+	free(bvh->leaf_of);
+	free(bvh);
+}
@@ -0,0 +1,32 @@
+//
+//  light_bvh.h
+//  c-ray
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../common/vector.h"
+
+/// Everything the light BVH needs to know about one emitter
+struct light_bounds {
+	struct vector min, max;
+	struct vector axis; // Emission is two-sided, so the cone covers both axis and -axis
+	float theta_o; // Cone half-angle, PI / 2 covers every direction
+	float power;
+};
+
+struct light_bvh;
+
+/// Builds a light BVH, where each leaf is one of the given lights
+struct light_bvh *build_light_bvh(const struct light_bounds *lights, size_t count);
+
+/// Picks a light in proportion to its estimated contribution at point p, using one random number u.
+/// Returns false if no light can contribute, otherwise stores the light index and the chance of picking it
+bool light_bvh_sample(const struct light_bvh *bvh, struct vector p, float u, size_t *light, float *pmf);
+
+/// Chance of light_bvh_sample() picking the given light at point p
+float light_bvh_pmf(const struct light_bvh *bvh, struct vector p, size_t light);
+
+void destroy_light_bvh(struct light_bvh *bvh);
@@ -119,6 +119,46 @@ bool cr_renderer_set_num_pref(struct cr_renderer *ext, enum cr_renderer_param p,
 			r->prefs.blender_mode = num;
 			return true;
 		}
+		case cr_renderer_is_progressive: {
+			r->prefs.progressive = num;
+			return true;
+		}
+		case cr_renderer_path_guiding: {
+			r->prefs.path_guiding = num;
+			return true;
+		}
+		case cr_renderer_denoise: {
+			r->prefs.denoise = num;
+			return true;
+		}
+		case cr_renderer_diffuse_bounces: {
+			r->prefs.diffuse_bounces = num;
+			return true;
+		}
+		case cr_renderer_glossy_bounces: {
+			r->prefs.glossy_bounces = num;
+			return true;
+		}
+		case cr_renderer_transmission_bounces: {
+			r->prefs.transmission_bounces = num;
+			return true;
+		}
+		case cr_renderer_rr_start_depth: {
+			r->prefs.rr_start_depth = num;
+			return true;
+		}
+		case cr_renderer_median_of_means: {
+			r->prefs.median_of_means = num;
+			return true;
+		}
+		case cr_renderer_sort_shading: {
+			r->prefs.sort_shading = num;
+			return true;
+		}
+		case cr_renderer_time_limit_ms: {
+			r->prefs.time_limit_ms = num;
+			return true;
+		}
 		default: return false;
 	}
 	return false;
@@ -137,11 +177,29 @@ bool cr_renderer_set_str_pref(struct cr_renderer *ext, enum cr_renderer_param p,
 				r->prefs.tileOrder = ro_from_middle;
 			} else if (stringEquals(str, "toMiddle")) {
 				r->prefs.tileOrder = ro_to_middle;
+			} else if (stringEquals(str, "hilbert")) {
+				r->prefs.tileOrder = ro_hilbert;
+			} else if (stringEquals(str, "morton")) {
+				r->prefs.tileOrder = ro_morton;
 			} else {
 				r->prefs.tileOrder = ro_normal;
 			}
 			return true;
 		}
+		case cr_renderer_sampler: {
+			if (stringEquals(str, "halton")) {
+				r->prefs.sampler = Halton;
+			} else if (stringEquals(str, "hammersley")) {
+				r->prefs.sampler = Hammersley;
+			} else if (stringEquals(str, "random")) {
+				r->prefs.sampler = Random;
+			} else if (stringEquals(str, "sobol")) {
+				r->prefs.sampler = Sobol;
+			} else {
+				return false;
+			}
+			return true;
+		}
 		case cr_renderer_output_path: {
 			if (r->prefs.imgFilePath) free(r->prefs.imgFilePath);
 			r->prefs.imgFilePath = stringCopy(str);
@@ -194,6 +252,15 @@ const char *cr_renderer_get_str_pref(struct cr_renderer *ext, enum cr_renderer_p
 		case cr_renderer_output_path: return r->prefs.imgFilePath;
 		case cr_renderer_output_name: return r->prefs.imgFileName;
 		case cr_renderer_asset_path: return r->scene->asset_path;
+		case cr_renderer_sampler: {
+			switch (r->prefs.sampler) {
+				case Halton: return "halton";
+				case Hammersley: return "hammersley";
+				case Random: return "random";
+				case Sobol: return "sobol";
+			}
+			return NULL;
+		}
 		default: return NULL;
 	}
 	return NULL;
@@ -211,11 +278,58 @@ uint64_t cr_renderer_get_num_pref(struct cr_renderer *ext, enum cr_renderer_para
 		case cr_renderer_output_num: return r->prefs.imgCount;
 		case cr_renderer_override_width: return r->prefs.override_width;
 		case cr_renderer_override_height: return r->prefs.override_height;
+		case cr_renderer_is_progressive: return r->prefs.progressive;
+		case cr_renderer_time_limit_ms: return r->prefs.time_limit_ms;
+		case cr_renderer_path_guiding: return r->prefs.path_guiding;
+		case cr_renderer_denoise: return r->prefs.denoise;
+		case cr_renderer_diffuse_bounces: return r->prefs.diffuse_bounces;
+		case cr_renderer_glossy_bounces: return r->prefs.glossy_bounces;
+		case cr_renderer_transmission_bounces: return r->prefs.transmission_bounces;
+		case cr_renderer_rr_start_depth: return r->prefs.rr_start_depth;
+		case cr_renderer_median_of_means: return r->prefs.median_of_means;
+		case cr_renderer_sort_shading: return r->prefs.sort_shading;
 		default: return 0; // TODO
 	}
 	return 0;
 }
 
+bool cr_renderer_set_float_pref(struct cr_renderer *ext, enum cr_renderer_param p, double num) {
+	if (!ext) return false;
+	struct renderer *r = (struct renderer *)ext;
+	switch (p) {
+		case cr_renderer_noise_threshold: {
+			if (num < 0.0) return false;
+			r->prefs.noise_threshold = num;
+			return true;
+		}
+		case cr_renderer_rr_min_probability: {
+			// 0 would let roulette end paths with no way to make up for it
+			if (num <= 0.0 || num > 1.0) return false;
+			r->prefs.rr_min_probability = num;
+			return true;
+		}
+		case cr_renderer_indirect_clamp: {
+			if (num < 0.0) return false;
+			r->prefs.indirect_clamp = num;
+			return true;
+		}
+		default: return false;
+	}
+	return false;
+}
+
+double cr_renderer_get_float_pref(struct cr_renderer *ext, enum cr_renderer_param p) {
+	if (!ext) return 0.0;
+	struct renderer *r = (struct renderer *)ext;
+	switch (p) {
+		case cr_renderer_noise_threshold: return r->prefs.noise_threshold;
+		case cr_renderer_rr_min_probability: return r->prefs.rr_min_probability;
+		case cr_renderer_indirect_clamp: return r->prefs.indirect_clamp;
+		default: return 0.0;
+	}
+	return 0.0;
+}
+
 bool cr_scene_set_background(struct cr_scene *s_ext, struct cr_shader_node *desc) {
 	if (!s_ext) return false;
 	struct world *s = (struct world *)s_ext;
@@ -588,6 +702,10 @@ struct cr_value_node *value_deepcopy(const struct cr_value_node *in) {
 		case cr_vn_grayscale:
 			out->arg.grayscale.color = color_deepcopy(in->arg.grayscale.color);
 			break;
+		case cr_vn_cache:
+			out->arg.cache.value = value_deepcopy(in->arg.cache.value);
+			out->arg.cache.resolution = in->arg.cache.resolution;
+			break;
 		default:
 			break;
 		
@@ -661,6 +779,10 @@ struct cr_color_node *color_deepcopy(const struct cr_color_node *in) {
 			out->arg.color_ramp.elements = calloc(ct, sizeof(*out->arg.color_ramp.elements));
 			for (int i = 0; i < ct; ++i) out->arg.color_ramp.elements[i] = in->arg.color_ramp.elements[i];
 			break;
+		case cr_cn_cache:
+			out->arg.cache.color = color_deepcopy(in->arg.cache.color);
+			out->arg.cache.resolution = in->arg.cache.resolution;
+			break;
 		default: // FIXME: default remove
 			break;
 	}
@@ -775,10 +897,7 @@ void cr_material_set_add(struct cr_scene *s_ext, cr_material_set set, struct cr_
 	struct world *s = (struct world *)s_ext;
 	if ((size_t)set > s->shader_buffers.count - 1) return;
 	debug_dump_node_tree(desc);
-	struct bsdf_buffer *buf = &s->shader_buffers.items[set];
-	const struct bsdfNode *node = build_bsdf_node(s_ext, desc);
-	cr_shader_node_ptr_arr_add(&buf->descriptions, shader_deepcopy(desc));
-	bsdf_node_ptr_arr_add(&buf->bsdfs, node);
+	bsdf_buffer_add(s_ext, &s->shader_buffers.items[set], shader_deepcopy(desc));
 }
 
 void cr_renderer_render(struct cr_renderer *ext) {
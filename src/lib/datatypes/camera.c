@@ -65,8 +65,21 @@ static inline float triangleDistribution(float v) {
 	return v;
 }
 
+// Camera space ray through pix_v on the sensor, and through the lens if there is one
+static inline void lens_ray(const struct camera *cam, struct vector pix_v, struct coord random, struct vector *start, struct vector *direction) {
+	*start = vec_zero();
+	*direction = vec_normalize(pix_v);
+	if (cam->aperture > 0.0f) {
+		const float ft = cam->focus_distance / vec_dot(*direction, cam->forward);
+		const struct vector focus_point = vec_add(*start, vec_scale(*direction, ft));
+		const struct coord lens_point = coord_scale(cam->aperture, random);
+		*start = vec_add(*start, vec_add(vec_scale(cam->right, lens_point.x), vec_scale(cam->up, lens_point.y)));
+		*direction = vec_normalize(vec_sub(focus_point, *start));
+	}
+}
+
 struct lightRay cam_get_ray(const struct camera *cam, int x, int y, struct sampler *sampler) {
-	struct lightRay new_ray = { .type = rt_camera };
+	struct lightRay new_ray = { .type = rt_camera, .has_differentials = true };
 	
 	const float jitter_x = triangleDistribution(getDimension(sampler));
 	const float jitter_y = triangleDistribution(getDimension(sampler));
@@ -80,19 +93,15 @@ struct lightRay cam_get_ray(const struct camera *cam, int x, int y, struct sampl
 								vec_scale(pix_y, y - cam->height * 0.5f + jitter_y + 0.5f)
 							)
 						);
-	new_ray.direction = vec_normalize(pix_v);
 	
 	// Unused if aperture == 0.0, but still computed to maintain the same
 	// prng sequence for both codepaths
 	struct coord random = coord_on_unit_disc(sampler);
 
-	if (cam->aperture > 0.0f) {
-		const float ft = cam->focus_distance / vec_dot(new_ray.direction, cam->forward);
-		const struct vector focus_point = alongRay(&new_ray, ft);
-		const struct coord lens_point = coord_scale(cam->aperture, random);
-		new_ray.start = vec_add(new_ray.start, vec_add(vec_scale(cam->right, lens_point.x), vec_scale(cam->up, lens_point.y)));
-		new_ray.direction = vec_normalize(vec_sub(focus_point, new_ray.start));
-	}
+	lens_ray(cam, pix_v, random, &new_ray.start, &new_ray.direction);
+	// The neighbouring pixels, through the same point on the lens
+	lens_ray(cam, vec_add(pix_v, pix_x), random, &new_ray.rx_start, &new_ray.rx_direction);
+	lens_ray(cam, vec_add(pix_v, pix_y), random, &new_ray.ry_start, &new_ray.ry_direction);
 	//To world space
 	tform_ray(&new_ray, cam->composite.A);
 	return new_ray;
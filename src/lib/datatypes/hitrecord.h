@@ -11,13 +11,49 @@
 #include "../../common/vector.h"
 #include "lightray.h"
 
+// What traversal keeps for the closest candidate. Everything else is worked out
+// once the closest one is known, see struct hitRecord.
+struct hit {
+	float distance;					//Distance to intersection point
+	struct coord bary;				//Barycentric coordinates on polygon, unused for spheres
+	struct poly *polygon;			//ptr to polygon that was encountered, NULL for spheres
+	int instIndex;					//Instance index, negative if no intersection
+};
+
+// Shading context for one path vertex, built from a struct hit by the instance that was hit.
+// Nodes read this. Normals face the incident ray.
 struct hitRecord {
 	struct lightRay *incident;		//Incident ray
 	struct vector hitPoint;			//Hit point vector in world space
-	struct vector surfaceNormal;	//Surface normal at that point of intersection
-	struct coord uv;				//UV barycentric coordinates for intersection point
+	struct vector surfaceNormal;	//Shading normal, interpolated for smooth meshes
+	struct vector geometricNormal;	//True surface normal
+	struct vector dpdu;				//Change in hitPoint along texture u
+	struct vector dpdv;				//Change in hitPoint along texture v
+	struct vector tangent;			//Tangent frame around surfaceNormal, tangent follows dpdu where it can
+	struct vector bitangent;
+	struct coord uv;				//Texture coordinates for intersection point
+	bool has_uv;					//False if the surface has no texture coordinates
+	struct vector dpdx;				//Change in hitPoint one pixel over, zero if the ray had no differentials
+	struct vector dpdy;
+	struct coord duvdx;				//Change in uv one pixel over, the texture footprint
+	struct coord duvdy;
 	const struct bsdfNode *bsdf;	//Surface properties of the intersected object
 	struct poly *polygon;			//ptr to polygon that was encountered
 	float distance;					//Distance to intersection point
 	int instIndex;					//Instance index, negative if no intersection
 };
+
+// Fill in tangent and bitangent from surfaceNormal and dpdu
+static inline void hitrecord_tangent_frame(struct hitRecord *record) {
+	const struct vector n = record->surfaceNormal;
+	const struct vector t = vec_sub(record->dpdu, vec_scale(n, vec_dot(n, record->dpdu)));
+	const float len_sq = vec_length_squared(t);
+	if (len_sq > 1e-12f) {
+		record->tangent = vec_scale(t, 1.0f / sqrtf(len_sq));
+		record->bitangent = vec_cross(n, record->tangent);
+	} else {
+		const struct base b = baseWithVec(n);
+		record->tangent = b.j;
+		record->bitangent = b.k;
+	}
+}
@@ -26,6 +26,11 @@ struct lightRay {
 	struct vector start;
 	struct vector direction;
 	enum ray_type type : 8;
+	// Rays one pixel over in x and y, for sizing texture lookups. Set for camera rays,
+	// and kept through singular bounces, see differentials.h
+	bool has_differentials;
+	struct vector rx_start, rx_direction;
+	struct vector ry_start, ry_direction;
 };
 
 static inline struct vector alongRay(const struct lightRay *ray, float t) {
@@ -35,4 +40,10 @@ static inline struct vector alongRay(const struct lightRay *ray, float t) {
 static inline void tform_ray(struct lightRay *ray, const struct matrix4x4 mat) {
 	tform_point(&ray->start, mat);
 	tform_vector(&ray->direction, mat);
+	if (ray->has_differentials) {
+		tform_point(&ray->rx_start, mat);
+		tform_vector(&ray->rx_direction, mat);
+		tform_point(&ray->ry_start, mat);
+		tform_vector(&ray->ry_direction, mat);
+	}
 }
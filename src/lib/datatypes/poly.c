@@ -14,7 +14,7 @@
 #include "../renderer/pathtrace.h"
 #include "../datatypes/mesh.h"
 
-bool rayIntersectsWithPolygon(const struct mesh *mesh, const struct lightRay *ray, const struct poly *poly, struct hitRecord *isect) {
+bool rayIntersectsWithPolygon(const struct mesh *mesh, const struct lightRay *ray, const struct poly *poly, struct hit *isect) {
 	// Möller-Trumbore ray-triangle intersection routine
 	// (see "Fast, Minimum Storage Ray-Triangle Intersection", by T. Möller and B. Trumbore)
 	struct vector e1 = vec_sub(mesh->vbuf->vertices.items[poly->vertexIndex[0]], mesh->vbuf->vertices.items[poly->vertexIndex[1]]);
@@ -27,27 +27,14 @@ bool rayIntersectsWithPolygon(const struct mesh *mesh, const struct lightRay *ra
 
 	float u = vec_dot(r, e2) * invDet;
 	float v = vec_dot(r, e1) * invDet;
-	float w = 1.0f - u - v;
 
 	// This order of comparisons guarantees that none of u, v, or t, are NaNs:
 	// IEEE-754 mandates that they compare to false if the left hand side is a NaN.
 	if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f) {
 		float t = vec_dot(n, c) * invDet;
 		if (t >= 0.0f && t < isect->distance) {
-			isect->uv = (struct coord) { u, v };
+			isect->bary = (struct coord) { u, v };
 			isect->distance = t;
-			if (likely(poly->hasNormals)) {
-				struct vector upcomp = vec_scale(mesh->vbuf->normals.items[poly->normalIndex[1]], u);
-				struct vector vpcomp = vec_scale(mesh->vbuf->normals.items[poly->normalIndex[2]], v);
-				struct vector wpcomp = vec_scale(mesh->vbuf->normals.items[poly->normalIndex[0]], w);
-				
-				isect->surfaceNormal = vec_add(vec_add(upcomp, vpcomp), wpcomp);
-			} else {
-				isect->surfaceNormal = n;
-			}
-			// Support two-sided materials by flipping the normal if needed
-			if (vec_dot(ray->direction, isect->surfaceNormal) >= 0.0f) isect->surfaceNormal = vec_negate(isect->surfaceNormal);
-			isect->hitPoint = alongRay(ray, t);
 			return true;
 		}
 	}
@@ -24,8 +24,9 @@ typedef struct poly poly;
 dyn_array_def(poly)
 
 struct lightRay;
-struct hitRecord;
+struct hit;
 struct mesh;
 
 //Calculates intersection between a light ray and a polygon object. Returns true if intersection has happened.
-bool rayIntersectsWithPolygon(const struct mesh *mesh, const struct lightRay *ray, const struct poly *poly, struct hitRecord *isect);
+//Only distance and bary are written, the instance fills in the rest in getShadingFn.
+bool rayIntersectsWithPolygon(const struct mesh *mesh, const struct lightRay *ray, const struct poly *poly, struct hit *isect);
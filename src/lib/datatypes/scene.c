@@ -46,6 +46,8 @@ void scene_destroy(struct world *scene) {
 		vertex_buffer_arr_free(&scene->v_buffers);
 		instance_arr_free(&scene->instances);
 		sphere_arr_free(&scene->spheres);
+		lights_free(&scene->lights);
+		env_map_free(&scene->env);
 		if (scene->asset_path) free(scene->asset_path);
 		free(scene);
 	}
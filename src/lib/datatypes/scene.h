@@ -14,6 +14,8 @@
 #include "camera.h"
 #include "../../common/texture.h"
 #include "../nodes/bsdfnode.h"
+#include "../renderer/lights.h"
+#include "../renderer/envmap.h"
 
 struct renderer;
 struct hashtable;
@@ -40,8 +42,11 @@ struct world {
 	// contains all 3D assets in the scene.
 	struct bvh *topLevel; // FIXME: Move to state?
 	struct sphere_arr spheres;
+	struct light_list lights; // Rebuilt at render start
+	struct env_map env; // Rebuilt at render start if the background changed
 	struct camera_arr cameras;
 	struct node_storage storage; // FIXME: Move to state?
+	bool has_cache_nodes; // Render threads only allocate a node_cache if set
 
 	// c-ray is Y up, blender is Z up. This flag toggles
 	// between the two in c-ray.
@@ -45,13 +45,26 @@ bool intersect(const struct lightRay *ray, const struct sphere *sphere, float *t
 	return true;
 }
 
-bool rayIntersectsWithSphere(const struct lightRay *ray, const struct sphere *sphere, struct hitRecord *isect) {
+bool rayIntersectsWithSphere(const struct lightRay *ray, const struct sphere *sphere, struct hit *isect) {
 	if (intersect(ray, sphere, &isect->distance)) {
-		//Compute normal and store it to isect
-		isect->hitPoint = alongRay(ray, isect->distance);
-		isect->surfaceNormal = vec_normalize(isect->hitPoint);
 		isect->polygon = NULL;
 		return true;
 	}
 	return false;
 }
+
+int sphere_intersections(const struct lightRay *ray, const struct sphere *sphere, float max_distance, float t[2]) {
+	const float A = vec_dot(ray->direction, ray->direction);
+	const float B = 2.0f * vec_dot(ray->direction, ray->start);
+	const float C = vec_dot(ray->start, ray->start) - (sphere->radius * sphere->radius);
+	const float discriminant = B * B - 4.0f * A * C;
+	if (discriminant < 0.0f) return 0;
+	const float root = sqrtf(discriminant);
+	// Same scaling and limits as intersect(), so distances match
+	const float roots[2] = { (-B - root) / 2.0f, (-B + root) / 2.0f };
+	int count = 0;
+	for (int i = 0; i < 2; ++i) {
+		if (roots[i] >= 0.00001f && roots[i] <= max_distance) t[count++] = roots[i];
+	}
+	return count;
+}
@@ -20,4 +20,8 @@ struct sphere {
 typedef struct sphere sphere;
 dyn_array_def(sphere)
 
-bool rayIntersectsWithSphere(const struct lightRay *ray, const struct sphere *sphere, struct hitRecord *isect);
+bool rayIntersectsWithSphere(const struct lightRay *ray, const struct sphere *sphere, struct hit *isect);
+
+// Both intersections before max_distance, nearest first. Returns how many there are.
+// For cut-outs, where the near side may turn out to be transparent.
+int sphere_intersections(const struct lightRay *ray, const struct sphere *sphere, float max_distance, float t[2]);
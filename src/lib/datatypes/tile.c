@@ -15,7 +15,7 @@
 #include "../vendored/pcg_basic.h"
 #include <string.h>
 
-static void tiles_reorder(struct render_tile_arr *tiles, enum render_order tileOrder);
+static void tiles_reorder(struct render_tile_arr *tiles, enum render_order tileOrder, unsigned tile_w, unsigned tile_h);
 
 struct render_tile *tile_next(struct tile_set *set) {
 	struct render_tile *tile = NULL;
@@ -46,10 +46,20 @@ struct render_tile *tile_next_interactive(struct renderer *r, struct tile_set *s
 	again:
 	if (r->state.finishedPasses < r->prefs.sampleCount + 1) {
 		if (set->finished < set->tiles.count) {
-			tile = &set->tiles.items[set->finished];
-			tile->state = rendering;
-			tile->index = set->finished++;
+			struct render_tile *next = &set->tiles.items[set->finished];
+			// Another thread may still be finishing this tile from the previous pass
+			if (next->state != rendering) {
+				tile = next;
+				tile->state = rendering;
+				tile->index = set->finished++;
+				tile->pass = r->state.finishedPasses - 1;
+			}
 		} else {
+			// Progressive render with a time limit. Stop at a pass boundary, so every tile has the same sample count.
+			if (!r->prefs.iterative && !renderer_has_time_for_pass(r, set)) {
+				mutex_release(set->tile_mutex);
+				return NULL;
+			}
 			r->state.finishedPasses++;
 			struct cr_renderer_cb_info cb_info = { 0 };
 			cb_info.finished_passes = r->state.finishedPasses - 1;
@@ -58,6 +68,10 @@ struct render_tile *tile_next_interactive(struct renderer *r, struct tile_set *s
 			set->finished = 0;
 			goto again;
 		}
+	} else if (!r->prefs.iterative) {
+		// Progressive render, all passes have been handed out.
+		mutex_release(set->tile_mutex);
+		return NULL;
 	}
 	if (!tile) {
 		// FIXME: shared state to indicate pause instead of accessing worker state
@@ -65,8 +79,11 @@ struct render_tile *tile_next_interactive(struct renderer *r, struct tile_set *s
 			mutex_release(set->tile_mutex);
 			return NULL;
 		}
-		// FIXME: Use an atomic conditional for this, instead of polling here
+		// Nothing to hand out yet. Back off without holding the lock, so the
+		// threads we're waiting for can get to it and finish their tiles.
+		mutex_release(set->tile_mutex);
 		timer_sleep_ms(32);
+		mutex_lock(set->tile_mutex);
 		goto again;
 	}
 	mutex_release(set->tile_mutex);
@@ -119,7 +136,7 @@ struct tile_set tile_quantize(unsigned width, unsigned height, unsigned tile_w,
 	}
 	logr(info, "Quantized image into %i tiles. (%ix%i)\n", (tiles_x * tiles_y), tiles_x, tiles_y);
 
-	tiles_reorder(&set.tiles, order);
+	tiles_reorder(&set.tiles, order, tile_w, tile_h);
 
 	return set;
 }
@@ -216,7 +233,75 @@ static void reorder_to_middle(struct render_tile_arr *tiles) {
 	*tiles = temp;
 }
 
-static void tiles_reorder(struct render_tile_arr *tiles, enum render_order tileOrder) {
+struct keyed_tile {
+	uint64_t key;
+	struct render_tile tile;
+};
+
+static int compare_keyed_tiles(const void *a, const void *b) {
+	const struct keyed_tile *lhs = a;
+	const struct keyed_tile *rhs = b;
+	return (lhs->key > rhs->key) - (lhs->key < rhs->key);
+}
+
+// Position along a Hilbert curve filling an n*n grid, n being a power of two.
+static uint64_t hilbert_index(uint32_t n, uint32_t x, uint32_t y) {
+	uint64_t d = 0;
+	for (uint32_t s = n / 2; s > 0; s /= 2) {
+		const uint32_t rx = (x & s) > 0;
+		const uint32_t ry = (y & s) > 0;
+		d += (uint64_t)s * s * ((3 * rx) ^ ry);
+		// Rotate the quadrant so the curve stays continuous
+		if (ry == 0) {
+			if (rx == 1) {
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			const uint32_t t = x;
+			x = y;
+			y = t;
+		}
+	}
+	return d;
+}
+
+// Interleave the bits of x and y, giving a Z-order curve
+static uint64_t morton_index(uint32_t x, uint32_t y) {
+	uint64_t d = 0;
+	for (unsigned bit = 0; bit < 32; ++bit) {
+		d |= (uint64_t)((x >> bit) & 1) << (2 * bit);
+		d |= (uint64_t)((y >> bit) & 1) << (2 * bit + 1);
+	}
+	return d;
+}
+
+// Consecutive tiles on these curves are always (Hilbert) or mostly (Morton) neighbours,
+// so the BVH nodes and textures one tile touches are likely still in cache for the next.
+static void reorder_space_filling(struct render_tile_arr *tiles, enum render_order order, unsigned tile_w, unsigned tile_h) {
+	uint32_t tiles_x = 0;
+	uint32_t tiles_y = 0;
+	for (size_t i = 0; i < tiles->count; ++i) {
+		tiles_x = max(tiles_x, (uint32_t)tiles->items[i].begin.x / tile_w + 1);
+		tiles_y = max(tiles_y, (uint32_t)tiles->items[i].begin.y / tile_h + 1);
+	}
+	uint32_t n = 1;
+	while (n < tiles_x || n < tiles_y) n *= 2;
+
+	struct keyed_tile *keyed = malloc(tiles->count * sizeof(*keyed));
+	for (size_t i = 0; i < tiles->count; ++i) {
+		const uint32_t x = tiles->items[i].begin.x / tile_w;
+		const uint32_t y = tiles->items[i].begin.y / tile_h;
+		keyed[i].key = order == ro_hilbert ? hilbert_index(n, x, y) : morton_index(x, y);
+		keyed[i].tile = tiles->items[i];
+	}
+	qsort(keyed, tiles->count, sizeof(*keyed), compare_keyed_tiles);
+	for (size_t i = 0; i < tiles->count; ++i) {
+		tiles->items[i] = keyed[i].tile;
+	}
+	free(keyed);
+}
+
+static void tiles_reorder(struct render_tile_arr *tiles, enum render_order tileOrder, unsigned tile_w, unsigned tile_h) {
 	switch (tileOrder) {
 		case ro_from_middle:
 			reorder_from_middle(tiles);
@@ -230,6 +315,10 @@ static void tiles_reorder(struct render_tile_arr *tiles, enum render_order tileO
 		case ro_random:
 			reorder_random(tiles);
 			break;
+		case ro_hilbert:
+		case ro_morton:
+			reorder_space_filling(tiles, tileOrder, tile_w, tile_h);
+			break;
 		default:
 			break;
 	}
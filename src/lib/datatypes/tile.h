@@ -19,7 +19,9 @@ enum render_order {
 	ro_from_middle,
 	ro_to_middle,
 	ro_normal,
-	ro_random
+	ro_random,
+	ro_hilbert,
+	ro_morton
 };
 
 struct renderer;
@@ -40,6 +42,8 @@ struct render_tile {
 	int index;
 	size_t total_samples;
 	size_t completed_samples;
+	// Fields above mirror struct cr_tile, internal ones go below
+	size_t pass; // 0-based pass this tile was last handed out for, see tile_next_interactive()
 };
 
 typedef struct render_tile render_tile;
@@ -30,10 +30,55 @@ void description_free(struct cr_shader_node **s) {
 void bsdf_buffer_free(struct bsdf_buffer *b) {
 	if (!b) return;
 	bsdf_node_ptr_arr_free(&b->bsdfs);
+	value_node_ptr_arr_free(&b->masks);
 	b->descriptions.elem_free = description_free;
 	cr_shader_node_ptr_arr_free(&b->descriptions);
 }
 
+// Traversal only knows the uv of a candidate hit, so only masks that can't look at anything else
+// are tested there: constants, and the alpha channel of an image or a constant color.
+static bool mask_needs_uv_only(const struct cr_value_node *factor) {
+	if (factor->type == cr_vn_constant) return true;
+	if (factor->type != cr_vn_alpha) return false;
+	const struct cr_color_node *color = factor->arg.alpha.color;
+	return !color || color->type == cr_cn_image || color->type == cr_cn_constant;
+}
+
+// Cut-outs are a mix between a clear transparent BSDF and a material, picked by texture alpha or a
+// constant. append_alpha() in the wavefront loader makes these. Instead of a transparent bounce for
+// every cut-out hit, the opacity is tested during traversal, see alpha_mask_test(). Mixes with
+// procedural factors stay regular mixes, those may draw from the sampler or look at the incident ray.
+// Returns the opacity, and sets *material to the side that gets shaded.
+static const struct valueNode *cutout_mask(struct cr_scene *s_ext, const struct cr_shader_node *desc, const struct cr_shader_node **material) {
+	if (!desc || desc->type != cr_bsdf_mix) return NULL;
+	const struct cr_value_node *factor = desc->arg.mix.factor;
+	if (!factor || !mask_needs_uv_only(factor)) return NULL;
+	struct world *scene = (struct world *)s_ext;
+	struct node_storage s = scene->storage;
+	const struct bsdfNode *clear = newTransparent(&s, NULL);
+	const struct valueNode *mask = NULL;
+	if (build_bsdf_node(s_ext, desc->arg.mix.A) == clear) {
+		// mix.c picks B with a chance of factor
+		mask = build_value_node(s_ext, factor);
+		*material = desc->arg.mix.B;
+	} else if (factor->type == cr_vn_constant && build_bsdf_node(s_ext, desc->arg.mix.B) == clear) {
+		mask = newConstantValue(&s, 1.0f - factor->arg.constant);
+		*material = desc->arg.mix.A;
+	}
+	// Materials without an alpha channel get a constant 1 here, build_bsdf_node() prunes those mixes already
+	if (!mask || (mask->constant && mask->eval(mask, NULL, NULL) >= 1.0f)) return NULL;
+	return mask;
+}
+
+void bsdf_buffer_add(struct cr_scene *s_ext, struct bsdf_buffer *b, struct cr_shader_node *desc) {
+	const struct cr_shader_node *material = desc;
+	const struct valueNode *mask = cutout_mask(s_ext, desc, &material);
+	cr_shader_node_ptr_arr_add(&b->descriptions, desc);
+	bsdf_node_ptr_arr_add(&b->bsdfs, build_bsdf_node(s_ext, mask ? material : desc));
+	value_node_ptr_arr_add(&b->masks, mask);
+	if (mask) b->has_masks = true;
+}
+
 const struct bsdfNode *build_bsdf_node(struct cr_scene *s_ext, const struct cr_shader_node *desc) {
 	if (!s_ext) return NULL;
 	struct world *scene = (struct world *)s_ext;
@@ -54,11 +99,19 @@ const struct bsdfNode *build_bsdf_node(struct cr_scene *s_ext, const struct cr_s
 				build_color_node(s_ext, desc->arg.plastic.color),
 				build_value_node(s_ext, desc->arg.plastic.roughness),
 				build_value_node(s_ext, desc->arg.plastic.IOR));
-		case cr_bsdf_mix:
+		case cr_bsdf_mix: {
+			const struct valueNode *factor = build_value_node(s_ext, desc->arg.mix.factor);
+			// A constant factor picks the same side every time, see mix.c
+			if (factor && factor->constant) {
+				const float f = factor->eval(factor, NULL, NULL);
+				if (f <= 0.0f) return build_bsdf_node(s_ext, desc->arg.mix.A);
+				if (f >= 1.0f) return build_bsdf_node(s_ext, desc->arg.mix.B);
+			}
 			return newMix(&s,
 				build_bsdf_node(s_ext, desc->arg.mix.A),
 				build_bsdf_node(s_ext, desc->arg.mix.B),
-				build_value_node(s_ext, desc->arg.mix.factor));
+				factor);
+		}
 		case cr_bsdf_add:
 			return newAdd(&s, build_bsdf_node(s_ext, desc->arg.add.A), build_bsdf_node(s_ext, desc->arg.add.B));
 		case cr_bsdf_transparent:
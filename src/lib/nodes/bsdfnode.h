@@ -20,15 +20,21 @@
 
 struct bsdfSample {
 	struct lightRay out;
-	float pdf;
+	float pdf; // Solid angle pdf of out, same as bsdf->pdf() would return. 0 for singular lobes
 	struct color weight;
 	struct color emitted; // FIXME: Not really the right place for this
 };
 
-//TODO: Expand and refactor to match a standard bsdf signature with eval, sample and pdf
+// eval and pdf are optional, nodes that can't evaluate an arbitrary direction
+// (singular lobes) leave them NULL, and only get sampled. Nodes that are only
+// singular in places, like a textured roughness hitting 0, return 0 there.
 struct bsdfNode {
 	struct nodeBase base;
 	struct bsdfSample (*sample)(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record);
+	// BSDF value for scattering towards out, times the cosine term
+	struct color (*eval)(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out);
+	// Solid angle pdf of sample() returning out
+	float (*pdf)(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out);
 };
 
 typedef const struct bsdfNode * bsdf_node_ptr;
@@ -37,13 +43,21 @@ dyn_array_def(bsdf_node_ptr)
 typedef struct cr_shader_node * cr_shader_node_ptr;
 dyn_array_def(cr_shader_node_ptr)
 
+typedef const struct valueNode * value_node_ptr;
+dyn_array_def(value_node_ptr)
+
 struct bsdf_buffer {
 	struct bsdf_node_ptr_arr bsdfs;
 	struct cr_shader_node_ptr_arr descriptions;
+	struct value_node_ptr_arr masks; // Cut-out opacity per material, NULL if opaque. Tested during traversal
+	bool has_masks;
 };
 
 void bsdf_buffer_free(struct bsdf_buffer *b);
 
+// Build the material desc describes and append it to b, which takes ownership of desc
+void bsdf_buffer_add(struct cr_scene *s_ext, struct bsdf_buffer *b, struct cr_shader_node *desc);
+
 typedef struct bsdf_buffer bsdf_buffer;
 dyn_array_def(bsdf_buffer)
 
@@ -0,0 +1,192 @@
+//
+//  cache.c
+//  c-ray
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../../common/hashtable.h"
+#include "../datatypes/hitrecord.h"
+#include "../datatypes/scene.h"
+#include "valuenode.h"
+#include "colornode.h"
+
+#include "cache.h"
+
+// Slots per render thread, a power of two. Every cache node in the scene shares them.
+#define CACHE_SLOTS 16384
+
+// Used when the description doesn't give a resolution
+#define CACHE_DEFAULT_RESOLUTION 256
+
+// UVs past this, once scaled by the resolution, don't fit the key
+#define CACHE_MAX_UV 1073741824.0f
+
+struct cache_key {
+	const void *node; // NULL for empty slots
+	const void *primitive;
+	int32_t instance;
+	int32_t u;
+	int32_t v;
+};
+
+struct cache_entry {
+	struct cache_key key;
+	union {
+		struct color color;
+		float value;
+	} out;
+};
+
+// Each render thread has one of these, so entries are read and written without any locking
+struct node_cache {
+	struct cache_entry entries[CACHE_SLOTS];
+};
+
+struct node_cache *node_cache_new(void) {
+	return calloc(1, sizeof(struct node_cache));
+}
+
+void node_cache_free(struct node_cache *c) {
+	free(c);
+}
+
+static inline uint32_t key_hash(const struct cache_key *key) {
+	uint32_t h = hashInit();
+	h = hashBytes(h, &key->node, sizeof(key->node));
+	h = hashBytes(h, &key->primitive, sizeof(key->primitive));
+	h = hashBytes(h, &key->instance, sizeof(key->instance));
+	h = hashBytes(h, &key->u, sizeof(key->u));
+	h = hashBytes(h, &key->v, sizeof(key->v));
+	return h;
+}
+
+static inline bool key_equals(const struct cache_key *a, const struct cache_key *b) {
+	return a->node == b->node && a->primitive == b->primitive && a->instance == b->instance && a->u == b->u && a->v == b->v;
+}
+
+static bool cache_key(struct cache_key *key, const void *node, const struct hitRecord *record, int resolution) {
+	if (!record || record->instIndex < 0 || !record->has_uv) return false;
+	const float u = floorf(record->uv.x * resolution);
+	const float v = floorf(record->uv.y * resolution);
+	if (!(fabsf(u) < CACHE_MAX_UV && fabsf(v) < CACHE_MAX_UV)) return false;
+	*key = (struct cache_key){
+		.node = node,
+		.primitive = record->polygon,
+		.instance = record->instIndex,
+		.u = (int32_t)u,
+		.v = (int32_t)v
+	};
+	return true;
+}
+
+static inline struct cache_entry *cache_slot(struct node_cache *c, const struct cache_key *key) {
+	return &c->entries[key_hash(key) & (CACHE_SLOTS - 1)];
+}
+
+struct colorCache {
+	struct colorNode node;
+	const struct colorNode *input;
+	int resolution;
+};
+
+static bool compare_color(const void *A, const void *B) {
+	const struct colorCache *this = A;
+	const struct colorCache *other = B;
+	return this->input == other->input && this->resolution == other->resolution;
+}
+
+static uint32_t hash_color(const void *p) {
+	const struct colorCache *this = p;
+	uint32_t h = hashInit();
+	h = hashBytes(h, &this->input, sizeof(this->input));
+	h = hashBytes(h, &this->resolution, sizeof(this->resolution));
+	return h;
+}
+
+static void dump_color(const void *node, char *dumpbuf, int bufsize) {
+	const struct colorCache *self = node;
+	char input[DUMPBUF_SIZE / 2] = "";
+	if (self->input->base.dump) self->input->base.dump(self->input, input, sizeof(input));
+	snprintf(dumpbuf, bufsize, "colorCache { input: %s, resolution: %i }", input, self->resolution);
+}
+
+static struct color eval_color(const struct colorNode *node, sampler *sampler, const struct hitRecord *record) {
+	const struct colorCache *this = (const struct colorCache *)node;
+	struct cache_key key;
+	if (!sampler || !sampler->node_cache || !cache_key(&key, this, record, this->resolution))
+		return this->input->eval(this->input, sampler, record);
+	struct cache_entry *entry = cache_slot(sampler->node_cache, &key);
+	if (key_equals(&entry->key, &key)) return entry->out.color;
+	const struct color out = this->input->eval(this->input, sampler, record);
+	*entry = (struct cache_entry){ .key = key, .out.color = out };
+	return out;
+}
+
+const struct colorNode *new_color_cache(struct cr_scene *s_ext, const struct colorNode *input, int resolution) {
+	if (!s_ext || !input) return input;
+	struct world *scene = (struct world *)s_ext;
+	scene->has_cache_nodes = true;
+	HASH_CONS(scene->storage.node_table, hash_color, struct colorCache, {
+		.input = input,
+		.resolution = resolution > 0 ? resolution : CACHE_DEFAULT_RESOLUTION,
+		.node = {
+			.eval = eval_color,
+			.base = { .compare = compare_color, .dump = dump_color }
+		}
+	});
+}
+
+struct valueCache {
+	struct valueNode node;
+	const struct valueNode *input;
+	int resolution;
+};
+
+static bool compare_value(const void *A, const void *B) {
+	const struct valueCache *this = A;
+	const struct valueCache *other = B;
+	return this->input == other->input && this->resolution == other->resolution;
+}
+
+static uint32_t hash_value(const void *p) {
+	const struct valueCache *this = p;
+	uint32_t h = hashInit();
+	h = hashBytes(h, &this->input, sizeof(this->input));
+	h = hashBytes(h, &this->resolution, sizeof(this->resolution));
+	return h;
+}
+
+static void dump_value(const void *node, char *dumpbuf, int bufsize) {
+	const struct valueCache *self = node;
+	char input[DUMPBUF_SIZE / 2] = "";
+	if (self->input->base.dump) self->input->base.dump(self->input, input, sizeof(input));
+	snprintf(dumpbuf, bufsize, "valueCache { input: %s, resolution: %i }", input, self->resolution);
+}
+
+static float eval_value(const struct valueNode *node, sampler *sampler, const struct hitRecord *record) {
+	const struct valueCache *this = (const struct valueCache *)node;
+	struct cache_key key;
+	if (!sampler || !sampler->node_cache || !cache_key(&key, this, record, this->resolution))
+		return this->input->eval(this->input, sampler, record);
+	struct cache_entry *entry = cache_slot(sampler->node_cache, &key);
+	if (key_equals(&entry->key, &key)) return entry->out.value;
+	const float out = this->input->eval(this->input, sampler, record);
+	*entry = (struct cache_entry){ .key = key, .out.value = out };
+	return out;
+}
+
+const struct valueNode *new_value_cache(struct cr_scene *s_ext, const struct valueNode *input, int resolution) {
+	if (!s_ext || !input || input->constant) return input;
+	struct world *scene = (struct world *)s_ext;
+	scene->has_cache_nodes = true;
+	HASH_CONS(scene->storage.node_table, hash_value, struct valueCache, {
+		.input = input,
+		.resolution = resolution > 0 ? resolution : CACHE_DEFAULT_RESOLUTION,
+		.node = {
+			.eval = eval_value,
+			.base = { .compare = compare_value, .dump = dump_value }
+		}
+	});
+}
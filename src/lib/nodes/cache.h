@@ -0,0 +1,25 @@
+//
+//  cache.h
+//  c-ray
+//
+
+#pragma once
+
+#include <c-ray/c-ray.h>
+
+struct valueNode;
+struct colorNode;
+struct node_cache;
+
+// Results of cache nodes for one render thread. Threads hand theirs to nodes in sampler->node_cache,
+// and nodes evaluated with a sampler that has none just evaluate their input. The table is big, so
+// threads only allocate one if the scene has cache nodes, see world.has_cache_nodes.
+struct node_cache *node_cache_new(void);
+void node_cache_free(struct node_cache *c);
+
+// Remember what input evaluated to at a shading point, keyed by instance, primitive, and UV rounded
+// to 1/resolution. Only correct for inputs that don't draw from the sampler, and don't look at the hit
+// beyond those. Hits without UVs aren't cached. The per-thread table has a fixed size, and new results
+// replace whatever was in their slot.
+const struct colorNode *new_color_cache(struct cr_scene *s_ext, const struct colorNode *input, int resolution);
+const struct valueNode *new_value_cache(struct cr_scene *s_ext, const struct valueNode *input, int resolution);
@@ -17,12 +17,14 @@
 #include "bsdfnode.h"
 
 #include "colornode.h"
+#include "program.h"
+#include "cache.h"
 
 // const struct colorNode *unknownTextureNode(const struct node_storage *s) {
 // 	return newConstantTexture(s, g_black_color);
 // }
 
-const struct colorNode *build_color_node(struct cr_scene *s_ext, const struct cr_color_node *desc) {
+const struct colorNode *build_single_color_node(struct cr_scene *s_ext, const struct cr_color_node *desc) {
 	if (!s_ext || !desc) return NULL;
 	struct world *scene = (struct world *)s_ext;
 	struct node_storage s = scene->storage;
@@ -47,8 +49,10 @@ const struct colorNode *build_color_node(struct cr_scene *s_ext, const struct cr
 			file_data data = file_load(path);
 			struct texture *tex = NULL;
 			// Note: We also deduplicate texture loads here, which ideally shouldn't be necessary.
+			// sRGB and linear lookups of the same file need differently built mips, so those are kept apart
+			const bool srgb = desc->arg.image.options & SRGB_TRANSFORM;
 			for (size_t i = 0; i < scene->textures.count; ++i) {
-				if (stringEquals(scene->textures.items[i].path, path)) {
+				if (stringEquals(scene->textures.items[i].path, path) && scene->textures.items[i].srgb == srgb) {
 					tex = scene->textures.items[i].t;
 				}
 			}
@@ -56,10 +60,13 @@ const struct colorNode *build_color_node(struct cr_scene *s_ext, const struct cr
 				tex = load_texture(path, data);
 				texture_asset_arr_add(&scene->textures, (struct texture_asset){
 					.path = stringCopy(path),
-					.t = tex
+					.t = tex,
+					.srgb = srgb
 				});
 			}
 			file_free(&data);
+			// Mips are built here rather than in load_texture(), since this is where we know if the data is sRGB
+			texture_build_mips(tex, srgb);
 			const struct colorNode *new = newImageTexture(&s, tex, desc->arg.image.options);
 			if (full) free(full);
 			return new;
@@ -109,9 +116,14 @@ const struct colorNode *build_color_node(struct cr_scene *s_ext, const struct cr
 				desc->arg.color_ramp.interpolation,
 				desc->arg.color_ramp.elements,
 				desc->arg.color_ramp.element_count);
+		case cr_cn_cache:
+			return new_color_cache(s_ext, build_color_node(s_ext, desc->arg.cache.color), desc->arg.cache.resolution);
 		default: // FIXME: default remove
 			return NULL;
 	};
 	return NULL;
 }
 
+const struct colorNode *build_color_node(struct cr_scene *s_ext, const struct cr_color_node *desc) {
+	return compile_color_node(s_ext, desc);
+}
@@ -22,6 +22,7 @@ enum textureType {
 struct colorNode {
 	struct nodeBase base;
 	struct color (*eval)(const struct colorNode *node, sampler *sampler, const struct hitRecord *record);
+	bool constant;
 };
 
 #include "textures/checker.h"
@@ -40,4 +41,7 @@ struct colorNode {
 
 // const struct colorNode *unknownTextureNode(const struct node_storage *s);
 
+// Just the node desc describes, its inputs are built with build_color_node() and friends
+const struct colorNode *build_single_color_node(struct cr_scene *s_ext, const struct cr_color_node *desc);
+
 const struct colorNode *build_color_node(struct cr_scene *s_ext, const struct cr_color_node *desc);
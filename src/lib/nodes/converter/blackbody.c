@@ -10,6 +10,7 @@
 #include "../nodebase.h"
 
 #include "../../../common/hashtable.h"
+#include "../../../common/platform/thread.h"
 #include "../../datatypes/scene.h"
 #include "../../datatypes/hitrecord.h"
 #include "../colornode.h"
@@ -17,11 +18,24 @@
 
 #include "blackbody.h"
 
+// colorForKelvin() is clamped at 40000K, and smooth enough to interpolate between 100K steps
+#define BLACKBODY_LUT_STEP 100.0f
+#define BLACKBODY_LUT_SIZE 401
+
 struct blackbodyNode {
 	struct colorNode node;
 	const struct valueNode *temperature;
 };
 
+// Same for every node, so it's built once when the first one is created
+static struct color g_blackbody_lut[BLACKBODY_LUT_SIZE];
+
+static void build_lut(void) {
+	for (size_t i = 0; i < BLACKBODY_LUT_SIZE; ++i) {
+		g_blackbody_lut[i] = colorForKelvin(i * BLACKBODY_LUT_STEP);
+	}
+}
+
 static bool compare(const void *A, const void *B) {
 	const struct blackbodyNode *this = A;
 	const struct blackbodyNode *other = B;
@@ -46,15 +60,23 @@ static struct color eval(const struct colorNode *node, sampler *sampler, const s
 	(void)record;
 	(void)sampler;
 	struct blackbodyNode *this = (struct blackbodyNode *)node;
-	return colorForKelvin(this->temperature->eval(this->temperature, sampler, record));
+	const float f = this->temperature->eval(this->temperature, sampler, record) / BLACKBODY_LUT_STEP;
+	if (!(f > 0.0f)) return g_blackbody_lut[0];
+	if (f >= BLACKBODY_LUT_SIZE - 1) return g_blackbody_lut[BLACKBODY_LUT_SIZE - 1];
+	const size_t i = (size_t)f;
+	return colorLerp(g_blackbody_lut[i], g_blackbody_lut[i + 1], f - i);
 }
 
 const struct colorNode *newBlackbody(const struct node_storage *s, const struct valueNode *temperature) {
-	HASH_CONS(s->node_table, hash, struct blackbodyNode, {
+	struct blackbodyNode blackbody = {
 		.temperature = temperature ? temperature : newConstantValue(s, 4000.0f),
 		.node = {
 			.eval = eval,
 			.base = { .compare = compare, .dump = dump }
 		}
-	});
+	};
+	static struct cr_once once = CR_ONCE_INIT;
+	thread_once(&once, build_lut);
+	if (blackbody.temperature->constant) return newConstantTexture(s, eval(&blackbody.node, NULL, NULL));
+	HASH_CONS(s->node_table, hash, struct blackbodyNode, blackbody);
 }
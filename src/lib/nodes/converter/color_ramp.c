@@ -7,6 +7,7 @@
 //
 
 #include <stdio.h>
+#include <string.h>
 #include "../../../common/hashtable.h"
 #include "../../../common/vector.h"
 #include "../../datatypes/scene.h"
@@ -15,48 +16,42 @@
 
 #include "color_ramp.h"
 
-typedef struct ramp_element ramp_element;
-dyn_array_def(ramp_element)
+// Blender has the same limit, and scenes come from there
+#define RAMP_MAX_STOPS 32
+// Eval looks up where to start searching the stops in a table, so it only ever steps over stops in the same cell.
+// The size is a power of two, so cell boundaries are exact in float.
+#define RAMP_LUT_SIZE 256
+
+struct ramp_stop {
+	float position;
+	struct color color;
+};
 
 struct color_ramp_node {
 	struct colorNode node;
 	const struct valueNode *input_value;
-	enum cr_color_mode color_mode;
 	enum cr_interpolation interpolation;
-	struct ramp_element_arr elements;
+	size_t count;
+	struct ramp_stop stops[RAMP_MAX_STOPS]; // Sorted by position, clamped to [0,1]
+	uint8_t first[RAMP_LUT_SIZE]; // Stops at or before the start of each cell
 };
 
 static bool compare(const void *A, const void *B) {
 	const struct color_ramp_node *this = A;
 	const struct color_ramp_node *other = B;
-	bool elements_match = true;
-	if (this->elements.count != other->elements.count) elements_match = false;
-	for (size_t i = 0; i < this->elements.count && elements_match; ++i) {
-		if (this->elements.items[i].position != other->elements.items[i].position) {
-			elements_match = false;
-			break;
-		}
-		struct cr_color a = this->elements.items[i].color;
-		struct cr_color b = other->elements.items[i].color;
-		if (a.r != b.r || a.g != b.g || a.b != b.b || a.a != b.a) {
-			elements_match = false;
-			break;
-		}
-	}
 	return this->input_value == other->input_value &&
-	this->color_mode == other->color_mode &&
 	this->interpolation == other->interpolation &&
-	elements_match;
+	this->count == other->count &&
+	!memcmp(this->stops, other->stops, this->count * sizeof(*this->stops));
 }
 
 static uint32_t hash(const void *p) {
 	const struct color_ramp_node *this = p;
 	uint32_t h = hashInit();
 	h = hashBytes(h, &this->input_value, sizeof(this->input_value));
-	h = hashBytes(h, &this->color_mode, sizeof(this->color_mode));
 	h = hashBytes(h, &this->interpolation, sizeof(this->interpolation));
-	for (size_t i = 0; i < this->elements.count; ++i)
-		h = hashBytes(h, &this->elements.items[i], sizeof(this->elements.items[i]));
+	h = hashBytes(h, &this->count, sizeof(this->count));
+	h = hashBytes(h, this->stops, this->count * sizeof(*this->stops));
 	return h;
 }
 
@@ -70,43 +65,26 @@ static inline struct color convert(struct cr_color c) {
 	return (struct color){ c.r, c.g, c.b, c.a };
 }
 
-// TODO: This most certainly needs a bunch of tests to verify correctness
+static inline float position(const struct ramp_element *e) {
+	return e->position < 0.0f ? 0.0f : e->position > 1.0f ? 1.0f : e->position;
+}
+
 static struct color eval(const struct colorNode *node, sampler *sampler, const struct hitRecord *record) {
 	const struct color_ramp_node *this = (const struct color_ramp_node *)node;
 	const float pos = this->input_value->eval(this->input_value, sampler, record);
-	
-	if (this->elements.count == 1)
-		return convert(this->elements.items[0].color);
-
-	if (pos <= this->elements.items[0].position)
-		return convert(this->elements.items[0].color);
-
-	if (pos >= this->elements.items[this->elements.count - 1].position)
-		return convert(this->elements.items[this->elements.count - 1].color);
-	
-	struct ramp_element *left = NULL;
-	for (size_t i = 0; i < this->elements.count; ++i) {
-		if (this->elements.items[i].position <= pos) {
-			left = &this->elements.items[i];
-		}
-	}
-	struct ramp_element *right = NULL;
-	for (size_t i = this->elements.count - 1; i; --i) {
-		if (this->elements.items[i].position >= pos) {
-			right = &this->elements.items[i];
-		}
-	}
-
-	if (!left || !right) {
-		logr(warning, "color_ramp: Missing ramp elements: %s %s\n", !left ? "left" : "", !right ? "right" : "");
-		return (struct color){ 0 };
-	}
-
-	if (this->interpolation == cr_constant) {
-		return convert(left->color);
-	}
-	float t = inv_lerp(left->position, right->position, pos);
-	return colorLerp(convert(left->color), convert(right->color), t);
+	// Stops are clamped to [0,1], so the first and last one cover everything outside of it.
+	if (!(pos > 0.0f)) return this->stops[0].color;
+	if (pos >= 1.0f) return this->stops[this->count - 1].color;
+	// Count the stops at or before pos, the one before that is on the left
+	size_t right = this->first[(size_t)(pos * RAMP_LUT_SIZE)];
+	while (right < this->count && this->stops[right].position <= pos) ++right;
+	if (!right) return this->stops[0].color;
+	if (right == this->count) return this->stops[this->count - 1].color;
+	const struct ramp_stop *l = &this->stops[right - 1];
+	if (this->interpolation == cr_constant) return l->color;
+	// Coincident stops never end up on both sides, so this is a hard edge instead of a division by zero
+	const struct ramp_stop *r = &this->stops[right];
+	return colorLerp(l->color, r->color, inv_lerp(l->position, r->position, pos));
 }
 
 const struct colorNode *new_color_ramp(const struct node_storage *s,
@@ -119,10 +97,6 @@ const struct colorNode *new_color_ramp(const struct node_storage *s,
 		logr(warning, "color_ramp: No control points provided, bailing out\n");
 		return newConstantTexture(s, g_pink_color);
 	}
-	struct ramp_element_arr element_arr = { 0 };
-	for (int i = 0; i < element_count; ++i) {
-		ramp_element_arr_add(&element_arr, elements[i]);
-	}
 	// Validate mode, interpolation and elements first
 	// Frankly, I don't even know what this mode does yet, need to look into that
 	// FIXME: Support HSV and HSL modes
@@ -137,23 +111,37 @@ const struct colorNode *new_color_ramp(const struct node_storage *s,
 		interpolation = cr_linear;
 	}
 	// Now validate all the control points
-	for (size_t i = 0; i < element_arr.count; ++i) {
-		struct ramp_element *e = &element_arr.items[i];
+	for (int i = 0; i < element_count; ++i) {
+		const struct ramp_element *e = &elements[i];
 		if (e->position < 0.0f || e->position > 1.0f) {
 			logr(warning, "Invalid control point position: %.3f, clamping\n", e->position);
-			if (e->position > 1.0f) e->position = 1.0f;
-			if (e->position < 0.0f) e->position = 0.0f;
 		}
 	}
-	HASH_CONS(s->node_table, hash, struct color_ramp_node, {
-		// TODO: If the input is constant, we can probably evaluate this at setup time, right?
+	if (element_count > RAMP_MAX_STOPS) {
+		logr(warning, "color_ramp: %i control points, only using the first %i\n", element_count, RAMP_MAX_STOPS);
+		element_count = RAMP_MAX_STOPS;
+	}
+	struct color_ramp_node ramp = {
 		.input_value = input_value ? input_value : newConstantValue(s, 0.0f),
-		.color_mode = color_mode,
 		.interpolation = interpolation,
-		.elements = element_arr,
+		.count = element_count,
 		.node = {
 			.eval = eval,
 			.base = { .compare = compare, .dump = NULL }
 		}
-	});
+	};
+	// Stable, so coincident stops keep their order
+	for (size_t i = 0; i < ramp.count; ++i) {
+		const struct ramp_stop stop = { position(&elements[i]), convert(elements[i].color) };
+		size_t j = i;
+		for (; j && ramp.stops[j - 1].position > stop.position; --j) ramp.stops[j] = ramp.stops[j - 1];
+		ramp.stops[j] = stop;
+	}
+	size_t first = 0;
+	for (size_t i = 0; i < RAMP_LUT_SIZE; ++i) {
+		while (first < ramp.count && ramp.stops[first].position <= (float)i / RAMP_LUT_SIZE) ++first;
+		ramp.first[i] = (uint8_t)first;
+	}
+	if (ramp.input_value->constant) return newConstantTexture(s, eval(&ramp.node, NULL, NULL));
+	HASH_CONS(s->node_table, hash, struct color_ramp_node, ramp);
 }
@@ -62,6 +62,12 @@ static void dump(const void *node, char *dumpbuf, int bufsize) {
 		input, from_min, from_max, to_min, to_max);
 }
 
+float map_range_eval(const float value, const float from_min, const float from_max, const float to_min, const float to_max) {
+	const float delta = from_max - from_min;
+	const float t = clamp(value / delta, 0.0f, 1.0f);
+	return lerp(to_min, to_max, t);
+}
+
 static float eval(const struct valueNode *node, sampler *sampler, const struct hitRecord *record) {
 	const struct mapRangeNode *this = (const struct mapRangeNode *)node;
 	const float input_value = this->input_value->eval(this->input_value, sampler, record);
@@ -69,13 +75,10 @@ static float eval(const struct valueNode *node, sampler *sampler, const struct h
 	const float from_min = this->from_min->eval(this->from_min, sampler, record);
 	const float from_max =  this->from_max->eval(this->from_max, sampler, record);
 	
-	const float delta = from_max - from_min;
-	const float t = clamp(input_value / delta, 0.0f, 1.0f);
-	
 	const float to_min = this->to_min->eval(this->to_min, sampler, record);
 	const float to_max = this->to_max->eval(this->to_max, sampler, record);
 	
-	return lerp(to_min, to_max, t);
+	return map_range_eval(input_value, from_min, from_max, to_min, to_max);
 }
 
 const struct valueNode *newMapRange(const struct node_storage *s,
@@ -14,3 +14,5 @@ const struct valueNode *newMapRange(const struct node_storage *s,
 									const struct valueNode *from_max,
 									const struct valueNode *to_min,
 									const struct valueNode *to_max);
+
+float map_range_eval(const float value, const float from_min, const float from_max, const float to_min, const float to_max);
@@ -138,11 +138,8 @@ float rough_compare(float a, float b) {
 	return true;
 }
 
-static float eval(const struct valueNode *node, sampler *sampler, const struct hitRecord *record) {
-	struct mathNode *this = (struct mathNode *)node;
-	const float a = this->A->eval(this->A, sampler, record);
-	const float b = this->B->eval(this->B, sampler, record);
-	switch (this->op) {
+float math_eval(const enum cr_math_op op, const float a, const float b) {
+	switch (op) {
 		case Add:
 			return a + b;
 		case Subtract:
@@ -203,6 +200,13 @@ static float eval(const struct valueNode *node, sampler *sampler, const struct h
 	return 0.0f;
 }
 
+static float eval(const struct valueNode *node, sampler *sampler, const struct hitRecord *record) {
+	struct mathNode *this = (struct mathNode *)node;
+	const float a = this->A->eval(this->A, sampler, record);
+	const float b = this->B->eval(this->B, sampler, record);
+	return math_eval(this->op, a, b);
+}
+
 const struct valueNode *newMath(const struct node_storage *s, const struct valueNode *A, const struct valueNode *B, const enum cr_math_op op) {
 	HASH_CONS(s->node_table, hash, struct mathNode, {
 		.A = A ? A : newConstantValue(s, 0.0f),
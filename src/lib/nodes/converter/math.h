@@ -12,3 +12,4 @@
 
 const struct valueNode *newMath(const struct node_storage *s, const struct valueNode *A, const struct valueNode *B, const enum cr_math_op op);
 
+float math_eval(const enum cr_math_op op, const float a, const float b);
@@ -135,15 +135,8 @@ static inline float wrap(float value, float max, float min) {
 	return (range != 0.0f) ? value - (range * floorf((value - min) / range)) : min;
 }
  
-static union vector_value eval(const struct vectorNode *node, sampler *sampler, const struct hitRecord *record) {
-	struct vecMathNode *this = (struct vecMathNode *)node;
-	
-	const struct vector a = this->A->eval(this->A, sampler, record).v;
-	const struct vector b = this->B->eval(this->B, sampler, record).v;
-	const struct vector c = this->C->eval(this->C, sampler, record).v;
-	const float f = this->f->eval(this->f, sampler, record);
-	
-	switch (this->op) {
+union vector_value vecmath_eval(const enum cr_vec_op op, const struct vector a, const struct vector b, const struct vector c, const float f) {
+	switch (op) {
 		case VecAdd:
 			return (union vector_value){ .v = vec_add(a, b) };
 		case VecSubtract:
@@ -197,6 +190,17 @@ static union vector_value eval(const struct vectorNode *node, sampler *sampler,
 	return (union vector_value){ 0 };
 }
 
+static union vector_value eval(const struct vectorNode *node, sampler *sampler, const struct hitRecord *record) {
+	struct vecMathNode *this = (struct vecMathNode *)node;
+	
+	const struct vector a = this->A->eval(this->A, sampler, record).v;
+	const struct vector b = this->B->eval(this->B, sampler, record).v;
+	const struct vector c = this->C->eval(this->C, sampler, record).v;
+	const float f = this->f->eval(this->f, sampler, record);
+	
+	return vecmath_eval(this->op, a, b, c, f);
+}
+
 const struct vectorNode *newVecMath(const struct node_storage *s, const struct vectorNode *A, const struct vectorNode *B, const struct vectorNode *C, const struct valueNode *f, const enum cr_vec_op op) {
 	HASH_CONS(s->node_table, hash, struct vecMathNode, {
 		.A = A ? A : newConstantVector(s, vec_zero()),
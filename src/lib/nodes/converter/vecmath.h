@@ -11,3 +11,5 @@
 #include <c-ray/c-ray.h>
 
 const struct vectorNode *newVecMath(const struct node_storage *s, const struct vectorNode *A, const struct vectorNode *B, const struct vectorNode *C, const struct valueNode *f, const enum cr_vec_op op);
+
+union vector_value vecmath_eval(const enum cr_vec_op op, const struct vector a, const struct vector b, const struct vector c, const float f);
@@ -0,0 +1,632 @@
+//
+//  program.c
+//  c-ray
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "../../common/color.h"
+#include "../../common/vector.h"
+#include "../../common/hashtable.h"
+#include "../../common/mempool.h"
+#include "../datatypes/hitrecord.h"
+#include "../datatypes/scene.h"
+#include "valuenode.h"
+#include "colornode.h"
+#include "vectornode.h"
+
+#include "program.h"
+
+/*
+ * Node trees are flattened into a list of instructions that read and write a small register
+ * file. Inputs are compiled before the instruction that uses them, in the same order the
+ * node evals used to call them in, so sampler dimensions are consumed just like before.
+ * Mix nodes only evaluate the input they picked, so they compile into a branch.
+ * Instructions with only constant inputs are run right away, and never make it to the program.
+ */
+
+// Longer programs are split back into separate nodes
+#define PROGRAM_MAX_INSTRUCTIONS 255
+#define PROGRAM_MAX_REGISTERS 64
+
+union reg {
+	float f;
+	struct color c;
+	union vector_value v;
+};
+
+enum opcode {
+	op_constant,
+	op_copy,
+	op_normal,
+	op_uv,
+	op_math,
+	op_map_range,
+	op_rgb,
+	op_hsl,
+	op_hsv,
+	op_split,
+	op_grayscale,
+	op_vec_to_value,
+	op_vec_to_color,
+	op_vecmath,
+	op_value_node,
+	op_color_node,
+	op_vector_node,
+	op_branch, // Jump to target unless a random number lands above the factor
+	op_jump,
+};
+
+struct instruction {
+	uint8_t op;
+	uint8_t dst;
+	uint8_t src[5];
+	uint8_t sub; // Math op, vector op or vector component
+	union {
+		union reg constant;
+		const struct valueNode *value;
+		const struct colorNode *color;
+		const struct vectorNode *vector;
+		uint8_t target;
+	} imm;
+};
+
+static inline float vector_component(const union vector_value v, const enum cr_vec_to_value_component comp) {
+	switch (comp) {
+		case X: return v.v.x;
+		case Y: return v.v.y;
+		case Z: return v.v.z;
+		case U: return v.c.x;
+		case V: return v.c.y;
+		case F: return v.f;
+	}
+	return 0.0f;
+}
+
+static void run(const struct instruction *code, size_t count, union reg *r, sampler *sampler, const struct hitRecord *record) {
+	size_t pc = 0;
+	while (pc < count) {
+		const struct instruction *i = &code[pc++];
+		const uint8_t *s = i->src;
+		switch ((enum opcode)i->op) {
+			case op_constant:
+				r[i->dst] = i->imm.constant;
+				break;
+			case op_copy:
+				r[i->dst] = r[s[0]];
+				break;
+			case op_normal:
+				r[i->dst].v.v = record->surfaceNormal;
+				break;
+			case op_uv:
+				r[i->dst].v.c = record->uv;
+				break;
+			case op_math:
+				r[i->dst].f = math_eval(i->sub, r[s[0]].f, r[s[1]].f);
+				break;
+			case op_map_range:
+				r[i->dst].f = map_range_eval(r[s[0]].f, r[s[1]].f, r[s[2]].f, r[s[3]].f, r[s[4]].f);
+				break;
+			case op_rgb:
+				r[i->dst].c = (struct color){ r[s[0]].f, r[s[1]].f, r[s[2]].f, 1.0f };
+				break;
+			case op_hsl:
+				r[i->dst].c = hsl_to_rgb((struct hsl){ r[s[0]].f, r[s[1]].f, r[s[2]].f });
+				break;
+			case op_hsv:
+				r[i->dst].c = hsv_to_rgb((struct hsv){ r[s[0]].f, r[s[1]].f, r[s[2]].f });
+				break;
+			case op_split: {
+				const float f = r[s[0]].f;
+				r[i->dst].c = (struct color){ f, f, f, 1.0f };
+				break;
+			}
+			case op_grayscale:
+				r[i->dst].f = colorToGrayscale(r[s[0]].c).red;
+				break;
+			case op_vec_to_value:
+				r[i->dst].f = vector_component(r[s[0]].v, i->sub);
+				break;
+			case op_vec_to_color: {
+				const struct vector v = vec_max(r[s[0]].v.v, vec_zero());
+				r[i->dst].c = (struct color){ v.x, v.y, v.z, 0.0f };
+				break;
+			}
+			case op_vecmath:
+				r[i->dst].v = vecmath_eval(i->sub, r[s[0]].v.v, r[s[1]].v.v, r[s[2]].v.v, r[s[3]].f);
+				break;
+			case op_value_node:
+				r[i->dst].f = i->imm.value->eval(i->imm.value, sampler, record);
+				break;
+			case op_color_node:
+				r[i->dst].c = i->imm.color->eval(i->imm.color, sampler, record);
+				break;
+			case op_vector_node:
+				r[i->dst].v = i->imm.vector->eval(i->imm.vector, sampler, record);
+				break;
+			case op_branch:
+				if (getDimension(sampler) <= r[s[0]].f) pc = i->imm.target;
+				break;
+			case op_jump:
+				pc = i->imm.target;
+				break;
+		}
+	}
+}
+
+// Compiler
+
+enum program_kind {
+	program_value,
+	program_color,
+	program_vector,
+};
+
+struct operand {
+	bool constant;
+	uint8_t reg;
+	union reg value;
+};
+
+struct compiler {
+	struct cr_scene *scene;
+	struct instruction code[PROGRAM_MAX_INSTRUCTIONS];
+	size_t count;
+	size_t registers;
+	bool overflow;
+	struct instruction discard; // Written to after overflowing
+};
+
+// Constants end up in the program, and programs are compared bytewise when deduplicating,
+// so the bytes a constant doesn't use have to be zero.
+static struct operand constant_operand(union reg value) {
+	struct operand o;
+	memset(&o, 0, sizeof(o));
+	o.constant = true;
+	o.value = value;
+	return o;
+}
+
+static struct operand constant_value(float f) {
+	union reg value;
+	memset(&value, 0, sizeof(value));
+	value.f = f;
+	return constant_operand(value);
+}
+
+static struct operand constant_color(struct color c) {
+	union reg value;
+	memset(&value, 0, sizeof(value));
+	value.c = c;
+	return constant_operand(value);
+}
+
+static struct operand constant_vector(struct vector v) {
+	union reg value;
+	memset(&value, 0, sizeof(value));
+	value.v.v = v;
+	return constant_operand(value);
+}
+
+static struct instruction *emit(struct compiler *c, enum opcode op) {
+	if (c->count == PROGRAM_MAX_INSTRUCTIONS) {
+		c->overflow = true;
+		return &c->discard;
+	}
+	struct instruction *i = &c->code[c->count++];
+	memset(i, 0, sizeof(*i));
+	i->op = op;
+	return i;
+}
+
+static uint8_t new_register(struct compiler *c) {
+	if (c->registers == PROGRAM_MAX_REGISTERS) {
+		c->overflow = true;
+		return 0;
+	}
+	return (uint8_t)c->registers++;
+}
+
+static void move(struct compiler *c, uint8_t dst, struct operand o) {
+	struct instruction *i = emit(c, o.constant ? op_constant : op_copy);
+	i->dst = dst;
+	if (o.constant) {
+		i->imm.constant = o.value;
+	} else {
+		i->src[0] = o.reg;
+	}
+}
+
+static uint8_t to_register(struct compiler *c, struct operand o) {
+	if (!o.constant) return o.reg;
+	const uint8_t reg = new_register(c);
+	move(c, reg, o);
+	return reg;
+}
+
+// Instructions that only depend on their inputs, folded if those are all constant
+static struct operand pure(struct compiler *c, enum opcode op, uint8_t sub, const struct operand *src, size_t count) {
+	bool constant = true;
+	for (size_t k = 0; k < count; ++k) constant &= src[k].constant;
+	if (constant) {
+		union reg r[6];
+		memset(r, 0, sizeof(r));
+		struct instruction i = { .op = op, .sub = sub, .dst = (uint8_t)count };
+		for (size_t k = 0; k < count; ++k) {
+			r[k] = src[k].value;
+			i.src[k] = (uint8_t)k;
+		}
+		run(&i, 1, r, NULL, NULL);
+		return constant_operand(r[count]);
+	}
+	uint8_t regs[5];
+	for (size_t k = 0; k < count; ++k) regs[k] = to_register(c, src[k]);
+	const uint8_t dst = new_register(c);
+	struct instruction *i = emit(c, op);
+	i->sub = sub;
+	i->dst = dst;
+	memcpy(i->src, regs, count);
+	return (struct operand){ .reg = dst };
+}
+
+static struct operand input(struct compiler *c, enum opcode op) {
+	const uint8_t dst = new_register(c);
+	emit(c, op)->dst = dst;
+	return (struct operand){ .reg = dst };
+}
+
+static struct operand call(struct compiler *c, enum opcode op, const void *node) {
+	const uint8_t dst = new_register(c);
+	struct instruction *i = emit(c, op);
+	i->dst = dst;
+	switch (op) {
+		case op_value_node: i->imm.value = node; break;
+		case op_color_node: i->imm.color = node; break;
+		default: i->imm.vector = node; break;
+	}
+	return (struct operand){ .reg = dst };
+}
+
+// A point in the program to compare code from, or to rewind back to
+struct mark {
+	size_t count;
+	size_t registers;
+	bool overflow;
+};
+
+static struct mark mark(const struct compiler *c) {
+	return (struct mark){ .count = c->count, .registers = c->registers, .overflow = c->overflow };
+}
+
+static void rewind_to(struct compiler *c, struct mark m) {
+	c->count = m.count;
+	c->registers = m.registers;
+	c->overflow = m.overflow;
+}
+
+// Whether code compiled from b does the same as code compiled from a, only with
+// its own registers. Subtrees never touch registers from outside of themselves.
+static bool same_code(const struct compiler *c, struct mark a, struct mark a_end, struct operand a_out, struct mark b, struct operand b_out) {
+	if (c->overflow || a_out.constant != b_out.constant) return false;
+	if (a_out.constant) return !memcmp(&a_out.value, &b_out.value, sizeof(a_out.value));
+	const size_t length = a_end.count - a.count;
+	if (c->count - b.count != length) return false;
+	const size_t regs = b.registers - a.registers;
+	const size_t pcs = b.count - a.count;
+	if (b_out.reg != a_out.reg + regs) return false;
+	for (size_t k = 0; k < length; ++k) {
+		const struct instruction *x = &c->code[a.count + k];
+		const struct instruction *y = &c->code[b.count + k];
+		if (x->op != y->op || x->sub != y->sub || y->dst != x->dst + regs) return false;
+		for (size_t s = 0; s < 5; ++s) {
+			// Unused sources are zero in both
+			if (y->src[s] != x->src[s] + regs && (x->src[s] || y->src[s])) return false;
+		}
+		if (x->op == op_branch || x->op == op_jump) {
+			if (y->imm.target != x->imm.target + pcs) return false;
+		} else if (memcmp(&x->imm, &y->imm, sizeof(x->imm))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Mixes are split in three, around the compiled inputs: branch, else, end
+static size_t mix_branch(struct compiler *c, struct operand factor) {
+	const uint8_t reg = to_register(c, factor);
+	emit(c, op_branch)->src[0] = reg;
+	return c->count - 1;
+}
+
+static size_t mix_else(struct compiler *c, size_t branch, uint8_t dst, struct operand a) {
+	move(c, dst, a);
+	emit(c, op_jump);
+	if (!c->overflow) c->code[branch].imm.target = (uint8_t)c->count;
+	return c->count - 1;
+}
+
+static struct operand mix_end(struct compiler *c, size_t jump, uint8_t dst, struct operand b) {
+	move(c, dst, b);
+	if (!c->overflow) c->code[jump].imm.target = (uint8_t)c->count;
+	return (struct operand){ .reg = dst };
+}
+
+static struct operand compile_value(struct compiler *c, const struct cr_value_node *desc, float fallback);
+static struct operand compile_color(struct compiler *c, const struct cr_color_node *desc, struct color fallback);
+static struct operand compile_vector(struct compiler *c, const struct cr_vector_node *desc, struct vector fallback);
+
+static struct operand compile_input(struct compiler *c, enum program_kind kind, const void *desc) {
+	return kind == program_color ? compile_color(c, desc, g_black_color) : compile_vector(c, desc, vec_zero());
+}
+
+// Color and vector mixes. A constant factor picks the same input every time, see colormix.c,
+// and when both inputs compile to the same code, picking one doesn't matter either.
+static struct operand compile_mix(struct compiler *c, enum program_kind kind, const struct cr_value_node *factor_desc, const void *a_desc, const void *b_desc) {
+	const struct mark start = mark(c);
+	const struct operand factor = compile_value(c, factor_desc, 0.0f);
+	if (factor.constant && factor.value.f <= 0.0f) return compile_input(c, kind, a_desc);
+	if (factor.constant && factor.value.f >= 1.0f) return compile_input(c, kind, b_desc);
+	const size_t branch = mix_branch(c, factor);
+	const uint8_t dst = new_register(c);
+	const struct mark a_start = mark(c);
+	const struct operand a = compile_input(c, kind, a_desc);
+	const struct mark a_end = mark(c);
+	const size_t jump = mix_else(c, branch, dst, a);
+	const struct mark b_start = mark(c);
+	const struct operand b = compile_input(c, kind, b_desc);
+	if (same_code(c, a_start, a_end, a, b_start, b)) {
+		rewind_to(c, start);
+		return compile_input(c, kind, a_desc);
+	}
+	return mix_end(c, jump, dst, b);
+}
+
+static struct operand compile_value(struct compiler *c, const struct cr_value_node *desc, float fallback) {
+	if (!desc) return constant_value(fallback);
+	switch (desc->type) {
+		case cr_vn_constant:
+			return constant_value(desc->arg.constant);
+		case cr_vn_math: {
+			const struct operand src[] = {
+				compile_value(c, desc->arg.math.A, 0.0f),
+				compile_value(c, desc->arg.math.B, 0.0f),
+			};
+			return pure(c, op_math, desc->arg.math.op, src, 2);
+		}
+		case cr_vn_map_range: {
+			const struct operand src[] = {
+				compile_value(c, desc->arg.map_range.input_value, 1.0f),
+				compile_value(c, desc->arg.map_range.from_min, 0.0f),
+				compile_value(c, desc->arg.map_range.from_max, 1.0f),
+				compile_value(c, desc->arg.map_range.to_min, 0.0f),
+				compile_value(c, desc->arg.map_range.to_max, 1.0f),
+			};
+			return pure(c, op_map_range, 0, src, 5);
+		}
+		case cr_vn_vec_to_value: {
+			const struct operand src = compile_vector(c, desc->arg.vec_to_value.vec, vec_zero());
+			return pure(c, op_vec_to_value, desc->arg.vec_to_value.comp, &src, 1);
+		}
+		case cr_vn_grayscale: {
+			const struct operand src = compile_color(c, desc->arg.grayscale.color, g_black_color);
+			return pure(c, op_grayscale, 0, &src, 1);
+		}
+		default: {
+			const struct valueNode *node = build_single_value_node(c->scene, desc);
+			if (!node) return constant_value(fallback);
+			// Nodes that only look at their inputs come out constant if those are
+			if (node->constant) return constant_value(node->eval(node, NULL, NULL));
+			return call(c, op_value_node, node);
+		}
+	}
+}
+
+static struct operand compile_color(struct compiler *c, const struct cr_color_node *desc, struct color fallback) {
+	if (!desc) return constant_color(fallback);
+	switch (desc->type) {
+		case cr_cn_constant:
+			return constant_color((struct color){ desc->arg.constant.r, desc->arg.constant.g, desc->arg.constant.b, desc->arg.constant.a });
+		case cr_cn_split: {
+			const struct operand src = compile_value(c, desc->arg.split.node, 0.0f);
+			return pure(c, op_split, 0, &src, 1);
+		}
+		case cr_cn_rgb: {
+			const struct operand src[] = {
+				compile_value(c, desc->arg.rgb.red, 0.0f),
+				compile_value(c, desc->arg.rgb.green, 0.0f),
+				compile_value(c, desc->arg.rgb.blue, 0.0f),
+			};
+			return pure(c, op_rgb, 0, src, 3);
+		}
+		case cr_cn_hsl: {
+			const struct operand src[] = {
+				compile_value(c, desc->arg.hsl.H, 0.0f),
+				compile_value(c, desc->arg.hsl.S, 0.0f),
+				compile_value(c, desc->arg.hsl.L, 0.0f),
+			};
+			return pure(c, op_hsl, 0, src, 3);
+		}
+		case cr_cn_hsv: {
+			const struct operand src[] = {
+				compile_value(c, desc->arg.hsv.H, 0.0f),
+				compile_value(c, desc->arg.hsv.S, 0.0f),
+				compile_value(c, desc->arg.hsv.V, 0.0f),
+			};
+			return pure(c, op_hsv, 0, src, 3);
+		}
+		case cr_cn_vec_to_color: {
+			const struct operand src = compile_vector(c, desc->arg.vec_to_color.vec, vec_zero());
+			return pure(c, op_vec_to_color, 0, &src, 1);
+		}
+		case cr_cn_color_mix:
+			return compile_mix(c, program_color, desc->arg.color_mix.factor, desc->arg.color_mix.a, desc->arg.color_mix.b);
+		default: {
+			const struct colorNode *node = build_single_color_node(c->scene, desc);
+			if (!node) return constant_color(fallback);
+			if (node->constant) return constant_color(node->eval(node, NULL, NULL));
+			return call(c, op_color_node, node);
+		}
+	}
+}
+
+static struct operand compile_vector(struct compiler *c, const struct cr_vector_node *desc, struct vector fallback) {
+	if (!desc) return constant_vector(fallback);
+	switch (desc->type) {
+		case cr_vec_constant:
+			return constant_vector((struct vector){ desc->arg.constant.x, desc->arg.constant.y, desc->arg.constant.z });
+		case cr_vec_normal:
+			return input(c, op_normal);
+		case cr_vec_uv:
+			return input(c, op_uv);
+		case cr_vec_vecmath: {
+			const struct operand src[] = {
+				compile_vector(c, desc->arg.vecmath.A, vec_zero()),
+				compile_vector(c, desc->arg.vecmath.B, vec_zero()),
+				compile_vector(c, desc->arg.vecmath.C, vec_zero()),
+				compile_value(c, desc->arg.vecmath.f, 0.0f),
+			};
+			return pure(c, op_vecmath, desc->arg.vecmath.op, src, 4);
+		}
+		case cr_vec_mix:
+			return compile_mix(c, program_vector, desc->arg.vec_mix.factor, desc->arg.vec_mix.A, desc->arg.vec_mix.B);
+		default: {
+			const struct vectorNode *node = build_single_vector_node(c->scene, desc);
+			if (!node) return constant_vector(fallback);
+			return call(c, op_vector_node, node);
+		}
+	}
+}
+
+// Program nodes
+
+struct programNode {
+	union {
+		struct valueNode value;
+		struct colorNode color;
+		struct vectorNode vector;
+	} node;
+	enum program_kind kind;
+	const struct instruction *code;
+	size_t count;
+	uint8_t out;
+};
+
+static bool compare(const void *A, const void *B) {
+	const struct programNode *this = A;
+	const struct programNode *other = B;
+	return this->kind == other->kind && this->out == other->out && this->count == other->count &&
+		!memcmp(this->code, other->code, this->count * sizeof(*this->code));
+}
+
+static uint32_t hash(const void *p) {
+	const struct programNode *this = p;
+	uint32_t h = hashInit();
+	h = hashBytes(h, &this->kind, sizeof(this->kind));
+	h = hashBytes(h, &this->out, sizeof(this->out));
+	h = hashBytes(h, this->code, this->count * sizeof(*this->code));
+	return h;
+}
+
+static void dump(const void *node, char *dumpbuf, int bufsize) {
+	const struct programNode *self = node;
+	const char *kinds[] = { "value", "color", "vector" };
+	snprintf(dumpbuf, bufsize, "programNode { kind: %s, instructions: %zu }", kinds[self->kind], self->count);
+}
+
+static float eval_value(const struct valueNode *node, sampler *sampler, const struct hitRecord *record) {
+	const struct programNode *this = (const struct programNode *)node;
+	union reg r[PROGRAM_MAX_REGISTERS];
+	run(this->code, this->count, r, sampler, record);
+	return r[this->out].f;
+}
+
+static struct color eval_color(const struct colorNode *node, sampler *sampler, const struct hitRecord *record) {
+	const struct programNode *this = (const struct programNode *)node;
+	union reg r[PROGRAM_MAX_REGISTERS];
+	run(this->code, this->count, r, sampler, record);
+	return r[this->out].c;
+}
+
+static union vector_value eval_vector(const struct vectorNode *node, sampler *sampler, const struct hitRecord *record) {
+	const struct programNode *this = (const struct programNode *)node;
+	union reg r[PROGRAM_MAX_REGISTERS];
+	run(this->code, this->count, r, sampler, record);
+	return r[this->out].v;
+}
+
+// Like HASH_CONS, but the code only gets copied into the node pool if the program is new
+static const void *intern(struct cr_scene *s_ext, const struct compiler *c, enum program_kind kind, uint8_t out) {
+	struct world *scene = (struct world *)s_ext;
+	struct programNode candidate = { .kind = kind, .code = c->code, .count = c->count, .out = out };
+	const struct nodeBase base = { .compare = compare, .dump = dump };
+	switch (kind) {
+		case program_value:
+			candidate.node.value = (struct valueNode){ .base = base, .eval = eval_value };
+			break;
+		case program_color:
+			candidate.node.color = (struct colorNode){ .base = base, .eval = eval_color };
+			break;
+		case program_vector:
+			candidate.node.vector = (struct vectorNode){ .base = base, .eval = eval_vector };
+			break;
+	}
+	const uint32_t h = hash(&candidate);
+	const struct programNode *existing = findInHashtable(scene->storage.node_table, &candidate, h);
+	if (existing) return existing;
+	struct instruction *code = allocBlock(&scene->storage.node_pool, c->count * sizeof(*code));
+	memcpy(code, c->code, c->count * sizeof(*code));
+	candidate.code = code;
+	insertInHashtable(scene->storage.node_table, &candidate, sizeof(candidate), h);
+	return findInHashtable(scene->storage.node_table, &candidate, h);
+}
+
+// Trees with anything else at the root are built as before, the compiler only sees their inputs.
+// Nodes that can fold are let in, and if they don't, the program is just a call to them.
+static bool compiles_value(enum cr_value_node_type type) {
+	return type == cr_vn_constant || type == cr_vn_math || type == cr_vn_map_range || type == cr_vn_vec_to_value || type == cr_vn_grayscale ||
+		type == cr_vn_alpha;
+}
+
+static bool compiles_color(enum color_node_type type) {
+	return type == cr_cn_constant || type == cr_cn_split || type == cr_cn_rgb || type == cr_cn_hsl || type == cr_cn_hsv ||
+		type == cr_cn_vec_to_color || type == cr_cn_color_mix || type == cr_cn_blackbody || type == cr_cn_color_ramp || type == cr_cn_hsv_tform;
+}
+
+static bool compiles_vector(enum cr_vector_node_type type) {
+	return type == cr_vec_constant || type == cr_vec_normal || type == cr_vec_uv || type == cr_vec_vecmath || type == cr_vec_mix;
+}
+
+const struct valueNode *compile_value_node(struct cr_scene *s_ext, const struct cr_value_node *desc) {
+	if (!s_ext || !desc) return NULL;
+	if (!compiles_value(desc->type)) return build_single_value_node(s_ext, desc);
+	struct compiler c = { .scene = s_ext };
+	const struct operand out = compile_value(&c, desc, 0.0f);
+	struct node_storage s = ((struct world *)s_ext)->storage;
+	if (c.overflow) return build_single_value_node(s_ext, desc);
+	if (out.constant) return newConstantValue(&s, out.value.f);
+	if (c.count == 1 && c.code[0].op == op_value_node) return c.code[0].imm.value;
+	return intern(s_ext, &c, program_value, out.reg);
+}
+
+const struct colorNode *compile_color_node(struct cr_scene *s_ext, const struct cr_color_node *desc) {
+	if (!s_ext || !desc) return NULL;
+	if (!compiles_color(desc->type)) return build_single_color_node(s_ext, desc);
+	struct compiler c = { .scene = s_ext };
+	const struct operand out = compile_color(&c, desc, g_black_color);
+	struct node_storage s = ((struct world *)s_ext)->storage;
+	if (c.overflow) return build_single_color_node(s_ext, desc);
+	if (out.constant) return newConstantTexture(&s, out.value.c);
+	if (c.count == 1 && c.code[0].op == op_color_node) return c.code[0].imm.color;
+	return intern(s_ext, &c, program_color, out.reg);
+}
+
+const struct vectorNode *compile_vector_node(struct cr_scene *s_ext, const struct cr_vector_node *desc) {
+	if (!s_ext || !desc) return NULL;
+	if (!compiles_vector(desc->type)) return build_single_vector_node(s_ext, desc);
+	struct compiler c = { .scene = s_ext };
+	const struct operand out = compile_vector(&c, desc, vec_zero());
+	struct node_storage s = ((struct world *)s_ext)->storage;
+	if (c.overflow) return build_single_vector_node(s_ext, desc);
+	if (out.constant) return newConstantVector(&s, out.value.v.v);
+	return intern(s_ext, &c, program_vector, out.reg);
+}
@@ -0,0 +1,20 @@
+//
+//  program.h
+//  c-ray
+//
+
+#pragma once
+
+#include <c-ray/c-ray.h>
+
+struct valueNode;
+struct colorNode;
+struct vectorNode;
+
+// Compile a node description and its inputs into one flat program, evaluated by a small
+// interpreter instead of a chain of node evals. Constant subtrees are folded into constant
+// nodes here. Nodes the interpreter doesn't know are built the usual way, and called from
+// the program. These are what build_value_node() and friends hand out.
+const struct valueNode *compile_value_node(struct cr_scene *s_ext, const struct cr_value_node *desc);
+const struct colorNode *compile_color_node(struct cr_scene *s_ext, const struct cr_color_node *desc);
+const struct vectorNode *compile_vector_node(struct cr_scene *s_ext, const struct cr_vector_node *desc);
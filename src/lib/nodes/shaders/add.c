@@ -48,8 +48,10 @@ static void dump(const void *node, char *dumpbuf, int bufsize) {
 
 static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record) {
 	struct addBsdf *mixBsdf = (struct addBsdf *)bsdf;
-	struct bsdfSample A = mixBsdf->A->sample(mixBsdf->A, sampler, record);
+	// B is sampled first, so its direction gets the same numbers it would get on its own.
+	// A only contributes its weight, so it doesn't matter which numbers it ends up with.
 	struct bsdfSample B = mixBsdf->B->sample(mixBsdf->B, sampler, record);
+	struct bsdfSample A = mixBsdf->A->sample(mixBsdf->A, sampler, record);
 	// TODO: Do we just add the outgoing vertices together or what...?
 	// TODO: Find out if we want to even keep this node around.
 	// FIXME: Hackery. We're using B.out here, so our fake Principled Shader graph works
@@ -57,7 +59,7 @@ static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, c
 	// we're not supposed to compute the out direction here.
 	// Cycles does the add with OSL shading closures, instead of at this stage, so we'd have to
 	// do something similar to that, probably.
-	return (struct bsdfSample){.out = B.out, .weight = colorAdd(A.weight, B.weight)};
+	return (struct bsdfSample){ .out = B.out, .weight = colorAdd(A.weight, B.weight), .emitted = colorAdd(A.emitted, B.emitted) };
 }
 
 const struct bsdfNode *newAdd(const struct node_storage *s, const struct bsdfNode *A, const struct bsdfNode *B) {
@@ -46,8 +46,8 @@ static void dump(const void *node, char *dumpbuf, int bufsize) {
 	snprintf(dumpbuf, bufsize, "backgroundBsdf { color: %s, strength: %s }", color, strength);
 }
 
-static inline void recompute_uv(struct hitRecord *isect, float offset, bool blender) {
-	struct vector ud = vec_normalize(isect->incident->direction);
+static inline struct coord background_uv(struct vector direction, float offset, bool blender) {
+	struct vector ud = vec_normalize(direction);
 	//To polar from cartesian
 	float r = 1.0f; //Normalized above
 	float phi;
@@ -66,23 +66,29 @@ static inline void recompute_uv(struct hitRecord *isect, float offset, bool blen
 	u = wrap_min_max(u, 0.0f, 1.0f);
 	v = wrap_min_max(v, 0.0f, 1.0f);
 
-	isect->uv = (struct coord){ u, v };
+	return (struct coord){ u, v };
 }
 
 static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record) {
 	(void)sampler;
 	struct backgroundBsdf *background = (struct backgroundBsdf *)bsdf;
 	float strength = background->strength->eval(background->strength, sampler, record);
-	float pose = background->pose->eval(background->pose, sampler, record).f;
-	pose = deg_to_rad(pose) / 4.0f;
-	struct hitRecord copy = *record;
-	recompute_uv(&copy, pose, background->blender);
 	return (struct bsdfSample){
 		.out = { { 0 } },
-		.weight = colorCoef(strength, background->color->eval(background->color, sampler, &copy))
+		.weight = colorCoef(strength, background->color->eval(background->color, sampler, record))
 	};
 }
 
+void background_record(const struct bsdfNode *bsdf, sampler *sampler, struct lightRay *ray, struct hitRecord *record) {
+	*record = (struct hitRecord){ .incident = ray, .instIndex = -1 };
+	if (!bsdf || bsdf->sample != sample) return;
+	const struct backgroundBsdf *background = (const struct backgroundBsdf *)bsdf;
+	float pose = background->pose->eval(background->pose, sampler, record).f;
+	pose = deg_to_rad(pose) / 4.0f;
+	record->uv = background_uv(ray->direction, pose, background->blender);
+	record->has_uv = true;
+}
+
 const struct bsdfNode *newBackground(const struct node_storage *s, const struct colorNode *tex, const struct valueNode *strength, const struct vectorNode *pose, bool blender) {
 	HASH_CONS(s->node_table, hash, struct backgroundBsdf, {
 		.color = tex ? tex : newConstantTexture(s, g_gray_color),
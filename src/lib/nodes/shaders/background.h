@@ -9,3 +9,7 @@
 #pragma once
 
 const struct bsdfNode *newBackground(const struct node_storage *s, const struct colorNode *tex, const struct valueNode *strength, const struct vectorNode *pose, bool blender);
+
+// Shading context for a ray that left the scene. For backgrounds from newBackground(),
+// uv is set to where the background texture is looked up in that direction.
+void background_record(const struct bsdfNode *background, sampler *sampler, struct lightRay *ray, struct hitRecord *record);
@@ -14,6 +14,7 @@
 #include "../../renderer/samplers/vec.h"
 #include "../../datatypes/scene.h"
 #include "../bsdfnode.h"
+#include "microfacet.h"
 
 #include "glass.h"
 
@@ -49,13 +50,13 @@ static void dump(const void *node, char *dumpbuf, int bufsize) {
 	snprintf(dumpbuf, bufsize, "glassBsdf { color: %s, roughness: %s, IOR: %s }", color, roughness, IOR);
 }
 
-static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record) {
+static struct bsdfSample sample_smooth(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record) {
 	struct glassBsdf *glassBsdf = (struct glassBsdf *)bsdf;
 	
 	struct vector outwardNormal;
 	struct vector reflected = vec_reflect(record->incident->direction, record->surfaceNormal);
 	float niOverNt;
-	struct vector refracted;
+	struct vector refracted = vec_zero();
 	float reflectionProbability;
 	float cosine;
 	
@@ -77,20 +78,13 @@ static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, c
 		reflectionProbability = 1.0f;
 	}
 	
-	float roughness = glassBsdf->roughness->eval(glassBsdf->roughness, sampler, record);
-	if (roughness > 0.0f) {
-		struct vector fuzz = vec_scale(vec_on_unit_sphere(sampler), roughness);
-		reflected = vec_add(reflected, fuzz);
-		refracted = vec_add(refracted, fuzz);
-	}
-	
 	struct lightRay out = { .start = record->hitPoint };
 	if (getDimension(sampler) < reflectionProbability) {
 		out.direction = reflected;
-		out.type = rt_reflection | (roughness == 0.0f ? rt_singular : rt_glossy);
+		out.type = rt_reflection | rt_singular;
 	} else {
 		out.direction = refracted;
-		out.type = rt_transmission | (roughness == 0.0f ? rt_singular : rt_glossy);
+		out.type = rt_transmission | rt_singular;
 	}
 	
 	return (struct bsdfSample){
@@ -99,13 +93,135 @@ static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, c
 	};
 }
 
+// Schlick's approximation for light crossing a microfacet h from the side wo is on.
+// eta is the ratio of the IOR on that side to the other, 0 tells wi would be internally reflected.
+static float fresnel(struct vector wo, struct vector h, float eta, float IOR) {
+	const float cos_i = vec_dot(wo, h);
+	if (eta <= 1.0f) return schlick(cos_i, IOR);
+	const float sin2_t = eta * eta * max(1.0f - cos_i * cos_i, 0.0f);
+	if (sin2_t >= 1.0f) return 1.0f;
+	return schlick(sqrtf(1.0f - sin2_t), IOR);
+}
+
+// Refract wo through a microfacet h, see fresnel() for eta
+static struct vector refract(struct vector wo, struct vector h, float eta) {
+	const float cos_i = vec_dot(wo, h);
+	const float cos_t = sqrtf(max(1.0f - eta * eta * max(1.0f - cos_i * cos_i, 0.0f), 0.0f));
+	return vec_add(vec_scale(wo, -eta), vec_scale(h, eta * cos_i - cos_t));
+}
+
+// Shared setup for the rough paths: the side the incident ray is on and the ratio of IORs across the surface
+struct rough_setup {
+	struct ggx_frame frame;
+	struct vector wo;
+	float alpha;
+	float eta;
+	float IOR;
+};
+
+static struct rough_setup rough_setup(const struct glassBsdf *this, sampler *sampler, const struct hitRecord *record, float roughness) {
+	const float IOR = this->IOR->eval(this->IOR, sampler, record);
+	const struct vector wo = vec_negate(vec_normalize(record->incident->direction));
+	const struct ggx_frame frame = ggx_shading_frame(record, wo);
+	// Same inside test as the smooth path
+	const bool inside = vec_dot(record->incident->direction, record->surfaceNormal) > 0.0f;
+	return (struct rough_setup){
+		.frame = frame,
+		.wo = ggx_to_local(&frame, wo),
+		.alpha = ggx_alpha(roughness),
+		.eta = inside ? IOR : 1.0f / IOR,
+		.IOR = IOR,
+	};
+}
+
+// Half vector and Fresnel for a pair of local directions, on the side of the frame normal.
+// Returns false if the pair can't be connected through a single microfacet.
+static bool rough_half_vector(const struct rough_setup *r, struct vector wi, struct vector *h) {
+	if (r->wo.z <= 0.0f || wi.z == 0.0f) return false;
+	if (wi.z > 0.0f) {
+		*h = vec_normalize(vec_add(r->wo, wi));
+	} else {
+		*h = vec_normalize(vec_negate(vec_add(vec_scale(r->wo, r->eta), wi)));
+		if (h->z < 0.0f) *h = vec_negate(*h);
+		if (vec_dot(r->wo, *h) <= 0.0f || vec_dot(wi, *h) >= 0.0f) return false;
+	}
+	return true;
+}
+
+// Like the sample weights, refraction leaves out the radiance scaling by the IOR ratio
+static struct color eval(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	struct glassBsdf *this = (struct glassBsdf *)bsdf;
+	const float roughness = this->roughness->eval(this->roughness, sampler, record);
+	if (roughness <= 0.0f) return g_black_color;
+	const struct rough_setup r = rough_setup(this, sampler, record, roughness);
+	const struct vector wi = ggx_to_local(&r.frame, out);
+	struct vector h;
+	if (!rough_half_vector(&r, wi, &h)) return g_black_color;
+	const float F = fresnel(r.wo, h, r.eta, r.IOR);
+	float f;
+	if (wi.z > 0.0f) {
+		f = F * ggx_reflect_eval(r.wo, wi, r.alpha);
+	} else {
+		const float o_h = vec_dot(r.wo, h);
+		const float i_h = vec_dot(wi, h);
+		const float denom = r.eta * o_h + i_h;
+		f = (1.0f - F) * ggx_D(h, r.alpha) * ggx_G2(r.wo, wi, r.alpha) * o_h * fabsf(i_h) / (r.wo.z * denom * denom);
+	}
+	return colorCoef(f, this->color->eval(this->color, sampler, record));
+}
+
+static float pdf(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	struct glassBsdf *this = (struct glassBsdf *)bsdf;
+	const float roughness = this->roughness->eval(this->roughness, sampler, record);
+	if (roughness <= 0.0f) return 0.0f;
+	const struct rough_setup r = rough_setup(this, sampler, record, roughness);
+	const struct vector wi = ggx_to_local(&r.frame, out);
+	struct vector h;
+	if (!rough_half_vector(&r, wi, &h)) return 0.0f;
+	const float F = fresnel(r.wo, h, r.eta, r.IOR);
+	if (wi.z > 0.0f) return F * ggx_reflect_pdf(r.wo, wi, r.alpha);
+	const float i_h = vec_dot(wi, h);
+	const float denom = r.eta * vec_dot(r.wo, h) + i_h;
+	return (1.0f - F) * ggx_visible_pdf(r.wo, h, r.alpha) * fabsf(i_h) / (denom * denom);
+}
+
+// Rough dielectric after Walter et al. 2007, with normals sampled from the visible distribution.
+// Reflection and refraction are picked by Fresnel, so both lobes weigh G2 / G1.
+static struct bsdfSample sample_rough(const struct glassBsdf *this, sampler *sampler, const struct hitRecord *record, float roughness) {
+	const struct rough_setup r = rough_setup(this, sampler, record, roughness);
+	const float u1 = getDimension(sampler);
+	const float u2 = getDimension(sampler);
+	const struct vector h = ggx_sample_visible(r.wo, r.alpha, u1, u2);
+	const float F = fresnel(r.wo, h, r.eta, r.IOR);
+	const bool reflect = getDimension(sampler) < F;
+	const struct vector wi = reflect ? vec_reflect(vec_negate(r.wo), h) : refract(r.wo, h, r.eta);
+	const float weight = (reflect ? wi.z > 0.0f : wi.z < 0.0f) ? ggx_G2(r.wo, wi, r.alpha) / ggx_G1(r.wo, r.alpha) : 0.0f;
+	const struct vector out = ggx_to_world(&r.frame, wi);
+	return (struct bsdfSample){
+		.out = { .start = record->hitPoint, .direction = out, .type = (reflect ? rt_reflection : rt_transmission) | rt_glossy },
+		.pdf = weight > 0.0f ? pdf(&this->bsdf, sampler, record, out) : 0.0f,
+		.weight = colorCoef(weight, this->color->eval(this->color, sampler, record))
+	};
+}
+
+static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record) {
+	struct glassBsdf *glassBsdf = (struct glassBsdf *)bsdf;
+	const float roughness = glassBsdf->roughness->eval(glassBsdf->roughness, sampler, record);
+	if (roughness <= 0.0f) return sample_smooth(bsdf, sampler, record);
+	return sample_rough(glassBsdf, sampler, record, roughness);
+}
+
 const struct bsdfNode *newGlass(const struct node_storage *s, const struct colorNode *color, const struct valueNode *roughness, const struct valueNode *IOR) {
+	if (!roughness) roughness = newConstantValue(s, 0.0f);
+	const bool smooth = roughness == newConstantValue(s, 0.0f);
 	HASH_CONS(s->node_table, hash, struct glassBsdf, {
 		.color = color ? color : newConstantTexture(s, g_black_color),
-		.roughness = roughness ? roughness : newConstantValue(s, 0.0f),
+		.roughness = roughness,
 		.IOR = IOR ? IOR : newConstantValue(s, 1.45f),
 		.bsdf = {
 			.sample = sample,
+			.eval = smooth ? NULL : eval,
+			.pdf = smooth ? NULL : pdf,
 			.base = { .compare = compare, .dump = dump }
 		}
 	});
@@ -49,15 +49,30 @@ static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, c
 	const struct vector scatterDir = vec_on_unit_sphere(sampler);
 	return (struct bsdfSample){
 		.out = { .start= record->hitPoint, .direction = scatterDir, .type = rt_transmission | rt_diffuse },
+		.pdf = 1.0f / (4.0f * PI),
 		.weight = isoBsdf->color->eval(isoBsdf->color, sampler, record)
 	};
 }
 
+// Phase function, there's no cosine term in a volume
+static struct color eval(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	(void)out;
+	struct isotropicBsdf *isoBsdf = (struct isotropicBsdf *)bsdf;
+	return colorCoef(1.0f / (4.0f * PI), isoBsdf->color->eval(isoBsdf->color, sampler, record));
+}
+
+static float pdf(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	(void)bsdf; (void)sampler; (void)record; (void)out;
+	return 1.0f / (4.0f * PI);
+}
+
 const struct bsdfNode *newIsotropic(const struct node_storage *s, const struct colorNode *color) {
 	HASH_CONS(s->node_table, hash, struct isotropicBsdf, {
 		.color = color ? color : newConstantTexture(s, g_black_color),
 		.bsdf = {
 			.sample = sample,
+			.eval = eval,
+			.pdf = pdf,
 			.base = { .compare = compare, .dump = dump }
 		}
 	});
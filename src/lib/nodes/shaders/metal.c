@@ -14,6 +14,7 @@
 #include "../../../common/hashtable.h"
 #include "../../datatypes/scene.h"
 #include "../bsdfnode.h"
+#include "microfacet.h"
 
 #include "metal.h"
 
@@ -50,25 +51,61 @@ static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, c
 	struct metalBsdf *metalBsdf = (struct metalBsdf *)bsdf;
 	
 	const struct vector normalizedDir = vec_normalize(record->incident->direction);
-	struct vector reflected = vec_reflect(normalizedDir, record->surfaceNormal);
-	float roughness = metalBsdf->roughness->eval(metalBsdf->roughness, sampler, record);
-	if (roughness > 0.0f) {
-		const struct vector fuzz = vec_scale(vec_on_unit_sphere(sampler), roughness);
-		reflected = vec_add(reflected, fuzz);
+	const float roughness = metalBsdf->roughness->eval(metalBsdf->roughness, sampler, record);
+	if (roughness <= 0.0f) {
+		return (struct bsdfSample){
+			.out = { .start = record->hitPoint, .direction = vec_reflect(normalizedDir, record->surfaceNormal), .type = rt_reflection | rt_singular },
+			.weight = metalBsdf->color->eval(metalBsdf->color, sampler, record)
+		};
 	}
-	
+
+	const float alpha = ggx_alpha(roughness);
+	const struct vector wo = vec_negate(normalizedDir);
+	const struct ggx_frame frame = ggx_shading_frame(record, wo);
+	const struct vector wo_local = ggx_to_local(&frame, wo);
+	const float u1 = getDimension(sampler);
+	const float u2 = getDimension(sampler);
+	struct vector wi;
+	const float weight = ggx_sample_reflect(wo_local, alpha, u1, u2, &wi);
 	return (struct bsdfSample){
-		.out = { .start = record->hitPoint, .direction = reflected, .type = rt_reflection | (roughness == 0.0f ? rt_singular : rt_glossy) },
-		.weight = metalBsdf->color->eval(metalBsdf->color, sampler, record)
+		.out = { .start = record->hitPoint, .direction = ggx_to_world(&frame, wi), .type = rt_reflection | rt_glossy },
+		.pdf = weight > 0.0f ? ggx_reflect_pdf(wo_local, wi, alpha) : 0.0f,
+		.weight = colorCoef(weight, metalBsdf->color->eval(metalBsdf->color, sampler, record))
 	};
 }
 
+// The color is used as the reflectance at all angles, so the lobe has no separate Fresnel term
+static struct color eval(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	struct metalBsdf *metalBsdf = (struct metalBsdf *)bsdf;
+	const float roughness = metalBsdf->roughness->eval(metalBsdf->roughness, sampler, record);
+	if (roughness <= 0.0f) return g_black_color;
+	const struct vector wo = vec_negate(vec_normalize(record->incident->direction));
+	const struct ggx_frame frame = ggx_shading_frame(record, wo);
+	const float f = ggx_reflect_eval(ggx_to_local(&frame, wo), ggx_to_local(&frame, out), ggx_alpha(roughness));
+	if (f <= 0.0f) return g_black_color;
+	return colorCoef(f, metalBsdf->color->eval(metalBsdf->color, sampler, record));
+}
+
+static float pdf(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	struct metalBsdf *metalBsdf = (struct metalBsdf *)bsdf;
+	const float roughness = metalBsdf->roughness->eval(metalBsdf->roughness, sampler, record);
+	if (roughness <= 0.0f) return 0.0f;
+	const struct vector wo = vec_negate(vec_normalize(record->incident->direction));
+	const struct ggx_frame frame = ggx_shading_frame(record, wo);
+	return ggx_reflect_pdf(ggx_to_local(&frame, wo), ggx_to_local(&frame, out), ggx_alpha(roughness));
+}
+
 const struct bsdfNode *newMetal(const struct node_storage *s, const struct colorNode *color, const struct valueNode *roughness) {
+	if (!roughness) roughness = newConstantValue(s, 0.0f);
+	// Constants are shared, so this catches mirrors, which are only ever sampled
+	const bool smooth = roughness == newConstantValue(s, 0.0f);
 	HASH_CONS(s->node_table, hash, struct metalBsdf, {
 		.color = color ? color : newConstantTexture(s, g_black_color),
-		.roughness = roughness ? roughness : newConstantValue(s, 0.0f),
+		.roughness = roughness,
 		.bsdf = {
 			.sample = sample,
+			.eval = smooth ? NULL : eval,
+			.pdf = smooth ? NULL : pdf,
 			.base = { .compare = compare, .dump = dump }
 		}
 	});
@@ -0,0 +1,113 @@
+//
+//  microfacet.h
+//  c-ray
+//
+
+#pragma once
+
+#include "../../../includes.h"
+#include "../../../common/vector.h"
+#include "../../datatypes/hitrecord.h"
+
+// GGX (Trowbridge-Reitz) microfacet distribution, shared by the rough metal, plastic and glass shaders.
+// Everything below works in a local shading frame where z is the normal, see struct ggx_frame.
+
+struct ggx_frame {
+	struct vector t, b, n;
+};
+
+// Shading frame around the surface normal, flipped if needed so wo is always on the z+ side
+static inline struct ggx_frame ggx_shading_frame(const struct hitRecord *record, struct vector wo) {
+	const bool flip = vec_dot(wo, record->surfaceNormal) < 0.0f;
+	return (struct ggx_frame){
+		.t = record->tangent,
+		.b = flip ? vec_negate(record->bitangent) : record->bitangent,
+		.n = flip ? vec_negate(record->surfaceNormal) : record->surfaceNormal,
+	};
+}
+
+static inline struct vector ggx_to_local(const struct ggx_frame *f, struct vector v) {
+	return (struct vector){ vec_dot(v, f->t), vec_dot(v, f->b), vec_dot(v, f->n) };
+}
+
+static inline struct vector ggx_to_world(const struct ggx_frame *f, struct vector v) {
+	return vec_add(vec_add(vec_scale(f->t, v.x), vec_scale(f->b, v.y)), vec_scale(f->n, v.z));
+}
+
+// Perceptually linear roughness to distribution width. Very small widths are clamped
+// to keep D() finite, an exact 0 is left to the caller as a singular lobe.
+static inline float ggx_alpha(float roughness) {
+	const float r = clamp(roughness, 0.0f, 1.0f);
+	return max(r * r, 1e-4f);
+}
+
+// Distribution of normals h
+static inline float ggx_D(struct vector h, float alpha) {
+	if (h.z <= 0.0f) return 0.0f;
+	const float a2 = alpha * alpha;
+	const float d = h.z * h.z * (a2 - 1.0f) + 1.0f;
+	return a2 / (PI * d * d);
+}
+
+static inline float ggx_lambda(struct vector w, float alpha) {
+	const float cos2 = w.z * w.z;
+	if (cos2 <= 0.0f) return 0.0f;
+	const float tan2 = max(1.0f - cos2, 0.0f) / cos2;
+	return 0.5f * (sqrtf(1.0f + alpha * alpha * tan2) - 1.0f);
+}
+
+// Smith masking for one direction
+static inline float ggx_G1(struct vector w, float alpha) {
+	return 1.0f / (1.0f + ggx_lambda(w, alpha));
+}
+
+// Height correlated masking-shadowing for a pair of directions
+static inline float ggx_G2(struct vector wo, struct vector wi, float alpha) {
+	return 1.0f / (1.0f + ggx_lambda(wo, alpha) + ggx_lambda(wi, alpha));
+}
+
+// Sample a normal from the distribution of normals visible from wo (Heitz 2018).
+// Only picks normals wo can actually see, so weights stay close to 1 even at grazing angles.
+static inline struct vector ggx_sample_visible(struct vector wo, float alpha, float u1, float u2) {
+	const struct vector vh = vec_normalize((struct vector){ alpha * wo.x, alpha * wo.y, wo.z });
+	const float len_sq = vh.x * vh.x + vh.y * vh.y;
+	const struct vector t1 = len_sq > 0.0f ? vec_scale((struct vector){ -vh.y, vh.x, 0.0f }, 1.0f / sqrtf(len_sq)) : (struct vector){ 1.0f, 0.0f, 0.0f };
+	const struct vector t2 = vec_cross(vh, t1);
+	const float r = sqrtf(u1);
+	const float phi = 2.0f * PI * u2;
+	const float p1 = r * cosf(phi);
+	const float s = 0.5f * (1.0f + vh.z);
+	const float p2 = (1.0f - s) * sqrtf(max(1.0f - p1 * p1, 0.0f)) + s * r * sinf(phi);
+	const float p3 = sqrtf(max(1.0f - p1 * p1 - p2 * p2, 0.0f));
+	const struct vector nh = vec_add(vec_add(vec_scale(t1, p1), vec_scale(t2, p2)), vec_scale(vh, p3));
+	return vec_normalize((struct vector){ alpha * nh.x, alpha * nh.y, max(nh.z, 0.0f) });
+}
+
+// Density of ggx_sample_visible() returning h
+static inline float ggx_visible_pdf(struct vector wo, struct vector h, float alpha) {
+	if (wo.z <= 0.0f) return 0.0f;
+	return ggx_G1(wo, alpha) * max(vec_dot(wo, h), 0.0f) * ggx_D(h, alpha) / wo.z;
+}
+
+// Reflection lobe without Fresnel, times the cosine term. Callers scale by their own Fresnel.
+static inline float ggx_reflect_eval(struct vector wo, struct vector wi, float alpha) {
+	if (wo.z <= 0.0f || wi.z <= 0.0f) return 0.0f;
+	const struct vector h = vec_normalize(vec_add(wo, wi));
+	return ggx_D(h, alpha) * ggx_G2(wo, wi, alpha) / (4.0f * wo.z);
+}
+
+// Solid angle pdf of picking wi by reflecting wo off a visible normal
+static inline float ggx_reflect_pdf(struct vector wo, struct vector wi, float alpha) {
+	if (wo.z <= 0.0f || wi.z <= 0.0f) return 0.0f;
+	const struct vector h = vec_normalize(vec_add(wo, wi));
+	return ggx_visible_pdf(wo, h, alpha) / (4.0f * vec_dot(wo, h));
+}
+
+// Reflect wo off a sampled visible normal into wi. Returns the sample weight f * cos / pdf, without
+// Fresnel, or 0 if wi ended up below the surface.
+static inline float ggx_sample_reflect(struct vector wo, float alpha, float u1, float u2, struct vector *wi) {
+	const struct vector h = ggx_sample_visible(wo, alpha, u1, u2);
+	*wi = vec_reflect(vec_negate(wo), h);
+	if (wi->z <= 0.0f) return 0.0f;
+	return ggx_G2(wo, *wi, alpha) / ggx_G1(wo, alpha);
+}
@@ -52,11 +52,36 @@ static void dump(const void *node, char *dumpbuf, int bufsize) {
 static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record) {
 	struct mixBsdf *mixBsdf = (struct mixBsdf *)bsdf;
 	const float lerp = mixBsdf->factor->eval(mixBsdf->factor, sampler, record);
-	if (getDimension(sampler) > lerp) {
-		return mixBsdf->A->sample(mixBsdf->A, sampler, record);
-	} else {
-		return mixBsdf->B->sample(mixBsdf->B, sampler, record);
+	// The number that picked a side is stretched back over [0, 1) and handed to that side,
+	// so nested mixes don't each use up a dimension and shift the picked BSDF's numbers along.
+	const float u = getDimension(sampler);
+	const bool pick_a = u >= lerp;
+	reuseDimension(sampler, pick_a ? (u - lerp) / (1.0f - lerp) : u / lerp);
+	const struct bsdfNode *picked = pick_a ? mixBsdf->A : mixBsdf->B;
+	const struct bsdfNode *other = pick_a ? mixBsdf->B : mixBsdf->A;
+	struct bsdfSample s = picked->sample(picked, sampler, record);
+	// Report the pdf of the whole mix, so it matches what pdf() gives for this direction
+	if (s.pdf > 0.0f) {
+		const float other_pdf = other->pdf ? other->pdf(other, sampler, record, s.out.direction) : 0.0f;
+		s.pdf = pick_a ? (1.0f - lerp) * s.pdf + lerp * other_pdf : lerp * s.pdf + (1.0f - lerp) * other_pdf;
 	}
+	return s;
+}
+
+static struct color eval(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	struct mixBsdf *mixBsdf = (struct mixBsdf *)bsdf;
+	const float lerp = mixBsdf->factor->eval(mixBsdf->factor, sampler, record);
+	const struct color A = mixBsdf->A->eval ? mixBsdf->A->eval(mixBsdf->A, sampler, record, out) : g_black_color;
+	const struct color B = mixBsdf->B->eval ? mixBsdf->B->eval(mixBsdf->B, sampler, record, out) : g_black_color;
+	return colorAdd(colorCoef(1.0f - lerp, A), colorCoef(lerp, B));
+}
+
+static float pdf(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	struct mixBsdf *mixBsdf = (struct mixBsdf *)bsdf;
+	const float lerp = mixBsdf->factor->eval(mixBsdf->factor, sampler, record);
+	const float A = mixBsdf->A->pdf ? mixBsdf->A->pdf(mixBsdf->A, sampler, record, out) : 0.0f;
+	const float B = mixBsdf->B->pdf ? mixBsdf->B->pdf(mixBsdf->B, sampler, record, out) : 0.0f;
+	return (1.0f - lerp) * A + lerp * B;
 }
 
 const struct bsdfNode *newMix(const struct node_storage *s, const struct bsdfNode *A, const struct bsdfNode *B, const struct valueNode *factor) {
@@ -64,12 +89,18 @@ const struct bsdfNode *newMix(const struct node_storage *s, const struct bsdfNod
 		logr(debug, "A == B, pruning mix node.\n");
 		return A;
 	}
+	if (!A) A = newDiffuse(s, newConstantTexture(s, g_black_color));
+	if (!B) B = newDiffuse(s, newConstantTexture(s, g_black_color));
+	// Only worth evaluating if at least one side can be
+	const bool can_eval = A->eval || B->eval;
 	HASH_CONS(s->node_table, hash, struct mixBsdf, {
-		.A = A ? A : newDiffuse(s, newConstantTexture(s, g_black_color)),
-		.B = B ? B : newDiffuse(s, newConstantTexture(s, g_black_color)),
+		.A = A,
+		.B = B,
 		.factor = factor ? factor : newConstantValue(s, 0.5f),
 		.bsdf = {
 			.sample = sample,
+			.eval = can_eval ? eval : NULL,
+			.pdf = can_eval ? pdf : NULL,
 			.base = { .compare = compare, .dump = dump }
 		}
 	});
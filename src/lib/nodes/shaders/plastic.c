@@ -16,6 +16,7 @@
 #include "../../datatypes/scene.h"
 #include "../colornode.h"
 #include "../bsdfnode.h"
+#include "microfacet.h"
 
 #include "plastic.h"
 
@@ -58,28 +59,49 @@ static void dump(const void *node, char *dumpbuf, int bufsize) {
 
 static struct bsdfSample sampleShiny(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record) {
 	struct plasticBsdf *plastic = (struct plasticBsdf *)bsdf;
-	struct vector reflected = vec_reflect(record->incident->direction, record->surfaceNormal);
-	//Roughness
-	float roughness = plastic->roughness->eval(plastic->roughness, sampler, record);
-	if (roughness > 0.0f) {
-		const struct vector fuzz = vec_scale(vec_on_unit_sphere(sampler), roughness);
-		reflected = vec_add(reflected, fuzz);
+	const float roughness = plastic->roughness->eval(plastic->roughness, sampler, record);
+	if (roughness <= 0.0f) {
+		return (struct bsdfSample){
+			.out = { .start = record->hitPoint, .direction = vec_reflect(record->incident->direction, record->surfaceNormal), .type = rt_reflection | rt_singular },
+			.weight = plastic->clear_coat->eval(plastic->clear_coat, sampler, record)
+		};
 	}
+	const float alpha = ggx_alpha(roughness);
+	const struct vector wo = vec_negate(vec_normalize(record->incident->direction));
+	const struct ggx_frame frame = ggx_shading_frame(record, wo);
+	const struct vector wo_local = ggx_to_local(&frame, wo);
+	const float u1 = getDimension(sampler);
+	const float u2 = getDimension(sampler);
+	struct vector wi;
+	const float weight = ggx_sample_reflect(wo_local, alpha, u1, u2, &wi);
 	return (struct bsdfSample){
-		.out = { .start = record->hitPoint, .direction = reflected, .type = rt_reflection | (roughness == 0.0f ? rt_singular : rt_glossy) },
-		.weight = plastic->clear_coat->eval(plastic->clear_coat, sampler, record)
+		.out = { .start = record->hitPoint, .direction = ggx_to_world(&frame, wi), .type = rt_reflection | rt_glossy },
+		.pdf = weight > 0.0f ? ggx_reflect_pdf(wo_local, wi, alpha) : 0.0f,
+		.weight = colorCoef(weight, plastic->clear_coat->eval(plastic->clear_coat, sampler, record))
 	};
 }
 
-static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record) {
+// Clear coat lobe for out and its pdf, both zero if the coat is a perfect mirror here
+static float coat_lobe(const struct plasticBsdf *this, sampler *sampler, const struct hitRecord *record, struct vector out, float *pdf) {
+	*pdf = 0.0f;
+	const float roughness = this->roughness->eval(this->roughness, sampler, record);
+	if (roughness <= 0.0f) return 0.0f;
+	const float alpha = ggx_alpha(roughness);
+	const struct vector wo = vec_negate(vec_normalize(record->incident->direction));
+	const struct ggx_frame frame = ggx_shading_frame(record, wo);
+	const struct vector wo_local = ggx_to_local(&frame, wo);
+	const struct vector wi_local = ggx_to_local(&frame, out);
+	*pdf = ggx_reflect_pdf(wo_local, wi_local, alpha);
+	return ggx_reflect_eval(wo_local, wi_local, alpha);
+}
+
+// Chance of a ray bouncing off the clear coat instead of reaching the diffuse base
+static float coat_probability(const struct plasticBsdf *this, sampler *sampler, const struct hitRecord *record) {
 	struct vector outwardNormal;
 	float niOverNt;
 	struct vector refracted;
-	float reflectionProbability;
 	float cosine;
 	
-	struct plasticBsdf *this = (struct plasticBsdf *)bsdf;
-	
 	const float IOR = this->IOR->eval(this->IOR, sampler, record);
 	
 	if (vec_dot(record->incident->direction, record->surfaceNormal) > 0.0f) {
@@ -93,19 +115,51 @@ static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, c
 	}
 	
 	if (vec_refract(record->incident->direction, outwardNormal, niOverNt, &refracted)) {
-		reflectionProbability = schlick(cosine, IOR);
-	} else {
-		reflectionProbability = 1.0f;
+		return schlick(cosine, IOR);
 	}
-	
-	if (getDimension(sampler) < reflectionProbability) {
-		return sampleShiny(bsdf, sampler, record);
+	return 1.0f;
+}
+
+// The coat and the base are picked by the coat Fresnel term, so each lobe is weighted by its chance of being picked
+static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record) {
+	struct plasticBsdf *this = (struct plasticBsdf *)bsdf;
+	const float reflectionProbability = coat_probability(this, sampler, record);
+	struct bsdfSample s;
+	// Same remapping as in mix.c, the picked lobe gets the number back
+	const float u = getDimension(sampler);
+	const bool coat = u < reflectionProbability;
+	reuseDimension(sampler, coat ? u / reflectionProbability : (u - reflectionProbability) / (1.0f - reflectionProbability));
+	if (coat) {
+		s = sampleShiny(bsdf, sampler, record);
+		if (s.pdf > 0.0f) s.pdf = reflectionProbability * s.pdf + (1.0f - reflectionProbability) * this->diffuse->pdf(this->diffuse, sampler, record, s.out.direction);
 	} else {
-		return this->diffuse->sample(this->diffuse, sampler, record);
+		s = this->diffuse->sample(this->diffuse, sampler, record);
+		float coat_pdf;
+		coat_lobe(this, sampler, record, s.out.direction, &coat_pdf);
+		s.pdf = (1.0f - reflectionProbability) * s.pdf + reflectionProbability * coat_pdf;
 	}
+	return s;
+}
+
+// A mirror coat can't be evaluated, that leaves just the diffuse base
+static struct color eval(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	struct plasticBsdf *this = (struct plasticBsdf *)bsdf;
+	const float coat = coat_probability(this, sampler, record);
+	const struct color base = colorCoef(1.0f - coat, this->diffuse->eval(this->diffuse, sampler, record, out));
+	float coat_pdf;
+	const float f = coat_lobe(this, sampler, record, out, &coat_pdf);
+	if (f <= 0.0f) return base;
+	return colorAdd(base, colorCoef(coat * f, this->clear_coat->eval(this->clear_coat, sampler, record)));
+}
+
+static float pdf(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	struct plasticBsdf *this = (struct plasticBsdf *)bsdf;
+	const float coat = coat_probability(this, sampler, record);
+	float coat_pdf;
+	coat_lobe(this, sampler, record, out, &coat_pdf);
+	return (1.0f - coat) * this->diffuse->pdf(this->diffuse, sampler, record, out) + coat * coat_pdf;
 }
 
-// TODO: Separate clear coat + base colors
 const struct bsdfNode *newPlastic(const struct node_storage *s, const struct colorNode *color, const struct valueNode *roughness, const struct valueNode *IOR) {
 	HASH_CONS(s->node_table, hash, struct plasticBsdf, {
 		.diffuse = newDiffuse(s, color),
@@ -114,6 +168,8 @@ const struct bsdfNode *newPlastic(const struct node_storage *s, const struct col
 		.IOR = IOR ? IOR : newConstantValue(s, 1.45f),
 		.bsdf = {
 			.sample = sample,
+			.eval = eval,
+			.pdf = pdf,
 			.base = { .compare = compare, .dump = dump }
 		}
 	});
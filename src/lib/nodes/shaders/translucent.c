@@ -49,15 +49,31 @@ static struct bsdfSample sample(const struct bsdfNode *bsdf, sampler *sampler, c
 	const struct vector scatterDir = vec_normalize(vec_add(vec_negate(record->surfaceNormal), vec_on_unit_sphere(sampler)));
 	return (struct bsdfSample){
 			.out = { .start = record->hitPoint, .direction = scatterDir, .type = rt_transmission | rt_diffuse },
+			.pdf = max(-vec_dot(record->surfaceNormal, scatterDir), 0.0f) / PI,
 			.weight = diffBsdf->color->eval(diffBsdf->color, sampler, record)
 	};
 }
 
+// Diffuse, but on the far side of the surface
+static struct color eval(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	struct translucentBsdf *diffBsdf = (struct translucentBsdf *)bsdf;
+	const float cos_theta = -vec_dot(record->surfaceNormal, out);
+	if (cos_theta <= 0.0f) return g_black_color;
+	return colorCoef(cos_theta / PI, diffBsdf->color->eval(diffBsdf->color, sampler, record));
+}
+
+static float pdf(const struct bsdfNode *bsdf, sampler *sampler, const struct hitRecord *record, struct vector out) {
+	(void)bsdf; (void)sampler;
+	return max(-vec_dot(record->surfaceNormal, out), 0.0f) / PI;
+}
+
 const struct bsdfNode *newTranslucent(const struct node_storage *s, const struct colorNode *color) {
 	HASH_CONS(s->node_table, hash, struct translucentBsdf, {
 		.color = color ? color : newConstantTexture(s, g_black_color),
 		.bsdf = {
 				.sample = sample,
+				.eval = eval,
+				.pdf = pdf,
 				.base = { .compare = compare, .dump = dump }
 		}
 	});
@@ -7,11 +7,13 @@
 //
 
 #include <stdio.h>
+#include <string.h>
 #include "../../../common/color.h"
 #include "../../../common/hashtable.h"
 #include "../../datatypes/hitrecord.h"
 #include "../../datatypes/scene.h"
 #include "../colornode.h"
+#include "../../renderer/samplers/common.h"
 
 #include "alpha.h"
 
@@ -46,6 +48,7 @@ static float eval(const struct valueNode *node, sampler *sampler, const struct h
 }
 
 const struct valueNode *newAlpha(const struct node_storage *s, const struct colorNode *color) {
+	if (color && color->constant) return newConstantValue(s, color->eval(color, NULL, NULL).alpha);
 	HASH_CONS(s->node_table, hash, struct alphaNode, {
 		.color = color ? color : newConstantTexture(s, g_white_color),
 		.node = {
@@ -54,3 +57,16 @@ const struct valueNode *newAlpha(const struct node_storage *s, const struct colo
 		}
 	});
 }
+
+bool alpha_mask_test(const struct valueNode *mask, struct coord uv, const struct lightRay *ray, uint32_t seed) {
+	const struct hitRecord record = { .uv = uv };
+	const float alpha = mask->eval(mask, NULL, &record);
+	if (alpha >= 1.0f) return true;
+	if (alpha <= 0.0f) return false;
+	uint32_t words[6];
+	memcpy(&words[0], &ray->start, sizeof(ray->start));
+	memcpy(&words[3], &ray->direction, sizeof(ray->direction));
+	uint32_t h = sampler_hash(seed);
+	for (size_t i = 0; i < 6; ++i) h = sampler_hash(h ^ words[i]);
+	return uintToUnitReal(h) < alpha;
+}
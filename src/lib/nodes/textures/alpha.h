@@ -8,6 +8,16 @@
 
 #pragma once
 
+#include <stdint.h>
+#include "../../../common/vector.h"
+
 struct colorNode;
+struct lightRay;
 
 const struct valueNode *newAlpha(const struct node_storage *s, const struct colorNode *color);
+
+// Check if a candidate hit on a cut-out is solid. This runs during traversal, where only the texture
+// coordinates are known, so masks can only depend on uv. The mask is evaluated without a sampler, so
+// bsdf_buffer_add() only hands images and constants to this. Partially transparent texels let a fraction
+// of rays through. Which ones is picked by hashing the ray and seed, so it doesn't use up sampler dimensions.
+bool alpha_mask_test(const struct valueNode *mask, struct coord uv, const struct lightRay *ray, uint32_t seed);
@@ -53,6 +53,7 @@ const struct colorNode *newConstantTexture(const struct node_storage *s, const s
 		.color = color,
 		.node = {
 			.eval = eval,
+			.constant = true,
 			.base = { .compare = compare, .dump = dump }
 		}
 	});
@@ -98,7 +98,7 @@ static struct color eval(const struct colorNode *node, sampler *sampler, const s
 }
 
 const struct colorNode *newHSVTransform(const struct node_storage *s, const struct colorNode *tex, const struct valueNode *H, const struct valueNode *S, const struct valueNode *V, const struct valueNode *f) {
-	HASH_CONS(s->node_table, hash, struct HSVTransform, {
+	const struct HSVTransform transform = {
 		.tex = tex ? tex : newConstantTexture(s, g_white_color),
 		.H = H ? H : newConstantValue(s, 0.5f),
 		.S = S ? S : newConstantValue(s, 1.0f),
@@ -108,5 +108,9 @@ const struct colorNode *newHSVTransform(const struct node_storage *s, const stru
 				.eval = eval,
 				.base = { .compare = compare, .dump = dump }
 		}
-	});
+	};
+	if (transform.tex->constant && transform.H->constant && transform.S->constant && transform.V->constant && transform.f->constant) {
+		return newConstantTexture(s, eval(&transform.node, NULL, NULL));
+	}
+	HASH_CONS(s->node_table, hash, struct HSVTransform, transform);
 }
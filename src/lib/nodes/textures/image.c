@@ -23,33 +23,33 @@ struct imageTexture {
 	struct colorNode node;
 	const struct texture *tex;
 	uint8_t options;
+	// sRGB -> linear for 8 bit textures, so we don't need powf() for every lookup. NULL otherwise
+	const float *table;
 };
 
 //Transform the intersection coordinates to the texture coordinate space
 //And grab the color at that point. Texture mapping.
-struct color internalColor(const struct texture *tex, const struct hitRecord *isect, uint8_t options) {
+static struct color internalColor(const struct texture *tex, const struct hitRecord *isect, uint8_t options, const float *lut) {
 	if (!tex) return g_pink_color;
 	
+	//Pick the mip level where the footprint of the lookup covers about one texel
+	const float du = max(fabsf(isect->duvdx.x), fabsf(isect->duvdy.x)) * tex->width;
+	const float dv = max(fabsf(isect->duvdx.y), fabsf(isect->duvdy.y)) * tex->height;
+	const float width = max(du, dv);
+	const float lod = width > 1.0f ? log2f(width) : 0.0f;
+
 	//Get the color value at these XY coordinates
-	struct color output;
-	if (options & NO_BILINEAR) {
-		float x = isect->uv.x * tex->width;
-		float y = isect->uv.y * tex->height;
-		output = textureGetPixel(tex, x, y, false);
-	} else {
-		output = textureGetPixel(tex, isect->uv.x, isect->uv.y, true);
-	}
+	struct color output = textureGetPixelLOD(tex, isect->uv.x, isect->uv.y, lod, !(options & NO_BILINEAR), lut);
 	
-	//Since the texture is probably srgb, transform it back to linear colorspace for rendering
-	//FIXME: Why is this done during rendering?
-	if (options & SRGB_TRANSFORM) output = colorFromSRGB(output);
+	//Float textures don't go through the table, so those still get transformed here
+	if (options & SRGB_TRANSFORM && !lut) output = colorFromSRGB(output);
 	return output;
 }
 
 static bool compare(const void *A, const void *B) {
 	const struct imageTexture *this = A;
 	const struct imageTexture *other = B;
-	return this->tex == other->tex;
+	return this->tex == other->tex && this->options == other->options;
 }
 
 static uint32_t hash(const void *p) {
@@ -78,20 +78,23 @@ static void dump(const void *node, char *dumpbuf, int len) {
 }
 
 static struct color eval(const struct colorNode *node, sampler *sampler, const struct hitRecord *record) {
-	// TODO: Consider transforming image textures while loading textures.
 	(void)sampler;
 	struct imageTexture *image = (struct imageTexture *)node;
-	return internalColor(image->tex, record, image->options);
+	return internalColor(image->tex, record, image->options, image->table);
 }
 
 const struct colorNode *newImageTexture(const struct node_storage *s, const struct texture *texture, uint8_t options) {
 	if (!texture) return NULL;
-	HASH_CONS(s->node_table, hash, struct imageTexture, {
+	struct imageTexture image = {
 		.tex = texture,
 		.options = options,
 		.node = {
 			.eval = eval,
 			.base = { .compare = compare, .dump = dump }
 		}
-	});
+	};
+	if (options & SRGB_TRANSFORM && texture->precision == char_p) {
+		image.table = textureSRGBTable();
+	}
+	HASH_CONS(s->node_table, hash, struct imageTexture, image);
 }
@@ -17,6 +17,8 @@
 
 #include "vectornode.h"
 #include "valuenode.h"
+#include "program.h"
+#include "cache.h"
 
 struct constantValue {
 	struct valueNode node;
@@ -59,7 +61,7 @@ const struct valueNode *newConstantValue(const struct node_storage *s, float val
 	});
 }
 
-const struct valueNode *build_value_node(struct cr_scene *s_ext, const struct cr_value_node *desc) {
+const struct valueNode *build_single_value_node(struct cr_scene *s_ext, const struct cr_value_node *desc) {
 	if (!s_ext || !desc) return NULL;
 	struct world *scene = (struct world *)s_ext;
 	struct node_storage s = scene->storage;
@@ -89,7 +91,13 @@ const struct valueNode *build_value_node(struct cr_scene *s_ext, const struct cr
 				desc->arg.math.op);
 		case cr_vn_grayscale:
 			return newGrayscaleConverter(&s, build_color_node(s_ext, desc->arg.grayscale.color));
+		case cr_vn_cache:
+			return new_value_cache(s_ext, build_value_node(s_ext, desc->arg.cache.value), desc->arg.cache.resolution);
 		default:
 			return NULL;
 	}
 }
+
+const struct valueNode *build_value_node(struct cr_scene *s_ext, const struct cr_value_node *desc) {
+	return compile_value_node(s_ext, desc);
+}
@@ -28,4 +28,7 @@ struct valueNode {
 
 const struct valueNode *newConstantValue(const struct node_storage *s, float value);
 
+// Just the node desc describes, its inputs are built with build_value_node() and friends
+const struct valueNode *build_single_value_node(struct cr_scene *s_ext, const struct cr_value_node *desc);
+
 const struct valueNode *build_value_node(struct cr_scene *s_ext, const struct cr_value_node *desc);
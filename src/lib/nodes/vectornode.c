@@ -18,6 +18,7 @@
 
 #include "valuenode.h"
 #include "vectornode.h"
+#include "program.h"
 
 struct constantVector {
 	struct vectorNode node;
@@ -99,7 +100,7 @@ const struct vectorNode *newConstantUV(const struct node_storage *s, const struc
 	});
 }
 
-const struct vectorNode *build_vector_node(struct cr_scene *s_ext, const struct cr_vector_node *desc) {
+const struct vectorNode *build_single_vector_node(struct cr_scene *s_ext, const struct cr_vector_node *desc) {
 	if (!s_ext || !desc) return NULL;
 	struct world *scene = (struct world *)s_ext;
 	struct node_storage s = scene->storage;
@@ -128,3 +129,6 @@ const struct vectorNode *build_vector_node(struct cr_scene *s_ext, const struct
 	};
 }
 
+const struct vectorNode *build_vector_node(struct cr_scene *s_ext, const struct cr_vector_node *desc) {
+	return compile_vector_node(s_ext, desc);
+}
@@ -32,4 +32,7 @@ struct vectorNode {
 const struct vectorNode *newConstantVector(const struct node_storage *storage, struct vector vector);
 const struct vectorNode *newConstantUV(const struct node_storage *s, const struct coord c);
 
+// Just the node desc describes, its inputs are built with build_vector_node() and friends
+const struct vectorNode *build_single_vector_node(struct cr_scene *s_ext, const struct cr_vector_node *desc);
+
 const struct vectorNode *build_vector_node(struct cr_scene *s_ext, const struct cr_vector_node *desc);
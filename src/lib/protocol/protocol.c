@@ -502,6 +502,11 @@ static cJSON *serialize_value_node(const struct cr_value_node *in) {
 			cJSON_AddItemToObject(out, "b", serialize_value_node(in->arg.math.B));
 			cJSON_AddNumberToObject(out, "op", in->arg.math.op);
 			break;
+		case cr_vn_cache:
+			cJSON_AddStringToObject(out, "type", "cache");
+			cJSON_AddItemToObject(out, "value", serialize_value_node(in->arg.cache.value));
+			cJSON_AddNumberToObject(out, "resolution", in->arg.cache.resolution);
+			break;
 		case cr_vn_grayscale:
 		default:
 			cJSON_AddStringToObject(out, "type", "grayscale");
@@ -631,6 +636,11 @@ static cJSON *serialize_color_node(const struct cr_color_node *in) {
 				cJSON_AddItemToArray(array, element);
 			}
 			break;
+		case cr_cn_cache:
+			cJSON_AddStringToObject(out, "type", "cache");
+			cJSON_AddItemToObject(out, "color", serialize_color_node(in->arg.cache.color));
+			cJSON_AddNumberToObject(out, "resolution", in->arg.cache.resolution);
+			break;
 	}
 	return out;
 }
@@ -713,6 +723,7 @@ static cJSON *serialize_scene(const struct world *in) {
 		cJSON *asset = cJSON_CreateObject();
 		cJSON_AddItemToObject(asset, "p", cJSON_CreateString(in->textures.items[i].path));
 		cJSON_AddItemToObject(asset, "t", serialize_texture(in->textures.items[i].t));
+		cJSON_AddBoolToObject(asset, "s", in->textures.items[i].srgb);
 		cJSON_AddItemToArray(textures, asset);
 	}
 	cJSON_AddItemToObject(out, "textures", textures);
@@ -786,7 +797,8 @@ struct world *deserialize_scene(const cJSON *in) {
 		cJSON_ArrayForEach(texture, textures) {
 			texture_asset_arr_add(&out->textures, (struct texture_asset){
 				.path = stringCopy(cJSON_GetStringValue(cJSON_GetObjectItem(texture, "p"))),
-				.t = deserialize_texture(cJSON_GetObjectItem(texture, "t"))
+				.t = deserialize_texture(cJSON_GetObjectItem(texture, "t")),
+				.srgb = cJSON_IsTrue(cJSON_GetObjectItem(texture, "s"))
 			});
 		}
 	}
@@ -806,9 +818,7 @@ struct world *deserialize_scene(const cJSON *in) {
 			if (cJSON_IsArray(s_buffer)) {
 				cJSON *description = NULL;
 				cJSON_ArrayForEach(description, s_buffer) {
-					struct cr_shader_node *desc = deserialize_shader_node(description);
-					cr_shader_node_ptr_arr_add(&buf->descriptions, desc);
-					bsdf_node_ptr_arr_add(&buf->bsdfs, build_bsdf_node((struct cr_scene *)out, desc));
+					bsdf_buffer_add((struct cr_scene *)out, buf, deserialize_shader_node(description));
 				}
 			}
 		}
@@ -869,9 +879,18 @@ static cJSON *serialize_prefs(const struct prefs in) {
 	cJSON *out = cJSON_CreateObject();
 	cJSON_AddItemToObject(out, "samples", cJSON_CreateNumber(in.sampleCount));
 	cJSON_AddItemToObject(out, "bounces", cJSON_CreateNumber(in.bounces));
+	cJSON_AddItemToObject(out, "diffuseBounces", cJSON_CreateNumber(in.diffuse_bounces));
+	cJSON_AddItemToObject(out, "glossyBounces", cJSON_CreateNumber(in.glossy_bounces));
+	cJSON_AddItemToObject(out, "transmissionBounces", cJSON_CreateNumber(in.transmission_bounces));
+	cJSON_AddItemToObject(out, "rouletteStartDepth", cJSON_CreateNumber(in.rr_start_depth));
+	cJSON_AddItemToObject(out, "rouletteMinProbability", cJSON_CreateNumber(in.rr_min_probability));
+	cJSON_AddItemToObject(out, "indirectClamp", cJSON_CreateNumber(in.indirect_clamp));
+	cJSON_AddItemToObject(out, "medianOfMeans", cJSON_CreateBool(in.median_of_means));
+	cJSON_AddItemToObject(out, "sortShading", cJSON_CreateBool(in.sort_shading));
 	cJSON_AddItemToObject(out, "tileWidth", cJSON_CreateNumber(in.tileWidth));
 	cJSON_AddItemToObject(out, "tileHeight", cJSON_CreateNumber(in.tileHeight));
 	cJSON_AddItemToObject(out, "tileOrder", cJSON_CreateNumber(in.tileOrder));
+	cJSON_AddItemToObject(out, "sampler", cJSON_CreateNumber(in.sampler));
 	cJSON_AddItemToObject(out, "outputFilePath", cJSON_CreateString(in.imgFilePath));
 	cJSON_AddItemToObject(out, "outputFileName", cJSON_CreateString(in.imgFileName));
 	cJSON_AddItemToObject(out, "count", cJSON_CreateNumber(in.imgCount));
@@ -886,9 +905,25 @@ struct prefs deserialize_prefs(const cJSON *in) {
 	if (!in) return p;
 	p.sampleCount = cJSON_GetNumberValue(cJSON_GetObjectItem(in, "samples"));
 	p.bounces = cJSON_GetNumberValue(cJSON_GetObjectItem(in, "bounces"));
+	const cJSON *diffuse_bounces = cJSON_GetObjectItem(in, "diffuseBounces");
+	if (cJSON_IsNumber(diffuse_bounces)) p.diffuse_bounces = diffuse_bounces->valueint;
+	const cJSON *glossy_bounces = cJSON_GetObjectItem(in, "glossyBounces");
+	if (cJSON_IsNumber(glossy_bounces)) p.glossy_bounces = glossy_bounces->valueint;
+	const cJSON *transmission_bounces = cJSON_GetObjectItem(in, "transmissionBounces");
+	if (cJSON_IsNumber(transmission_bounces)) p.transmission_bounces = transmission_bounces->valueint;
+	const cJSON *rr_start_depth = cJSON_GetObjectItem(in, "rouletteStartDepth");
+	if (cJSON_IsNumber(rr_start_depth)) p.rr_start_depth = rr_start_depth->valueint;
+	const cJSON *rr_min_probability = cJSON_GetObjectItem(in, "rouletteMinProbability");
+	if (cJSON_IsNumber(rr_min_probability)) p.rr_min_probability = rr_min_probability->valuedouble;
+	const cJSON *indirect_clamp = cJSON_GetObjectItem(in, "indirectClamp");
+	if (cJSON_IsNumber(indirect_clamp)) p.indirect_clamp = indirect_clamp->valuedouble;
+	p.median_of_means = cJSON_IsTrue(cJSON_GetObjectItem(in, "medianOfMeans"));
+	p.sort_shading = cJSON_IsTrue(cJSON_GetObjectItem(in, "sortShading"));
 	p.tileWidth = cJSON_GetNumberValue(cJSON_GetObjectItem(in, "tileWidth"));
 	p.tileHeight = cJSON_GetNumberValue(cJSON_GetObjectItem(in, "tileHeight"));
 	p.tileOrder = cJSON_GetNumberValue(cJSON_GetObjectItem(in, "tileOrder"));
+	const cJSON *sampler = cJSON_GetObjectItem(in, "sampler");
+	if (cJSON_IsNumber(sampler)) p.sampler = sampler->valueint;
 	free(p.imgFilePath);
 	free(p.imgFileName);
 	p.imgFilePath = stringCopy(cJSON_GetStringValue(cJSON_GetObjectItem(in, "outputFilePath")));
@@ -21,6 +21,8 @@
 
 #include "../renderer/renderer.h"
 #include "../renderer/pathtrace.h"
+#include "../renderer/accumulator.h"
+#include "../nodes/cache.h"
 #include "../datatypes/tile.h"
 #include "../datatypes/scene.h"
 #include "../datatypes/camera.h"
@@ -127,7 +129,11 @@ static void *workerThread(void *arg) {
 	mutex_lock(sockMutex);
 	thread->current = getWork(sock, thread->tiles);
 	mutex_release(sockMutex);
-	sampler *sampler = newSampler();
+	struct sampler sampler_state = { .node_cache = r->scene->has_cache_nodes ? node_cache_new() : NULL };
+	sampler *sampler = &sampler_state;
+	const struct path_limits limits = path_limits_from_prefs(&r->prefs);
+	struct path_batch batch_state = { 0 };
+	struct path_batch *batch = r->prefs.sort_shading ? &batch_state : NULL;
 
 	struct camera *cam = thread->cam;
 	
@@ -135,38 +141,50 @@ static void *workerThread(void *arg) {
 	thread->completedSamples = 1;
 	
 	struct texture *tileBuffer = NULL;
+	struct tile_accum accum = { 0 };
 	while (thread->current && r->state.rendering) {
 		if (!tileBuffer || tileBuffer->width != thread->current->width || tileBuffer->height != thread->current->height) {
 			destroyTexture(tileBuffer);
 			tileBuffer = newTexture(float_p, thread->current->width, thread->current->height, 3);
 		}
+		accum_reset(&accum, thread->current->width, thread->current->height, false, r->prefs.median_of_means, false);
 		long totalUsec = 0;
 		long samples = 0;
 		
 		while (thread->completedSamples < r->prefs.sampleCount+1 && r->state.rendering) {
 			timer_start(&timer);
-			for (int y = thread->current->end.y - 1; y > thread->current->begin.y - 1; --y) {
-				for (int x = thread->current->begin.x; x < thread->current->end.x; ++x) {
-					if (r->state.render_aborted || !g_running) goto bail;
-					uint32_t pixIdx = (uint32_t)(y * cam->width + x);
-					initSampler(sampler, SAMPLING_STRATEGY, thread->completedSamples - 1, r->prefs.sampleCount, pixIdx);
-					
-					int local_x = x - thread->current->begin.x;
-					int local_y = y - thread->current->begin.y;
-					struct color output = textureGetPixel(tileBuffer, local_x, local_y, false);
-					struct color sample = path_trace(cam_get_ray(cam, x, y, sampler), r->scene, r->prefs.bounces, sampler);
-
-					nan_clamp(&sample, &output);
-					
-					//And process the running average
-					output = colorCoef((float)(thread->completedSamples - 1), output);
-					output = colorAdd(output, sample);
-					float t = 1.0f / thread->completedSamples;
-					output = colorCoef(t, output);
-					
-					setPixel(tileBuffer, output, local_x, local_y);
+			if (batch) path_batch_reset(batch, thread->current->width * thread->current->height, false);
+			for (size_t i = 0; i < accum.blocks_x * accum.blocks_y; ++i) {
+				const struct accum_block *b = &accum.blocks[i];
+				for (unsigned by = b->begin_y; by < b->end_y; ++by) {
+					const int y = thread->current->begin.y + by;
+					for (unsigned bx = b->begin_x; bx < b->end_x; ++bx) {
+						if (r->state.render_aborted || !g_running) goto bail;
+						const int x = thread->current->begin.x + bx;
+						uint32_t pixIdx = (uint32_t)(y * cam->width + x);
+						initSampler(sampler, r->prefs.sampler, thread->completedSamples - 1, r->prefs.sampleCount, pixIdx);
+						if (batch) {
+							path_batch_add(batch, cam_get_ray(cam, x, y, sampler), sampler);
+							continue;
+						}
+						struct color sample = path_trace(cam_get_ray(cam, x, y, sampler), r->scene, &limits, sampler, NULL, NULL);
+						accum_add(&accum, b, bx, by, sample);
+					}
+				}
+			}
+			if (batch) {
+				path_batch_trace(batch, r->scene, &limits, NULL);
+				size_t path = 0;
+				for (size_t i = 0; i < accum.blocks_x * accum.blocks_y; ++i) {
+					const struct accum_block *b = &accum.blocks[i];
+					for (unsigned by = b->begin_y; by < b->end_y; ++by) {
+						for (unsigned bx = b->begin_x; bx < b->end_x; ++bx) {
+							accum_add(&accum, b, bx, by, path_batch_result(batch, path++, NULL));
+						}
+					}
 				}
 			}
+			accum_pass_done(&accum);
 			//For performance metrics
 			samples++;
 			totalUsec += timer_get_us(timer);
@@ -174,6 +192,7 @@ static void *workerThread(void *arg) {
 			thread->current->completed_samples++;
 			thread->avgSampleTime = totalUsec / samples;
 		}
+		accum_flush(&accum, tileBuffer, 0, 0);
 		
 		thread->current->state = finished;
 		mutex_lock(sockMutex);
@@ -196,8 +215,10 @@ static void *workerThread(void *arg) {
 		tex_clear(tileBuffer);
 	}
 bail:
-	destroySampler(sampler);
+	node_cache_free(sampler_state.node_cache);
 	destroyTexture(tileBuffer);
+	accum_free(&accum);
+	path_batch_free(&batch_state);
 	
 	thread->threadComplete = true;
 	return 0;
@@ -233,7 +254,7 @@ static cJSON *startRender(int connectionSocket, size_t thread_limit) {
 	logr(info, "%u x %u tiles\n", r->prefs.tileWidth, r->prefs.tileHeight);
 	// Do some pre-render preparations
 	// Compute BVH acceleration structures for all meshes in the scene
-	compute_accels(r->scene->meshes);
+	compute_accels(renderer_thread_pool(r), r->scene->meshes);
 
 	// And then compute a single top-level BVH that contains all the objects
 	logr(info, "Computing top-level BVH: ");
@@ -242,6 +263,8 @@ static cJSON *startRender(int connectionSocket, size_t thread_limit) {
 	r->scene->topLevel = build_top_level_bvh(r->scene->instances);
 	printSmartTime(timer_get_ms(timer));
 	logr(plain, "\n");
+	lights_build(&r->scene->lights, r->scene);
+	env_map_build(&r->scene->env, env_map_wanted(r->scene->bg_desc) ? r->scene->background : NULL);
 
 	for (size_t i = 0; i < set.tiles.count; ++i)
 		set.tiles.items[i].total_samples = r->prefs.sampleCount;
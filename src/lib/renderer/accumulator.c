@@ -0,0 +1,226 @@
+//
+//  accumulator.c
+//  c-ray
+//
+
+#include "../../includes.h"
+#include "accumulator.h"
+
+#include <string.h>
+#include <math.h>
+#include "../../common/texture.h"
+#include "../../common/assert.h"
+
+// Pixels darker than this are compared against it instead of their own mean,
+// otherwise near-black pixels would need a huge amount of samples to converge.
+#define ACCUM_DARK_FLOOR 0.05f
+
+void accum_reset(struct tile_accum *a, size_t width, size_t height, bool track_variance, bool median_of_means, bool aov) {
+	const size_t pixels = width * height;
+	if (pixels > a->capacity) {
+		free(a->sum);
+		free(a->lum_sq);
+		free(a->batches);
+		free(a->albedo);
+		free(a->normal);
+		a->sum = malloc(pixels * sizeof(*a->sum));
+		a->lum_sq = NULL;
+		a->batches = NULL;
+		a->albedo = NULL;
+		a->normal = NULL;
+		a->capacity = pixels;
+	}
+	if (track_variance && !a->lum_sq) a->lum_sq = malloc(a->capacity * sizeof(*a->lum_sq));
+	if (median_of_means && !a->batches) a->batches = malloc(a->capacity * ACCUM_MOM_BATCHES * sizeof(*a->batches));
+	if (aov && !a->albedo) {
+		a->albedo = malloc(a->capacity * sizeof(*a->albedo));
+		a->normal = malloc(a->capacity * sizeof(*a->normal));
+	}
+	memset(a->sum, 0, pixels * sizeof(*a->sum));
+	if (track_variance) memset(a->lum_sq, 0, pixels * sizeof(*a->lum_sq));
+	if (median_of_means) memset(a->batches, 0, pixels * ACCUM_MOM_BATCHES * sizeof(*a->batches));
+	if (aov) {
+		memset(a->albedo, 0, pixels * sizeof(*a->albedo));
+		memset(a->normal, 0, pixels * sizeof(*a->normal));
+	}
+	a->width = width;
+	a->height = height;
+	a->track_variance = track_variance;
+	a->median_of_means = median_of_means;
+	a->aov = aov;
+
+	a->blocks_x = (width + ACCUM_BLOCK_SIZE - 1) / ACCUM_BLOCK_SIZE;
+	a->blocks_y = (height + ACCUM_BLOCK_SIZE - 1) / ACCUM_BLOCK_SIZE;
+	const size_t blocks = a->blocks_x * a->blocks_y;
+	if (blocks > a->block_capacity) {
+		free(a->blocks);
+		a->blocks = malloc(blocks * sizeof(*a->blocks));
+		a->block_capacity = blocks;
+	}
+	for (size_t by = 0; by < a->blocks_y; ++by) {
+		for (size_t bx = 0; bx < a->blocks_x; ++bx) {
+			a->blocks[by * a->blocks_x + bx] = (struct accum_block){
+				.begin_x = bx * ACCUM_BLOCK_SIZE,
+				.begin_y = by * ACCUM_BLOCK_SIZE,
+				.end_x = min((bx + 1) * ACCUM_BLOCK_SIZE, width),
+				.end_y = min((by + 1) * ACCUM_BLOCK_SIZE, height),
+				.active = true
+			};
+		}
+	}
+	a->active_blocks = blocks;
+}
+
+size_t accum_pass_done(struct tile_accum *a) {
+	size_t taken = 0;
+	for (size_t i = 0; i < a->blocks_x * a->blocks_y; ++i) {
+		struct accum_block *b = &a->blocks[i];
+		if (!b->active) continue;
+		b->samples++;
+		b->dirty = true;
+		taken += (b->end_x - b->begin_x) * (b->end_y - b->begin_y);
+	}
+	return taken;
+}
+
+static bool block_converged(const struct tile_accum *a, const struct accum_block *b, float threshold) {
+	const float n = (float)b->samples;
+	for (unsigned y = b->begin_y; y < b->end_y; ++y) {
+		for (unsigned x = b->begin_x; x < b->end_x; ++x) {
+			const size_t idx = accum_index(a, x, y);
+			const float mean = accum_luminance(a->sum[idx]) / n;
+			const float variance = max(a->lum_sq[idx] / n - mean * mean, 0.0f) * n / (n - 1.0f);
+			const float std_error = sqrtf(variance / n);
+			if (std_error > threshold * max(mean, ACCUM_DARK_FLOOR)) return false;
+		}
+	}
+	return true;
+}
+
+size_t accum_retire_blocks(struct tile_accum *a, float threshold, size_t min_samples, size_t max_samples) {
+	ASSERT(a->track_variance);
+	min_samples = max(min_samples, 2);
+	for (size_t i = 0; i < a->blocks_x * a->blocks_y; ++i) {
+		struct accum_block *b = &a->blocks[i];
+		if (!b->active || b->samples < min_samples) continue;
+		if (b->samples >= max_samples || block_converged(a, b, threshold)) {
+			b->active = false;
+			a->active_blocks--;
+		}
+	}
+	return a->active_blocks;
+}
+
+// Batch mean with the median luminance out of the ACCUM_MOM_BATCHES batches of pixel idx
+static struct color median_of_means(const struct tile_accum *a, size_t idx, size_t samples) {
+	struct color means[ACCUM_MOM_BATCHES];
+	float lums[ACCUM_MOM_BATCHES];
+	for (size_t i = 0; i < ACCUM_MOM_BATCHES; ++i) {
+		// Samples are dealt out in turn, so the first samples % ACCUM_MOM_BATCHES batches have one extra
+		const size_t count = samples / ACCUM_MOM_BATCHES + (i < samples % ACCUM_MOM_BATCHES ? 1 : 0);
+		means[i] = colorCoef(1.0f / (float)count, a->batches[idx * ACCUM_MOM_BATCHES + i]);
+		lums[i] = accum_luminance(means[i]);
+	}
+	// Insertion sort, there's only a handful
+	for (size_t i = 1; i < ACCUM_MOM_BATCHES; ++i) {
+		for (size_t j = i; j > 0 && lums[j - 1] > lums[j]; --j) {
+			const float lum = lums[j];
+			lums[j] = lums[j - 1];
+			lums[j - 1] = lum;
+			const struct color mean = means[j];
+			means[j] = means[j - 1];
+			means[j - 1] = mean;
+		}
+	}
+	return means[ACCUM_MOM_BATCHES / 2];
+}
+
+static void flush_median_of_means(const struct tile_accum *a, const struct accum_block *b, struct texture *t, size_t x, size_t y) {
+	for (unsigned by = b->begin_y; by < b->end_y; ++by) {
+		for (unsigned bx = b->begin_x; bx < b->end_x; ++bx) {
+			const struct color c = median_of_means(a, accum_index(a, bx, by), b->samples);
+			float *dst = &t->data.float_p[((t->height - (y + by + 1)) * t->width + x + bx) * t->channels];
+			dst[0] = c.red;
+			dst[1] = c.green;
+			dst[2] = c.blue;
+			if (t->channels > 3) dst[3] = c.alpha;
+		}
+	}
+}
+
+void accum_flush(struct tile_accum *a, struct texture *t, size_t x, size_t y) {
+	ASSERT(t->precision == float_p);
+	ASSERT(x + a->width <= t->width);
+	ASSERT(y + a->height <= t->height);
+	const size_t channels = t->channels;
+	for (size_t i = 0; i < a->blocks_x * a->blocks_y; ++i) {
+		struct accum_block *b = &a->blocks[i];
+		if (!b->dirty) continue;
+		b->dirty = false;
+		if (a->median_of_means && b->samples >= ACCUM_MOM_BATCHES) {
+			flush_median_of_means(a, b, t, x, y);
+			continue;
+		}
+		const float inv = 1.0f / (float)b->samples;
+		for (unsigned by = b->begin_y; by < b->end_y; ++by) {
+			const struct color *src = &a->sum[accum_index(a, b->begin_x, by)];
+			// Textures store the bottom row first, same as accum_index()
+			float *dst = &t->data.float_p[((t->height - (y + by + 1)) * t->width + x + b->begin_x) * channels];
+			const size_t count = b->end_x - b->begin_x;
+			if (channels > 3) {
+				for (size_t col = 0; col < count; ++col) {
+					dst[0] = src[col].red * inv;
+					dst[1] = src[col].green * inv;
+					dst[2] = src[col].blue * inv;
+					dst[3] = src[col].alpha * inv;
+					dst += channels;
+				}
+			} else {
+				for (size_t col = 0; col < count; ++col) {
+					dst[0] = src[col].red * inv;
+					dst[1] = src[col].green * inv;
+					dst[2] = src[col].blue * inv;
+					dst += channels;
+				}
+			}
+		}
+	}
+}
+
+void accum_flush_aov(const struct tile_accum *a, struct texture *albedo, struct texture *normal, size_t x, size_t y) {
+	ASSERT(a->aov);
+	ASSERT(albedo->precision == float_p && albedo->channels == 3);
+	ASSERT(normal->precision == float_p && normal->channels == 3);
+	for (size_t i = 0; i < a->blocks_x * a->blocks_y; ++i) {
+		const struct accum_block *b = &a->blocks[i];
+		if (!b->dirty) continue;
+		const float inv = 1.0f / (float)b->samples;
+		for (unsigned by = b->begin_y; by < b->end_y; ++by) {
+			const size_t src = accum_index(a, b->begin_x, by);
+			const size_t dst = ((albedo->height - (y + by + 1)) * albedo->width + x + b->begin_x) * 3;
+			float *dst_albedo = &albedo->data.float_p[dst];
+			float *dst_normal = &normal->data.float_p[dst];
+			for (size_t col = 0; col < b->end_x - b->begin_x; ++col) {
+				const struct color c = a->albedo[src + col];
+				const struct vector n = a->normal[src + col];
+				dst_albedo[col * 3 + 0] = c.red * inv;
+				dst_albedo[col * 3 + 1] = c.green * inv;
+				dst_albedo[col * 3 + 2] = c.blue * inv;
+				dst_normal[col * 3 + 0] = n.x * inv;
+				dst_normal[col * 3 + 1] = n.y * inv;
+				dst_normal[col * 3 + 2] = n.z * inv;
+			}
+		}
+	}
+}
+
+void accum_free(struct tile_accum *a) {
+	if (!a) return;
+	free(a->sum);
+	free(a->lum_sq);
+	free(a->batches);
+	free(a->albedo);
+	free(a->normal);
+	free(a->blocks);
+	*a = (struct tile_accum){ 0 };
+}
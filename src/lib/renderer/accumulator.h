@@ -0,0 +1,112 @@
+//
+//  accumulator.h
+//  c-ray
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include "../../common/color.h"
+#include "../../common/vector.h"
+
+struct texture;
+
+// Pixels are grouped into square blocks that share a sample count. Adaptive
+// sampling decides per block, since per-pixel variance estimates are too noisy
+// on their own to stop sampling on.
+#define ACCUM_BLOCK_SIZE 8
+
+// Batches for the median of means estimator. Odd, so there's always one in the middle.
+#define ACCUM_MOM_BATCHES 5
+
+struct accum_block {
+	unsigned begin_x, begin_y; // Relative to the tile origin
+	unsigned end_x, end_y;
+	size_t samples;
+	bool active;
+	bool dirty; // Got samples since the last flush
+};
+
+// Per-tile sample accumulator. Render threads sum up samples for the tile they're
+// working on here, and only write averages out to a texture once per sample pass.
+// Rows are stored top to bottom in the same order as the texture memory, so
+// flushing is a straight copy with no per-pixel index math.
+struct tile_accum {
+	struct color *sum;
+	float *lum_sq; // Sum of squared sample luminance, only if variance is tracked
+	struct color *batches; // ACCUM_MOM_BATCHES sums per pixel, only with median_of_means
+	struct color *albedo; // Denoiser input sums, only if AOVs are tracked
+	struct vector *normal;
+	size_t capacity; // In pixels
+	size_t width;
+	size_t height;
+	struct accum_block *blocks;
+	size_t block_capacity;
+	size_t blocks_x;
+	size_t blocks_y;
+	size_t active_blocks;
+	bool track_variance;
+	bool median_of_means;
+	bool aov;
+};
+
+// Clear the accumulator and make sure it fits a width * height tile.
+// With median_of_means, samples are also dealt out into batches in turn, and flushing writes
+// out the batch mean in the middle by luminance instead of the plain mean. A single huge sample
+// then only skews one batch, and that batch gets passed over. This gives up some energy while
+// sample counts are low, but it converges to the same result as the mean.
+// With aov, the albedo and normal of each sample are summed up too, see accum_add_aov().
+void accum_reset(struct tile_accum *a, size_t width, size_t height, bool track_variance, bool median_of_means, bool aov);
+
+static inline size_t accum_index(const struct tile_accum *a, size_t x, size_t y) {
+	return (a->height - (y + 1)) * a->width + x;
+}
+
+static inline float accum_luminance(struct color c) {
+	return 0.2126f * c.red + 0.7152f * c.green + 0.0722f * c.blue;
+}
+
+// Add a sample to pixel (x, y) of block b, relative to the tile origin.
+// NaN samples are replaced with the current average, like nan_clamp()
+static inline void accum_add(const struct tile_accum *a, const struct accum_block *b, size_t x, size_t y, struct color sample) {
+	const size_t idx = accum_index(a, x, y);
+	struct color *sum = &a->sum[idx];
+	if (sample.red != sample.red || sample.green != sample.green || sample.blue != sample.blue || sample.alpha != sample.alpha) {
+		sample = b->samples ? colorCoef(1.0f / (float)b->samples, *sum) : g_black_color;
+	}
+	*sum = colorAdd(*sum, sample);
+	if (a->median_of_means) {
+		struct color *batch = &a->batches[idx * ACCUM_MOM_BATCHES + b->samples % ACCUM_MOM_BATCHES];
+		*batch = colorAdd(*batch, sample);
+	}
+	if (a->track_variance) {
+		const float lum = accum_luminance(sample);
+		a->lum_sq[idx] += lum * lum;
+	}
+}
+
+// Add the denoiser inputs of a sample to pixel (x, y). They're averaged over the same sample count as accum_add()
+static inline void accum_add_aov(const struct tile_accum *a, size_t x, size_t y, struct color albedo, struct vector normal) {
+	const size_t idx = accum_index(a, x, y);
+	a->albedo[idx] = colorAdd(a->albedo[idx], albedo);
+	a->normal[idx] = vec_add(a->normal[idx], normal);
+}
+
+// Count a finished pass over every active block. Returns the amount of pixel samples taken.
+size_t accum_pass_done(struct tile_accum *a);
+
+// Retire blocks where every pixel's relative standard error is below threshold,
+// or that have reached max_samples. Blocks with less than min_samples are kept.
+// Returns the amount of blocks still active.
+size_t accum_retire_blocks(struct tile_accum *a, float threshold, size_t min_samples, size_t max_samples);
+
+// Write current averages to a float_p texture, with the tile origin at (x, y).
+// Only blocks that got samples since the last flush are written.
+// Blocks with fewer than ACCUM_MOM_BATCHES samples get the plain mean, even with median_of_means.
+void accum_flush(struct tile_accum *a, struct texture *t, size_t x, size_t y);
+
+// Write albedo and normal averages to 3 channel float_p textures, same as accum_flush().
+// Call this before accum_flush(), which clears the flags of the blocks that need writing.
+void accum_flush_aov(const struct tile_accum *a, struct texture *albedo, struct texture *normal, size_t x, size_t y);
+
+void accum_free(struct tile_accum *a);
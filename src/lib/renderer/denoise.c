@@ -0,0 +1,147 @@
+//
+//  denoise.c
+//  c-ray
+//
+
+#include "../../includes.h"
+#include "denoise.h"
+
+#include "../../common/texture.h"
+#include "../../common/assert.h"
+#include "../../common/platform/thread_pool.h"
+
+/*
+ * Edge-avoiding à-trous wavelet filter, from "Edge-Avoiding À-Trous Wavelet Transform for fast
+ * Global Illumination Filtering" by Dammertz et al. Every pass is a 5x5 B3 spline kernel with
+ * holes in it, twice as wide as in the pass before, so five passes reach over 125x125 pixels.
+ * Taps count less the more their color, normal and albedo differ from the center pixel.
+ * Color is divided by albedo before filtering and multiplied back after, so only lighting is
+ * blurred, and surface textures keep their detail.
+ */
+
+#define DENOISE_PASSES 5
+#define DENOISE_ROWS_PER_TASK 16
+// How far apart neighbours can be before they stop contributing. Colors are compared after
+// squashing them into [0, 1) so bright pixels don't dominate, and that sigma halves every pass.
+#define DENOISE_SIGMA_COLOR 0.5f
+#define DENOISE_SIGMA_NORMAL 0.3f
+#define DENOISE_SIGMA_ALBEDO 0.1f
+// Keeps near black surfaces from blowing up the lighting divided out of them
+#define DENOISE_MIN_ALBEDO 0.01f
+
+struct denoise_task {
+	const float *in; // Lighting, 3 floats per pixel
+	float *out;
+	const struct texture *albedo;
+	const struct texture *normal;
+	size_t row_begin;
+	size_t row_end;
+	size_t step;
+	float inv_sigma_color_sq;
+};
+
+static inline float squash(float v) {
+	return v > 0.0f ? v / (1.0f + v) : 0.0f;
+}
+
+static inline float dist_sq(const float *a, const float *b) {
+	const float d0 = a[0] - b[0];
+	const float d1 = a[1] - b[1];
+	const float d2 = a[2] - b[2];
+	return d0 * d0 + d1 * d1 + d2 * d2;
+}
+
+static void filter_rows(void *arg) {
+	const struct denoise_task *t = arg;
+	static const float kernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+	const size_t width = t->albedo->width;
+	const size_t height = t->albedo->height;
+	const float inv_sigma_normal_sq = 1.0f / (DENOISE_SIGMA_NORMAL * DENOISE_SIGMA_NORMAL);
+	const float inv_sigma_albedo_sq = 1.0f / (DENOISE_SIGMA_ALBEDO * DENOISE_SIGMA_ALBEDO);
+	for (size_t y = t->row_begin; y < t->row_end; ++y) {
+		for (size_t x = 0; x < width; ++x) {
+			const size_t p = y * width + x;
+			const float *color_p = &t->in[p * 3];
+			const float squashed_p[3] = { squash(color_p[0]), squash(color_p[1]), squash(color_p[2]) };
+			const float *normal_p = &t->normal->data.float_p[p * t->normal->channels];
+			const float *albedo_p = &t->albedo->data.float_p[p * t->albedo->channels];
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+			float weight_sum = 0.0f;
+			for (int ky = 0; ky < 5; ++ky) {
+				const int64_t qy = (int64_t)y + (ky - 2) * (int64_t)t->step;
+				if (qy < 0 || qy >= (int64_t)height) continue;
+				for (int kx = 0; kx < 5; ++kx) {
+					const int64_t qx = (int64_t)x + (kx - 2) * (int64_t)t->step;
+					if (qx < 0 || qx >= (int64_t)width) continue;
+					const size_t q = (size_t)qy * width + (size_t)qx;
+					const float *color_q = &t->in[q * 3];
+					const float squashed_q[3] = { squash(color_q[0]), squash(color_q[1]), squash(color_q[2]) };
+					const float distance =
+						dist_sq(squashed_p, squashed_q) * t->inv_sigma_color_sq +
+						dist_sq(normal_p, &t->normal->data.float_p[q * t->normal->channels]) * inv_sigma_normal_sq +
+						dist_sq(albedo_p, &t->albedo->data.float_p[q * t->albedo->channels]) * inv_sigma_albedo_sq;
+					const float weight = kernel[ky] * kernel[kx] * expf(-distance);
+					sum[0] += weight * color_q[0];
+					sum[1] += weight * color_q[1];
+					sum[2] += weight * color_q[2];
+					weight_sum += weight;
+				}
+			}
+			// The center tap always has a weight, so this can't divide by zero
+			t->out[p * 3 + 0] = sum[0] / weight_sum;
+			t->out[p * 3 + 1] = sum[1] / weight_sum;
+			t->out[p * 3 + 2] = sum[2] / weight_sum;
+		}
+	}
+}
+
+void denoise(struct cr_thread_pool *pool, struct texture *color, const struct texture *albedo, const struct texture *normal) {
+	ASSERT(color->precision == float_p && albedo->precision == float_p && normal->precision == float_p);
+	ASSERT(albedo->width == color->width && albedo->height == color->height);
+	ASSERT(normal->width == color->width && normal->height == color->height);
+	const size_t pixels = color->width * color->height;
+	float *front = malloc(pixels * 3 * sizeof(*front));
+	float *back = malloc(pixels * 3 * sizeof(*back));
+
+	for (size_t p = 0; p < pixels; ++p) {
+		for (size_t c = 0; c < 3; ++c) {
+			const float a = max(albedo->data.float_p[p * albedo->channels + c], DENOISE_MIN_ALBEDO);
+			front[p * 3 + c] = color->data.float_p[p * color->channels + c] / a;
+		}
+	}
+
+	const size_t task_count = (color->height + DENOISE_ROWS_PER_TASK - 1) / DENOISE_ROWS_PER_TASK;
+	struct denoise_task *tasks = calloc(task_count, sizeof(*tasks));
+	float sigma_color = DENOISE_SIGMA_COLOR;
+	for (size_t pass = 0; pass < DENOISE_PASSES; ++pass) {
+		for (size_t i = 0; i < task_count; ++i) {
+			tasks[i] = (struct denoise_task){
+				.in = front,
+				.out = back,
+				.albedo = albedo,
+				.normal = normal,
+				.row_begin = i * DENOISE_ROWS_PER_TASK,
+				.row_end = min((i + 1) * DENOISE_ROWS_PER_TASK, color->height),
+				.step = (size_t)1 << pass,
+				.inv_sigma_color_sq = 1.0f / (sigma_color * sigma_color)
+			};
+			thread_pool_enqueue(pool, filter_rows, &tasks[i]);
+		}
+		thread_pool_wait(pool);
+		float *temp = front;
+		front = back;
+		back = temp;
+		sigma_color *= 0.5f;
+	}
+
+	// Alpha is left as it was
+	for (size_t p = 0; p < pixels; ++p) {
+		for (size_t c = 0; c < 3; ++c) {
+			const float a = max(albedo->data.float_p[p * albedo->channels + c], DENOISE_MIN_ALBEDO);
+			color->data.float_p[p * color->channels + c] = front[p * 3 + c] * a;
+		}
+	}
+	free(tasks);
+	free(front);
+	free(back);
+}
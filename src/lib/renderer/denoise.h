@@ -0,0 +1,15 @@
+//
+//  denoise.h
+//  c-ray
+//
+
+#pragma once
+
+struct texture;
+struct cr_thread_pool;
+
+// Filter the noise out of a finished render, in place. albedo and normal are float
+// textures of the same size, averaged over the same samples as color. Edges in them
+// are kept sharp, and surface textures are taken out of color before filtering, so
+// only the lighting gets blurred. Work is split over the threads in pool.
+void denoise(struct cr_thread_pool *pool, struct texture *color, const struct texture *albedo, const struct texture *normal);
@@ -0,0 +1,96 @@
+//
+//  differentials.c
+//  c-ray
+//
+
+#include "../../includes.h"
+#include "differentials.h"
+
+#include "../datatypes/hitrecord.h"
+#include "../datatypes/lightray.h"
+
+static inline float axis(struct vector v, int i) {
+	return i == 0 ? v.x : i == 1 ? v.y : v.z;
+}
+
+// Offset from p to where the ray (start, direction) crosses the plane through p with normal n
+static inline bool plane_offset(struct vector p, struct vector n, struct vector start, struct vector direction, struct vector *out) {
+	const float denom = vec_dot(n, direction);
+	if (denom == 0.0f) return false;
+	const float t = vec_dot(n, vec_sub(p, start)) / denom;
+	*out = vec_sub(vec_add(start, vec_scale(direction, t)), p);
+	return true;
+}
+
+// Least squares solve for (du, dv) in dp = du * dpdu + dv * dpdv, on the two axes the normal is least aligned with
+static inline struct coord solve_uv(const struct hitRecord *isect, struct vector dp) {
+	const struct vector n = isect->geometricNormal;
+	int a = 0, b = 1;
+	if (fabsf(n.x) > fabsf(n.y) && fabsf(n.x) > fabsf(n.z)) {
+		a = 1; b = 2;
+	} else if (fabsf(n.y) > fabsf(n.z)) {
+		a = 0; b = 2;
+	}
+	const float a00 = axis(isect->dpdu, a), a01 = axis(isect->dpdv, a);
+	const float a10 = axis(isect->dpdu, b), a11 = axis(isect->dpdv, b);
+	const float det = a00 * a11 - a01 * a10;
+	if (fabsf(det) < 1e-12f) return (struct coord){ 0.0f, 0.0f };
+	const float inv_det = 1.0f / det;
+	const float b0 = axis(dp, a), b1 = axis(dp, b);
+	const struct coord duv = { (a11 * b0 - a01 * b1) * inv_det, (a00 * b1 - a10 * b0) * inv_det };
+	if (!isfinite(duv.x) || !isfinite(duv.y)) return (struct coord){ 0.0f, 0.0f };
+	return duv;
+}
+
+void hit_differentials(struct hitRecord *isect, const struct lightRay *incident) {
+	isect->dpdx = vec_zero();
+	isect->dpdy = vec_zero();
+	isect->duvdx = (struct coord){ 0.0f, 0.0f };
+	isect->duvdy = (struct coord){ 0.0f, 0.0f };
+	if (!incident->has_differentials) return;
+	const struct vector n = isect->geometricNormal;
+	struct vector dpdx, dpdy;
+	if (!plane_offset(isect->hitPoint, n, incident->rx_start, incident->rx_direction, &dpdx)) return;
+	if (!plane_offset(isect->hitPoint, n, incident->ry_start, incident->ry_direction, &dpdy)) return;
+	isect->dpdx = dpdx;
+	isect->dpdy = dpdy;
+	isect->duvdx = solve_uv(isect, dpdx);
+	isect->duvdy = solve_uv(isect, dpdy);
+}
+
+// PBRT, with the change in normal across the footprint left out
+static inline struct vector reflect_differential(struct vector n, struct vector wo, struct vector wi, struct vector rd) {
+	const struct vector dwo = vec_sub(vec_negate(rd), wo);
+	const float dDN = vec_dot(dwo, n);
+	return vec_add(vec_sub(wi, dwo), vec_scale(n, 2.0f * dDN));
+}
+
+static inline struct vector refract_differential(struct vector n, struct vector wo, struct vector wi, struct vector rd, float eta) {
+	const struct vector dwo = vec_sub(vec_negate(rd), wo);
+	const float dDN = vec_dot(dwo, n);
+	const float dmu = (eta - (eta * eta * vec_dot(wo, n)) / fabsf(vec_dot(wi, n))) * dDN;
+	return vec_add(vec_sub(wi, vec_scale(dwo, eta)), vec_scale(n, dmu));
+}
+
+void scatter_differentials(const struct hitRecord *isect, const struct lightRay *incident, struct lightRay *out) {
+	out->has_differentials = false;
+	if (!incident->has_differentials || !(out->type & rt_singular)) return;
+	// The normal faces the incident ray, so wo is on its side
+	const struct vector n = isect->surfaceNormal;
+	const struct vector wo = vec_negate(vec_normalize(incident->direction));
+	const struct vector wi = vec_normalize(out->direction);
+	out->rx_start = vec_add(isect->hitPoint, isect->dpdx);
+	out->ry_start = vec_add(isect->hitPoint, isect->dpdy);
+	if (vec_dot(wi, n) > 0.0f) {
+		out->rx_direction = reflect_differential(n, wo, wi, incident->rx_direction);
+		out->ry_direction = reflect_differential(n, wo, wi, incident->ry_direction);
+	} else {
+		// Snell's law gives the ratio of the indices from the sines on either side
+		const float sin_i = vec_length(vec_cross(wo, n));
+		const float sin_t = vec_length(vec_cross(wi, n));
+		const float eta = sin_i > 1e-4f ? sin_t / sin_i : 1.0f;
+		out->rx_direction = refract_differential(n, wo, wi, incident->rx_direction, eta);
+		out->ry_direction = refract_differential(n, wo, wi, incident->ry_direction, eta);
+	}
+	out->has_differentials = true;
+}
@@ -0,0 +1,18 @@
+//
+//  differentials.h
+//  c-ray
+//
+
+#pragma once
+
+struct lightRay;
+struct hitRecord;
+
+// Work out dpdx, dpdy and the uv footprint at a hit from where the incident ray's
+// differentials cross the tangent plane. Leaves them zeroed if the ray has none.
+void hit_differentials(struct hitRecord *isect, const struct lightRay *incident);
+
+// Carry the differentials of incident through a singular bounce at isect into out. The surface
+// is treated as locally flat, and the refraction ratio is recovered from the two directions.
+// Other bounces don't keep differentials, and their textures get looked up at full resolution.
+void scatter_differentials(const struct hitRecord *isect, const struct lightRay *incident, struct lightRay *out);
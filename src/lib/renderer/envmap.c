@@ -0,0 +1,159 @@
+//
+//  envmap.c
+//  c-ray
+//
+
+#include "../../includes.h"
+#include "envmap.h"
+
+#include <c-ray/c-ray.h>
+#include "../nodes/bsdfnode.h"
+#include "../../common/logging.h"
+#include "../../common/timer.h"
+
+// Matches the common 1k HDRIs texel for texel, larger ones just get slightly blurrier tables
+#define ENV_MAP_WIDTH 1024
+#define ENV_MAP_HEIGHT 512
+
+static inline struct vector direction(float u, float v) {
+	const float phi = 2.0f * PI * u;
+	const float theta = PI * v;
+	const float sin_theta = sinf(theta);
+	return (struct vector){ sin_theta * cosf(phi), cosf(theta), sin_theta * sinf(phi) };
+}
+
+// Build a cdf with count + 1 entries for a piecewise-constant function over [0, 1]. Returns its integral.
+static float build_cdf(const float *func, size_t count, float *cdf) {
+	cdf[0] = 0.0f;
+	for (size_t i = 0; i < count; ++i) cdf[i + 1] = cdf[i] + func[i] / (float)count;
+	const float integral = cdf[count];
+	if (integral <= 0.0f) {
+		for (size_t i = 1; i <= count; ++i) cdf[i] = (float)i / (float)count;
+	} else {
+		for (size_t i = 1; i <= count; ++i) cdf[i] /= integral;
+	}
+	return integral;
+}
+
+// Continuous sample in [0, 1) from a cdf, and the bucket it landed in
+static float sample_cdf(const float *cdf, size_t count, float u, size_t *bucket) {
+	size_t lo = 0;
+	size_t hi = count - 1;
+	while (lo < hi) {
+		const size_t mid = (lo + hi) / 2;
+		if (cdf[mid + 1] <= u) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	*bucket = lo;
+	const float width = cdf[lo + 1] - cdf[lo];
+	const float offset = width > 0.0f ? (u - cdf[lo]) / width : 0.0f;
+	return min(((float)lo + offset) / (float)count, 0.99999994f);
+}
+
+static bool color_has_image(const struct cr_color_node *desc) {
+	if (!desc) return false;
+	switch (desc->type) {
+		case cr_cn_image:
+			return true;
+		case cr_cn_checkerboard:
+			return color_has_image(desc->arg.checkerboard.a) || color_has_image(desc->arg.checkerboard.b);
+		case cr_cn_hsv_tform:
+			return color_has_image(desc->arg.hsv_tform.tex);
+		case cr_cn_gradient:
+			return color_has_image(desc->arg.gradient.a) || color_has_image(desc->arg.gradient.b);
+		case cr_cn_color_mix:
+			return color_has_image(desc->arg.color_mix.a) || color_has_image(desc->arg.color_mix.b);
+		case cr_cn_cache:
+			return color_has_image(desc->arg.cache.color);
+		default:
+			return false;
+	}
+}
+
+bool env_map_wanted(const struct cr_shader_node *desc) {
+	if (!desc) return false;
+	switch (desc->type) {
+		case cr_bsdf_background:
+			return color_has_image(desc->arg.background.color);
+		case cr_bsdf_mix:
+			return env_map_wanted(desc->arg.mix.A) || env_map_wanted(desc->arg.mix.B);
+		case cr_bsdf_add:
+			return env_map_wanted(desc->arg.add.A) || env_map_wanted(desc->arg.add.B);
+		default:
+			return false;
+	}
+}
+
+void env_map_build(struct env_map *env, const struct bsdfNode *background) {
+	if (env->background == background && env->func) return;
+	env_map_free(env);
+	env->background = background;
+	if (!background) return;
+	struct timeval timer = { 0 };
+	timer_start(&timer);
+	env->width = ENV_MAP_WIDTH;
+	env->height = ENV_MAP_HEIGHT;
+	env->func = malloc(env->width * env->height * sizeof(*env->func));
+	env->conditional_cdf = malloc((env->width + 1) * env->height * sizeof(*env->conditional_cdf));
+	env->marginal_cdf = malloc((env->height + 1) * sizeof(*env->marginal_cdf));
+	float *row_integrals = malloc(env->height * sizeof(*row_integrals));
+
+	struct sampler sampler_state = { 0 };
+	sampler *sampler = &sampler_state;
+	initSampler(sampler, Random, 0, 1, 0);
+	for (size_t y = 0; y < env->height; ++y) {
+		const float v = ((float)y + 0.5f) / (float)env->height;
+		const float sin_theta = sinf(PI * v);
+		float *row = &env->func[y * env->width];
+		for (size_t x = 0; x < env->width; ++x) {
+			const float u = ((float)x + 0.5f) / (float)env->width;
+			struct lightRay ray = { .direction = direction(u, v) };
+			struct hitRecord miss;
+			background_record(background, sampler, &ray, &miss);
+			const struct color c = background->sample(background, sampler, &miss).weight;
+			row[x] = max(0.0f, 0.2126f * c.red + 0.7152f * c.green + 0.0722f * c.blue) * sin_theta;
+		}
+		row_integrals[y] = build_cdf(row, env->width, &env->conditional_cdf[y * (env->width + 1)]);
+	}
+	env->integral = build_cdf(row_integrals, env->height, env->marginal_cdf);
+	free(row_integrals);
+	logr(debug, "Built %zux%zu environment sampling tables in %lums\n", env->width, env->height, timer_get_ms(timer));
+}
+
+bool env_map_sample(const struct env_map *env, sampler *sampler, struct vector *dir, float *pdf) {
+	if (!env_map_active(env)) return false;
+	size_t x, y;
+	const float v = sample_cdf(env->marginal_cdf, env->height, getDimension(sampler), &y);
+	const float u = sample_cdf(&env->conditional_cdf[y * (env->width + 1)], env->width, getDimension(sampler), &x);
+	const float sin_theta = sinf(PI * v);
+	if (sin_theta <= 0.0f) return false;
+	const float pdf_uv = env->func[y * env->width + x] / env->integral;
+	if (pdf_uv <= 0.0f) return false;
+	*dir = direction(u, v);
+	*pdf = pdf_uv / (2.0f * PI * PI * sin_theta);
+	return true;
+}
+
+float env_map_pdf(const struct env_map *env, struct vector dir) {
+	if (!env_map_active(env)) return 0.0f;
+	dir = vec_normalize(dir);
+	const float cos_theta = clamp(dir.y, -1.0f, 1.0f);
+	const float sin_theta = sqrtf(max(0.0f, 1.0f - cos_theta * cos_theta));
+	if (sin_theta <= 0.0f) return 0.0f;
+	float phi = atan2f(dir.z, dir.x);
+	if (phi < 0.0f) phi += 2.0f * PI;
+	const size_t x = min((size_t)(phi / (2.0f * PI) * (float)env->width), env->width - 1);
+	const size_t y = min((size_t)(acosf(cos_theta) / PI * (float)env->height), env->height - 1);
+	return env->func[y * env->width + x] / env->integral / (2.0f * PI * PI * sin_theta);
+}
+
+void env_map_free(struct env_map *env) {
+	if (!env) return;
+	free(env->func);
+	free(env->conditional_cdf);
+	free(env->marginal_cdf);
+	*env = (struct env_map){ 0 };
+}
@@ -0,0 +1,46 @@
+//
+//  envmap.h
+//  c-ray
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../common/vector.h"
+#include "samplers/sampler.h"
+
+struct bsdfNode;
+struct cr_shader_node;
+
+// Piecewise-constant distribution over background directions, in a world space
+// latitude-longitude grid. Lets next event estimation aim for the bright parts
+// of an environment map, instead of waiting for escaping rays to find them.
+struct env_map {
+	const struct bsdfNode *background; // What the tables were built from
+	size_t width;
+	size_t height;
+	float *func; // Luminance * sin(theta), width * height
+	float *conditional_cdf; // One row of width + 1 per latitude
+	float *marginal_cdf; // height + 1
+	float integral; // Over the unit square
+};
+
+// Only image backgrounds vary enough to be worth the table and the extra shadow ray per bounce.
+// A constant or gradient sky is sampled just as well by the BSDF.
+bool env_map_wanted(const struct cr_shader_node *background_desc);
+
+// Tabulate background radiance. Does nothing if the tables already match background, NULL turns sampling off.
+void env_map_build(struct env_map *env, const struct bsdfNode *background);
+
+static inline bool env_map_active(const struct env_map *env) {
+	return env->integral > 0.0f;
+}
+
+// Pick a direction in proportion to background luminance, with its solid angle pdf
+bool env_map_sample(const struct env_map *env, sampler *sampler, struct vector *dir, float *pdf);
+
+// Solid angle pdf of env_map_sample() returning dir
+float env_map_pdf(const struct env_map *env, struct vector dir);
+
+void env_map_free(struct env_map *env);
@@ -0,0 +1,217 @@
+//
+//  guiding.c
+//  c-ray
+//
+
+#include "../../includes.h"
+#include "guiding.h"
+
+#include "../../common/logging.h"
+#include "../../common/platform/mutex.h"
+
+/*
+ * Lightweight path guiding. The scene bounds are split into a uniform grid, and each cell
+ * learns a histogram of incident radiance over the sphere of directions, in the spirit of
+ * "Practical Path Guiding for Efficient Light-Transport Simulation" by Müller et al., minus
+ * the adaptive subdivision. Render threads buffer their radiance estimates, and merge them
+ * in between tile passes. Every time the amount of merged samples doubles, the histograms
+ * are turned into a fresh set of sampling distributions. Threads hold on to the set they
+ * picked up until their next merge, so sampling never waits for training.
+ */
+
+// Cells along the longest axis of the scene bounds
+#define GUIDE_GRID_RES 16
+// Samples to see before the first fit, and how few a cell can be fitted from
+#define GUIDE_FIRST_FIT 4096
+#define GUIDE_MIN_CELL_SAMPLES 1024
+// Share of each distribution spread evenly, so directions the training missed can still be found
+#define GUIDE_UNIFORM_SHARE 0.1f
+
+struct guide_snapshot {
+	struct guide_cell *cells;
+	bool *valid;
+	size_t refs; // Recorders sampling from this set, protected by the guide mutex
+};
+
+struct path_guide {
+	struct boundingBox bounds;
+	unsigned res[3];
+	float inv_cell_size;
+	size_t cell_count;
+
+	struct cr_mutex *mutex; // Everything below
+	float *sums; // cell_count * GUIDE_BINS
+	size_t *counts; // Samples per cell
+	size_t seen;
+	size_t next_fit;
+	struct guide_snapshot *current;
+};
+
+struct path_guide *guide_new(struct boundingBox bounds) {
+	struct path_guide *guide = calloc(1, sizeof(*guide));
+	const struct vector extent = vec_sub(bounds.max, bounds.min);
+	const float longest = max(extent.x, max(extent.y, extent.z));
+	const float cell_size = longest > 0.0f ? longest / (float)GUIDE_GRID_RES : 1.0f;
+	guide->bounds = bounds;
+	guide->inv_cell_size = 1.0f / cell_size;
+	guide->cell_count = 1;
+	for (unsigned axis = 0; axis < 3; ++axis) {
+		const float cells = ceilf(vec_component(&extent, axis) / cell_size);
+		guide->res[axis] = (unsigned)clamp(cells, 1.0f, (float)GUIDE_GRID_RES);
+		guide->cell_count *= guide->res[axis];
+	}
+	guide->mutex = mutex_create();
+	guide->sums = calloc(guide->cell_count * GUIDE_BINS, sizeof(*guide->sums));
+	guide->counts = calloc(guide->cell_count, sizeof(*guide->counts));
+	guide->next_fit = GUIDE_FIRST_FIT;
+	logr(debug, "Path guiding grid is %ux%ux%u\n", guide->res[0], guide->res[1], guide->res[2]);
+	return guide;
+}
+
+static void snapshot_free(struct guide_snapshot *snapshot) {
+	if (!snapshot) return;
+	free(snapshot->cells);
+	free(snapshot->valid);
+	free(snapshot);
+}
+
+void guide_destroy(struct path_guide *guide) {
+	if (!guide) return;
+	snapshot_free(guide->current);
+	mutex_destroy(guide->mutex);
+	free(guide->sums);
+	free(guide->counts);
+	free(guide);
+}
+
+static inline uint32_t cell_index(const struct path_guide *guide, struct vector p) {
+	const struct vector local = vec_scale(vec_sub(p, guide->bounds.min), guide->inv_cell_size);
+	uint32_t idx = 0;
+	for (int axis = 2; axis >= 0; --axis) {
+		const float c = clamp(vec_component(&local, (unsigned)axis), 0.0f, (float)(guide->res[axis] - 1));
+		idx = idx * guide->res[axis] + (uint32_t)c;
+	}
+	return idx;
+}
+
+// Bins are equal area: rows are uniform in cos(theta), columns in phi. Y is up, like the environment map.
+static inline uint32_t direction_bin(struct vector dir) {
+	const float cos_theta = clamp(dir.y, -1.0f, 1.0f);
+	float phi = atan2f(dir.z, dir.x);
+	if (phi < 0.0f) phi += 2.0f * PI;
+	const unsigned row = (unsigned)min((1.0f - cos_theta) * 0.5f * GUIDE_THETA_BINS, GUIDE_THETA_BINS - 1);
+	const unsigned col = (unsigned)min(phi * (0.5f / PI) * GUIDE_PHI_BINS, GUIDE_PHI_BINS - 1);
+	return row * GUIDE_PHI_BINS + col;
+}
+
+static inline float bin_probability(const struct guide_cell *cell, uint32_t bin) {
+	return bin ? cell->cdf[bin] - cell->cdf[bin - 1] : cell->cdf[0];
+}
+
+// Called with the mutex held
+static struct guide_snapshot *fit(const struct path_guide *guide) {
+	struct guide_snapshot *snapshot = calloc(1, sizeof(*snapshot));
+	snapshot->cells = malloc(guide->cell_count * sizeof(*snapshot->cells));
+	snapshot->valid = calloc(guide->cell_count, sizeof(*snapshot->valid));
+	for (size_t c = 0; c < guide->cell_count; ++c) {
+		const float *sums = &guide->sums[c * GUIDE_BINS];
+		float total = 0.0f;
+		for (size_t b = 0; b < GUIDE_BINS; ++b) total += sums[b];
+		if (guide->counts[c] < GUIDE_MIN_CELL_SAMPLES || total <= 0.0f) continue;
+		float *cdf = snapshot->cells[c].cdf;
+		float running = 0.0f;
+		for (size_t b = 0; b < GUIDE_BINS; ++b) {
+			running += (1.0f - GUIDE_UNIFORM_SHARE) * sums[b] / total + GUIDE_UNIFORM_SHARE / (float)GUIDE_BINS;
+			cdf[b] = running;
+		}
+		for (size_t b = 0; b < GUIDE_BINS; ++b) cdf[b] /= running;
+		cdf[GUIDE_BINS - 1] = 1.0f;
+		snapshot->valid[c] = true;
+	}
+	return snapshot;
+}
+
+static void release(struct path_guide *guide, struct guide_snapshot *snapshot) {
+	if (!snapshot) return;
+	snapshot->refs--;
+	if (!snapshot->refs && snapshot != guide->current) snapshot_free(snapshot);
+}
+
+void guide_recorder_init(struct guide_recorder *rec, struct path_guide *guide) {
+	*rec = (struct guide_recorder){ .guide = guide };
+}
+
+void guide_recorder_commit(struct guide_recorder *rec) {
+	struct path_guide *guide = rec->guide;
+	if (!guide) return;
+	mutex_lock(guide->mutex);
+	for (size_t i = 0; i < rec->samples.count; ++i) {
+		const struct guide_sample s = rec->samples.items[i];
+		guide->sums[s.cell * GUIDE_BINS + s.bin] += s.value;
+		guide->counts[s.cell]++;
+	}
+	guide->seen += rec->samples.count;
+	rec->samples.count = 0;
+	if (guide->seen >= guide->next_fit) {
+		struct guide_snapshot *old = guide->current;
+		guide->current = fit(guide);
+		if (old && !old->refs) snapshot_free(old);
+		guide->next_fit *= 2;
+	}
+	if (rec->snapshot != guide->current) {
+		release(guide, rec->snapshot);
+		rec->snapshot = guide->current;
+		if (rec->snapshot) rec->snapshot->refs++;
+	}
+	mutex_release(guide->mutex);
+}
+
+void guide_recorder_free(struct guide_recorder *rec) {
+	if (rec->guide) {
+		mutex_lock(rec->guide->mutex);
+		release(rec->guide, rec->snapshot);
+		mutex_release(rec->guide->mutex);
+	}
+	guide_sample_arr_free(&rec->samples);
+	*rec = (struct guide_recorder){ 0 };
+}
+
+const struct guide_cell *guide_lookup(const struct guide_recorder *rec, struct vector p) {
+	if (!rec->snapshot) return NULL;
+	const uint32_t idx = cell_index(rec->guide, p);
+	return rec->snapshot->valid[idx] ? &rec->snapshot->cells[idx] : NULL;
+}
+
+struct vector guide_sample_dir(const struct guide_cell *cell, float u0, float u1, float u2, float *pdf) {
+	size_t lo = 0;
+	size_t hi = GUIDE_BINS - 1;
+	while (lo < hi) {
+		const size_t mid = (lo + hi) / 2;
+		if (cell->cdf[mid] <= u0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	const uint32_t bin = (uint32_t)lo;
+	const float row = (float)(bin / GUIDE_PHI_BINS) + u1;
+	const float col = (float)(bin % GUIDE_PHI_BINS) + u2;
+	const float cos_theta = 1.0f - 2.0f * row / (float)GUIDE_THETA_BINS;
+	const float sin_theta = sqrtf(max(0.0f, 1.0f - cos_theta * cos_theta));
+	const float phi = 2.0f * PI * col / (float)GUIDE_PHI_BINS;
+	*pdf = bin_probability(cell, bin) * (float)GUIDE_BINS / (4.0f * PI);
+	return (struct vector){ sin_theta * cosf(phi), cos_theta, sin_theta * sinf(phi) };
+}
+
+float guide_pdf(const struct guide_cell *cell, struct vector dir) {
+	return bin_probability(cell, direction_bin(dir)) * (float)GUIDE_BINS / (4.0f * PI);
+}
+
+void guide_record(struct guide_recorder *rec, struct vector p, struct vector dir, float radiance, float pdf) {
+	if (!(radiance >= 0.0f && radiance < FLT_MAX) || !(pdf > 0.0f)) return;
+	guide_sample_arr_add(&rec->samples, (struct guide_sample){
+		.cell = cell_index(rec->guide, p),
+		.bin = direction_bin(dir),
+		.value = radiance / pdf
+	});
+}
@@ -0,0 +1,68 @@
+//
+//  guiding.h
+//  c-ray
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../common/vector.h"
+#include "../../common/dyn_array.h"
+#include "../datatypes/bbox.h"
+
+// Directional bins per grid cell, GUIDE_THETA_BINS rows of equal height in cos(theta), each split into GUIDE_PHI_BINS
+#define GUIDE_THETA_BINS 16
+#define GUIDE_PHI_BINS 16
+#define GUIDE_BINS (GUIDE_THETA_BINS * GUIDE_PHI_BINS)
+
+// Incident radiance learned for one grid cell, as a cdf over the directional bins. All bins have the same solid angle.
+struct guide_cell {
+	float cdf[GUIDE_BINS];
+};
+
+// One radiance estimate, gathered by a render thread
+struct guide_sample {
+	uint32_t cell;
+	uint32_t bin;
+	float value; // Incident luminance over the pdf of the direction it came from
+};
+
+typedef struct guide_sample guide_sample;
+dyn_array_def(guide_sample)
+
+struct path_guide;
+struct guide_snapshot;
+
+// Per render thread view of a path_guide. Samples are buffered here, and only
+// merged into the shared structure when the thread calls guide_recorder_commit().
+struct guide_recorder {
+	struct path_guide *guide;
+	struct guide_snapshot *snapshot; // What this thread samples from, doesn't change until the next commit
+	struct guide_sample_arr samples;
+};
+
+// Spatial grid over bounds, with a directional histogram in each cell
+struct path_guide *guide_new(struct boundingBox bounds);
+
+void guide_destroy(struct path_guide *guide);
+
+void guide_recorder_init(struct guide_recorder *rec, struct path_guide *guide);
+
+// Hand buffered samples over to the shared guide, and pick up its latest distributions.
+// The guide is refit every time the amount of samples it has seen doubles.
+void guide_recorder_commit(struct guide_recorder *rec);
+
+void guide_recorder_free(struct guide_recorder *rec);
+
+// Distribution for point p, or NULL if nothing has been learned there yet
+const struct guide_cell *guide_lookup(const struct guide_recorder *rec, struct vector p);
+
+// Direction from cell, with its solid angle pdf
+struct vector guide_sample_dir(const struct guide_cell *cell, float u0, float u1, float u2, float *pdf);
+
+// Solid angle pdf of guide_sample_dir() returning dir
+float guide_pdf(const struct guide_cell *cell, struct vector dir);
+
+// Queue up an estimate of the luminance arriving at p from dir, sampled with the given pdf
+void guide_record(struct guide_recorder *rec, struct vector p, struct vector dir, float radiance, float pdf);
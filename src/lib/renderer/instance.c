@@ -26,8 +26,7 @@ struct meshVolume {
 	float density;
 };
 
-static inline struct coord getTexMapSphere(const struct hitRecord *isect) {
-	struct vector ud = isect->surfaceNormal;
+struct coord getTexMapSphere(struct vector ud) {
 	//To polar from cartesian
 	float phi = atan2f(ud.z, ud.x);
 	float theta = asinf(ud.y);
@@ -38,26 +37,60 @@ static inline struct coord getTexMapSphere(const struct hitRecord *isect) {
 	return (struct coord){ u, v };
 }
 
-static bool intersectSphere(const struct instance *instance, const struct lightRay *ray, struct hitRecord *isect, sampler *sampler) {
-	(void)sampler;
-	struct lightRay copy = *ray;
+// Object space ray that intersectFn tested against. Differentials are left out, traversal doesn't need them.
+static inline struct lightRay object_ray(const struct instance *instance, const struct lightRay *ray, float offset) {
+	struct lightRay copy = { .start = ray->start, .direction = ray->direction, .type = ray->type };
 	tform_ray(&copy, instance->composite.Ainv);
+	copy.start = vec_add(copy.start, vec_scale(copy.direction, offset));
+	return copy;
+}
+
+static bool intersectSphere(const struct instance *instance, const struct lightRay *ray, struct hit *isect, sampler *sampler) {
+	(void)sampler;
 	struct sphere *sphere = &((struct sphere_arr *)instance->object_arr)->items[instance->object_idx];
-	copy.start = vec_add(copy.start, vec_scale(copy.direction, sphere->rayOffset));
-	if (rayIntersectsWithSphere(&copy, sphere, isect)) {
-		isect->uv = getTexMapSphere(isect);
+	const struct lightRay copy = object_ray(instance, ray, sphere->rayOffset);
+	const struct bsdf_buffer *bbuf = instance->bbuf;
+	if (!bbuf->has_masks || !bbuf->masks.items[0]) return rayIntersectsWithSphere(&copy, sphere, isect);
+	// Cut-out, if the near side isn't there the far side might be
+	float t[2];
+	const int count = sphere_intersections(&copy, sphere, isect->distance, t);
+	for (int i = 0; i < count; ++i) {
+		const struct coord uv = getTexMapSphere(vec_normalize(alongRay(&copy, t[i])));
+		if (!alpha_mask_test(bbuf->masks.items[0], uv, &copy, (uint32_t)i)) continue;
+		isect->distance = t[i];
 		isect->polygon = NULL;
-		isect->bsdf = instance->bbuf->bsdfs.items[0];
-		tform_point(&isect->hitPoint, instance->composite.A);
-		tform_vector_transpose(&isect->surfaceNormal, instance->composite.Ainv);
 		return true;
 	}
 	return false;
 }
 
-static bool intersectSphereVolume(const struct instance *instance, const struct lightRay *ray, struct hitRecord *isect, sampler *sampler) {
+static void shadeSphere(const struct instance *instance, const struct lightRay *ray, const struct hit *isect, struct hitRecord *record) {
+	struct sphere *sphere = &((struct sphere_arr *)instance->object_arr)->items[instance->object_idx];
+	const struct lightRay copy = object_ray(instance, ray, sphere->rayOffset);
+	const struct vector p = alongRay(&copy, isect->distance);
+	const struct vector n = vec_normalize(p);
+	record->uv = getTexMapSphere(n);
+	record->has_uv = true;
+
+	// Derivatives of the mapping in getTexMapSphere(), u runs against phi
+	const float r_xz = sqrtf(p.x * p.x + p.z * p.z);
+	record->dpdu = (struct vector){ 2.0f * PI * p.z, 0.0f, -2.0f * PI * p.x };
+	record->dpdv = r_xz > 0.0f ? (struct vector){ -PI * p.y * p.x / r_xz, PI * r_xz, -PI * p.y * p.z / r_xz } : vec_zero();
+
+	record->hitPoint = p;
+	record->surfaceNormal = n;
+	record->bsdf = instance->bbuf->bsdfs.items[0];
+	tform_point(&record->hitPoint, instance->composite.A);
+	tform_vector_transpose(&record->surfaceNormal, instance->composite.Ainv);
+	tform_vector(&record->dpdu, instance->composite.A);
+	tform_vector(&record->dpdv, instance->composite.A);
+	record->geometricNormal = record->surfaceNormal;
+	hitrecord_tangent_frame(record);
+}
+
+static bool intersectSphereVolume(const struct instance *instance, const struct lightRay *ray, struct hit *isect, sampler *sampler) {
 	return false;
-	struct hitRecord record1, record2;
+	struct hit record1, record2;
 	record1 = *isect;
 	record2 = *isect;
 	struct lightRay copy1, copy2;
@@ -75,13 +108,7 @@ static bool intersectSphereVolume(const struct instance *instance, const struct
 			float hitDistance = -(1.0f / volume->density) * logf(getDimension(sampler));
 			if (hitDistance < distanceInsideVolume) {
 				isect->distance = record1.distance + hitDistance;
-				isect->hitPoint = alongRay(ray, isect->distance);
-				isect->uv = (struct coord){-1.0f, -1.0f};
 				isect->polygon = NULL;
-				isect->bsdf = instance->bbuf->bsdfs.items[0];
-				tform_point(&isect->hitPoint, instance->composite.A);
-				isect->surfaceNormal = (struct vector){1.0f, 0.0f, 0.0f}; // Will be ignored by material anyway
-				tform_vector_transpose(&isect->surfaceNormal, instance->composite.Ainv); // Probably not needed
 				return true;
 			}
 		}
@@ -89,6 +116,20 @@ static bool intersectSphereVolume(const struct instance *instance, const struct
 	return false;
 }
 
+static void shadeVolume(const struct instance *instance, const struct lightRay *ray, const struct hit *isect, struct hitRecord *record) {
+	record->hitPoint = alongRay(ray, isect->distance);
+	record->uv = (struct coord){-1.0f, -1.0f};
+	record->has_uv = false;
+	record->bsdf = instance->bbuf->bsdfs.items[0];
+	tform_point(&record->hitPoint, instance->composite.A);
+	record->surfaceNormal = (struct vector){1.0f, 0.0f, 0.0f}; // Will be ignored by material anyway
+	tform_vector_transpose(&record->surfaceNormal, instance->composite.Ainv); // Probably not needed
+	record->geometricNormal = record->surfaceNormal;
+	record->dpdu = vec_zero();
+	record->dpdv = vec_zero();
+	hitrecord_tangent_frame(record);
+}
+
 static void getSphereBBoxAndCenter(const struct instance *instance, struct boundingBox *bbox, struct vector *center) {
 	struct sphere *sphere = &((struct sphere_arr *)instance->object_arr)->items[instance->object_idx];
 	bbox->min = (struct vector){ -sphere->radius, -sphere->radius, -sphere->radius };
@@ -120,6 +161,7 @@ struct instance new_sphere_instance(struct sphere_arr *spheres, size_t idx, floa
 			.object_idx = 0,
 			.composite = tform_new(),
 			.intersectFn = intersectSphereVolume,
+			.getShadingFn = shadeVolume,
 			.getBBoxAndCenterFn = getSphereVolumeBBoxAndCenter
 		};
 	} else {
@@ -128,19 +170,22 @@ struct instance new_sphere_instance(struct sphere_arr *spheres, size_t idx, floa
 			.object_idx = idx,
 			.composite = tform_new(),
 			.intersectFn = intersectSphere,
+			.getShadingFn = shadeSphere,
 			.getBBoxAndCenterFn = getSphereBBoxAndCenter
 		};
 	}
 }
 
-static struct coord getTexMapMesh(const struct mesh *mesh, const struct hitRecord *isect) {
-	if (mesh->vbuf->texture_coords.count == 0) return (struct coord){-1.0f, -1.0f};
-	struct poly *p = isect->polygon;
-	if (p->textureIndex[0] == -1) return (struct coord){-1.0f, -1.0f};
+bool hasTexMapMesh(const struct mesh *mesh, const struct poly *p) {
+	return mesh->vbuf->texture_coords.count && p->textureIndex[0] != -1;
+}
+
+struct coord getTexMapMesh(const struct mesh *mesh, const struct poly *p, struct coord bary) {
+	if (!hasTexMapMesh(mesh, p)) return (struct coord){-1.0f, -1.0f};
 	
 	//barycentric coordinates for this polygon
-	const float u = isect->uv.x;
-	const float v = isect->uv.y;
+	const float u = bary.x;
+	const float v = bary.y;
 	const float w = 1.0f - u - v;
 	
 	//Weighted texture coordinates
@@ -152,26 +197,81 @@ static struct coord getTexMapMesh(const struct mesh *mesh, const struct hitRecor
 	return coord_add(coord_add(ucomponent, vcomponent), wcomponent);
 }
 
-static bool intersectMesh(const struct instance *instance, const struct lightRay *ray, struct hitRecord *isect, sampler *sampler) {
-	struct lightRay copy = *ray;
-	tform_ray(&copy, instance->composite.Ainv);
+// dP/du and dP/dv of a polygon. Without usable texture coordinates, the barycentrics stand in for them.
+static void polygon_derivatives(const struct mesh *mesh, const struct poly *p, struct vector *dpdu, struct vector *dpdv) {
+	const struct vector p0 = mesh->vbuf->vertices.items[p->vertexIndex[0]];
+	const struct vector p1 = mesh->vbuf->vertices.items[p->vertexIndex[1]];
+	const struct vector p2 = mesh->vbuf->vertices.items[p->vertexIndex[2]];
+	if (mesh->vbuf->texture_coords.count && p->textureIndex[0] != -1) {
+		// PBRT
+		const struct coord uv0 = mesh->vbuf->texture_coords.items[p->textureIndex[0]];
+		const struct coord uv1 = mesh->vbuf->texture_coords.items[p->textureIndex[1]];
+		const struct coord uv2 = mesh->vbuf->texture_coords.items[p->textureIndex[2]];
+		const struct coord duv02 = { uv0.x - uv2.x, uv0.y - uv2.y };
+		const struct coord duv12 = { uv1.x - uv2.x, uv1.y - uv2.y };
+		const struct vector dp02 = vec_sub(p0, p2);
+		const struct vector dp12 = vec_sub(p1, p2);
+		const float det = duv02.x * duv12.y - duv02.y * duv12.x;
+		if (fabsf(det) > 1e-9f) {
+			const float inv_det = 1.0f / det;
+			*dpdu = vec_scale(vec_sub(vec_scale(dp02, duv12.y), vec_scale(dp12, duv02.y)), inv_det);
+			*dpdv = vec_scale(vec_sub(vec_scale(dp12, duv02.x), vec_scale(dp02, duv12.x)), inv_det);
+			return;
+		}
+	}
+	*dpdu = vec_sub(p1, p0);
+	*dpdv = vec_sub(p2, p0);
+}
+
+static bool intersectMesh(const struct instance *instance, const struct lightRay *ray, struct hit *isect, sampler *sampler) {
 	struct mesh *mesh = &((struct mesh_arr *)instance->object_arr)->items[instance->object_idx];
-	copy.start = vec_add(copy.start, vec_scale(copy.direction, mesh->rayOffset));
-	if (traverse_bottom_level_bvh(mesh, &copy, isect, sampler)) {
-		// Repopulate uv with actual texture mapping
-		isect->uv = getTexMapMesh(mesh, isect);
-		isect->bsdf = instance->bbuf->bsdfs.items[isect->polygon->materialIndex];
-		tform_point(&isect->hitPoint, instance->composite.A);
-		tform_vector_transpose(&isect->surfaceNormal, instance->composite.Ainv);
-		isect->surfaceNormal = vec_normalize(isect->surfaceNormal);
-		return true;
+	const struct lightRay copy = object_ray(instance, ray, mesh->rayOffset);
+	const struct bsdf_buffer *bbuf = instance->bbuf;
+	return traverse_bottom_level_bvh(mesh, &copy, isect, bbuf->has_masks ? bbuf->masks.items : NULL, sampler);
+}
+
+static void shadeMesh(const struct instance *instance, const struct lightRay *ray, const struct hit *isect, struct hitRecord *record) {
+	struct mesh *mesh = &((struct mesh_arr *)instance->object_arr)->items[instance->object_idx];
+	const struct lightRay copy = object_ray(instance, ray, mesh->rayOffset);
+	const struct poly *p = isect->polygon;
+	const float u = isect->bary.x;
+	const float v = isect->bary.y;
+	const float w = 1.0f - u - v;
+
+	struct vector e1 = vec_sub(mesh->vbuf->vertices.items[p->vertexIndex[0]], mesh->vbuf->vertices.items[p->vertexIndex[1]]);
+	struct vector e2 = vec_sub(mesh->vbuf->vertices.items[p->vertexIndex[2]], mesh->vbuf->vertices.items[p->vertexIndex[0]]);
+	struct vector n = vec_cross(e1, e2);
+	if (likely(p->hasNormals)) {
+		struct vector upcomp = vec_scale(mesh->vbuf->normals.items[p->normalIndex[1]], u);
+		struct vector vpcomp = vec_scale(mesh->vbuf->normals.items[p->normalIndex[2]], v);
+		struct vector wpcomp = vec_scale(mesh->vbuf->normals.items[p->normalIndex[0]], w);
+		record->surfaceNormal = vec_add(vec_add(upcomp, vpcomp), wpcomp);
+	} else {
+		record->surfaceNormal = n;
 	}
-	return false;
+	// Support two-sided materials by flipping the normals if needed
+	if (vec_dot(copy.direction, record->surfaceNormal) >= 0.0f) record->surfaceNormal = vec_negate(record->surfaceNormal);
+	if (vec_dot(copy.direction, n) >= 0.0f) n = vec_negate(n);
+	record->geometricNormal = n;
+	record->hitPoint = alongRay(&copy, isect->distance);
+	record->uv = getTexMapMesh(mesh, p, isect->bary);
+	record->has_uv = hasTexMapMesh(mesh, p);
+	polygon_derivatives(mesh, p, &record->dpdu, &record->dpdv);
+	record->bsdf = instance->bbuf->bsdfs.items[p->materialIndex];
+
+	tform_point(&record->hitPoint, instance->composite.A);
+	tform_vector_transpose(&record->surfaceNormal, instance->composite.Ainv);
+	record->surfaceNormal = vec_normalize(record->surfaceNormal);
+	tform_vector_transpose(&record->geometricNormal, instance->composite.Ainv);
+	record->geometricNormal = vec_normalize(record->geometricNormal);
+	tform_vector(&record->dpdu, instance->composite.A);
+	tform_vector(&record->dpdv, instance->composite.A);
+	hitrecord_tangent_frame(record);
 }
 
-static bool intersectMeshVolume(const struct instance *instance, const struct lightRay *ray, struct hitRecord *isect, sampler *sampler) {
+static bool intersectMeshVolume(const struct instance *instance, const struct lightRay *ray, struct hit *isect, sampler *sampler) {
 	return false;
-	struct hitRecord record1, record2;
+	struct hit record1, record2;
 	record1 = *isect;
 	record2 = *isect;
 	struct lightRay copy = *ray;
@@ -179,21 +279,16 @@ static bool intersectMeshVolume(const struct instance *instance, const struct li
 	//FIXME
 	struct meshVolume *mesh = NULL;//(struct meshVolume *)instance->object;
 	copy.start = vec_add(copy.start, vec_scale(copy.direction, mesh->mesh->rayOffset));
-	if (traverse_bottom_level_bvh(mesh->mesh, &copy, &record1, sampler)) {
+	if (traverse_bottom_level_bvh(mesh->mesh, &copy, &record1, NULL, sampler)) {
 		struct lightRay copy2 = (struct lightRay){ alongRay(&copy, record1.distance + 0.0001f), copy.direction };
-		if (traverse_bottom_level_bvh(mesh->mesh, &copy2, &record2, sampler)) {
+		if (traverse_bottom_level_bvh(mesh->mesh, &copy2, &record2, NULL, sampler)) {
 			if (record1.distance < 0.0f)
 				record1.distance = 0.0f;
 			float distanceInsideVolume = record2.distance;
 			float hitDistance = -(1.0f / mesh->density) * logf(getDimension(sampler));
 			if (hitDistance < distanceInsideVolume) {
 				isect->distance = record1.distance + hitDistance;
-				isect->hitPoint = alongRay(ray, isect->distance);
-				isect->uv = (struct coord){-1.0f, -1.0f};
-				isect->bsdf = instance->bbuf->bsdfs.items[0];
-				tform_point(&isect->hitPoint, instance->composite.A);
-				isect->surfaceNormal = (struct vector){1.0f, 0.0f, 0.0f}; // Will be ignored by material anyway
-				tform_vector_transpose(&isect->surfaceNormal, instance->composite.Ainv); // Probably not needed
+				isect->polygon = NULL;
 				return true;
 			}
 		}
@@ -234,6 +329,7 @@ struct instance new_mesh_instance(struct mesh_arr *meshes, size_t idx, float *de
 			.object_idx = 0,
 			.composite = tform_new(),
 			.intersectFn = intersectMeshVolume,
+			.getShadingFn = shadeVolume,
 			.getBBoxAndCenterFn = getMeshVolumeBBoxAndCenter
 		};
 	} else {
@@ -242,6 +338,7 @@ struct instance new_mesh_instance(struct mesh_arr *meshes, size_t idx, float *de
 			.object_idx = idx,
 			.composite = tform_new(),
 			.intersectFn = intersectMesh,
+			.getShadingFn = shadeMesh,
 			.getBBoxAndCenterFn = getMeshBBoxAndCenter
 		};
 	}
@@ -19,6 +19,7 @@
 #include "../datatypes/sphere.h"
 
 struct lightRay;
+struct hit;
 struct hitRecord;
 
 struct instance {
@@ -26,7 +27,10 @@ struct instance {
 	struct bsdf_buffer *bbuf;
 	size_t bbuf_idx;
 	bool emits_light;
-	bool (*intersectFn)(const struct instance *, const struct lightRay *, struct hitRecord *, sampler *);
+	// Called for every candidate during traversal, so only fills in struct hit
+	bool (*intersectFn)(const struct instance *, const struct lightRay *, struct hit *, sampler *);
+	// Builds the shading context once intersectFn has found the closest hit
+	void (*getShadingFn)(const struct instance *, const struct lightRay *, const struct hit *, struct hitRecord *);
 	void (*getBBoxAndCenterFn)(const struct instance *, struct boundingBox *, struct vector *);
 	void *object_arr;
 	size_t object_idx;
@@ -39,3 +43,9 @@ struct instance new_sphere_instance(struct sphere_arr *spheres, size_t idx, floa
 struct instance new_mesh_instance(struct mesh_arr *meshes, size_t idx, float *density, struct block **pool);
 
 bool isMesh(const struct instance *instance);
+
+// Texture coordinates for a hit, from the object space normal for spheres,
+// and from the barycentric coordinates on polygon p for meshes.
+struct coord getTexMapSphere(struct vector ud);
+struct coord getTexMapMesh(const struct mesh *mesh, const struct poly *p, struct coord bary);
+bool hasTexMapMesh(const struct mesh *mesh, const struct poly *p);
@@ -0,0 +1,309 @@
+//
+//  lights.c
+//  c-ray
+//
+
+#include "../../includes.h"
+#include "lights.h"
+
+#include "../datatypes/scene.h"
+#include "../datatypes/mesh.h"
+#include "../datatypes/poly.h"
+#include "../datatypes/sphere.h"
+#include "../../common/logging.h"
+#include "../../common/transforms.h"
+#include "instance.h"
+#include "../accelerators/light_bvh.h"
+
+// Emission only shows up in sample() results, so look at the description
+// to find out if a material could ever emit anything.
+static bool shader_emits(const struct cr_shader_node *desc) {
+	if (!desc) return false;
+	switch (desc->type) {
+		case cr_bsdf_emissive:
+			return true;
+		case cr_bsdf_mix: {
+			// build_bsdf_node() drops the side a constant factor never picks
+			const struct cr_value_node *f = desc->arg.mix.factor;
+			if (f && f->type == cr_vn_constant && f->arg.constant <= 0.0) return shader_emits(desc->arg.mix.A);
+			if (f && f->type == cr_vn_constant && f->arg.constant >= 1.0) return shader_emits(desc->arg.mix.B);
+			return shader_emits(desc->arg.mix.A) || shader_emits(desc->arg.mix.B);
+		}
+		case cr_bsdf_add:
+			return shader_emits(desc->arg.add.A) || shader_emits(desc->arg.add.B);
+		default:
+			return false;
+	}
+}
+
+static bool material_emits(const struct bsdf_buffer *buf, size_t idx) {
+	if (idx >= buf->descriptions.count) return false;
+	return shader_emits(buf->descriptions.items[idx]);
+}
+
+static const struct valueNode *material_mask(const struct bsdf_buffer *buf, size_t idx) {
+	if (!buf->has_masks || idx >= buf->masks.count) return NULL;
+	return buf->masks.items[idx];
+}
+
+// Cut-out masks only look at uv, see bsdf_buffer_add()
+static float light_opacity(const struct light *l, sampler *sampler, const struct hitRecord *rec) {
+	if (!l->mask) return 1.0f;
+	return clamp(l->mask->eval(l->mask, sampler, rec), 0.0f, 1.0f);
+}
+
+static void add_mesh_lights(struct light_list *list, struct instance *instance, size_t instance_idx) {
+	const struct mesh *mesh = &((struct mesh_arr *)instance->object_arr)->items[instance->object_idx];
+	for (size_t i = 0; i < mesh->polygons.count; ++i) {
+		struct poly *p = &mesh->polygons.items[i];
+		if (!material_emits(instance->bbuf, p->materialIndex)) continue;
+		struct light l = {
+			.instance = instance_idx,
+			.polygon = p,
+			.v0 = mesh->vbuf->vertices.items[p->vertexIndex[0]],
+			.v1 = mesh->vbuf->vertices.items[p->vertexIndex[1]],
+			.v2 = mesh->vbuf->vertices.items[p->vertexIndex[2]],
+			.mask = material_mask(instance->bbuf, p->materialIndex)
+		};
+		tform_point(&l.v0, instance->composite.A);
+		tform_point(&l.v1, instance->composite.A);
+		tform_point(&l.v2, instance->composite.A);
+		l.area = 0.5f * vec_length(vec_cross(vec_sub(l.v1, l.v0), vec_sub(l.v2, l.v0)));
+		if (l.area <= 0.0f) continue;
+		light_arr_add(&list->lights, l);
+		instance->emits_light = true;
+	}
+}
+
+static void add_sphere_light(struct light_list *list, struct instance *instance, size_t instance_idx) {
+	if (!material_emits(instance->bbuf, 0)) return;
+	const struct sphere *sphere = &((struct sphere_arr *)instance->object_arr)->items[instance->object_idx];
+	struct light l = { .instance = instance_idx, .center = vec_zero(), .mask = material_mask(instance->bbuf, 0) };
+	tform_point(&l.center, instance->composite.A);
+	// Assumes uniform scale, like the rest of the sphere code
+	struct vector edge = { sphere->radius, 0.0f, 0.0f };
+	tform_vector(&edge, instance->composite.A);
+	l.radius = vec_length(edge);
+	l.area = 4.0f * PI * l.radius * l.radius;
+	if (l.area <= 0.0f) return;
+	light_arr_add(&list->lights, l);
+	instance->emits_light = true;
+}
+
+// Point on sphere light l in direction dir from its center, ready to be shaded
+static void sphere_point(const struct light *l, const struct instance *instance, struct vector dir, struct hitRecord *rec) {
+	*rec = (struct hitRecord){ .instIndex = (int)l->instance };
+	rec->hitPoint = vec_add(l->center, vec_scale(dir, l->radius));
+	// Texture mapping wants the object space normal
+	struct vector object_normal = dir;
+	tform_vector(&object_normal, instance->composite.Ainv);
+	rec->uv = getTexMapSphere(vec_normalize(object_normal));
+	rec->has_uv = true;
+	rec->surfaceNormal = dir;
+	rec->geometricNormal = dir;
+	rec->bsdf = instance->bbuf->bsdfs.items[0];
+	hitrecord_tangent_frame(rec);
+}
+
+// Point (u1, u2) on light l, uniform over its area, ready to be shaded
+static void light_point(const struct light *l, const struct instance *instance, float u1, float u2, struct hitRecord *rec) {
+	*rec = (struct hitRecord){ .instIndex = (int)l->instance, .polygon = l->polygon };
+	if (l->polygon) {
+		// Uniform point on the triangle. uv are barycentrics like in rayIntersectsWithPolygon()
+		const float su = sqrtf(u1);
+		const float b1 = su * (1.0f - u2);
+		const float b2 = su * u2;
+		rec->hitPoint = vec_add(l->v0, vec_add(vec_scale(vec_sub(l->v1, l->v0), b1), vec_scale(vec_sub(l->v2, l->v0), b2)));
+		rec->surfaceNormal = vec_normalize(vec_cross(vec_sub(l->v1, l->v0), vec_sub(l->v2, l->v0)));
+		const struct mesh *mesh = &((struct mesh_arr *)instance->object_arr)->items[instance->object_idx];
+		rec->uv = getTexMapMesh(mesh, l->polygon, (struct coord){ b1, b2 });
+		rec->has_uv = hasTexMapMesh(mesh, l->polygon);
+		rec->dpdu = vec_sub(l->v1, l->v0);
+		rec->dpdv = vec_sub(l->v2, l->v0);
+		rec->bsdf = instance->bbuf->bsdfs.items[l->polygon->materialIndex];
+		rec->geometricNormal = rec->surfaceNormal;
+		hitrecord_tangent_frame(rec);
+	} else {
+		const float z = 1.0f - 2.0f * u1;
+		const float r = sqrtf(max(0.0f, 1.0f - z * z));
+		const float phi = 2.0f * PI * u2;
+		sphere_point(l, instance, (struct vector){ r * cosf(phi), r * sinf(phi), z }, rec);
+	}
+}
+
+// Cone of directions sphere light l covers as seen from origin. Returns false if origin is inside it.
+// one_minus_cos_max is kept separately, since for small or distant spheres 1 - cos_max would cancel out.
+static bool sphere_cone(const struct light *l, struct vector origin, float *cos_max, float *one_minus_cos_max) {
+	const float dist_sq = vec_length_squared(vec_sub(l->center, origin));
+	const float radius_sq = l->radius * l->radius;
+	if (dist_sq <= radius_sq * 1.0001f) return false;
+	const float sin2_max = radius_sq / dist_sq;
+	*cos_max = sqrtf(max(0.0f, 1.0f - sin2_max));
+	*one_minus_cos_max = sin2_max < 0.00068523f ? 0.5f * sin2_max : 1.0f - *cos_max;
+	return true;
+}
+
+// Solid angle pdf of a direction inside the cone
+static inline float sphere_cone_pdf(float one_minus_cos_max) {
+	return 1.0f / (2.0f * PI * one_minus_cos_max);
+}
+
+// Area pdf of point p with normal n on a light, given the solid angle pdf of the direction to it from origin
+static inline float solid_angle_to_area(float pdf, struct vector origin, struct vector p, struct vector n) {
+	const struct vector to_light = vec_sub(p, origin);
+	const float dist_sq = vec_length_squared(to_light);
+	if (dist_sq <= 0.0f) return 0.0f;
+	return pdf * fabsf(vec_dot(n, to_light)) / (sqrtf(dist_sq) * dist_sq);
+}
+
+// Pick a point on the side of sphere light l facing origin, uniformly by solid angle. The back
+// half can never be seen from origin, so sampling all of it would waste half the shadow rays.
+static bool sphere_sample_cone(const struct light *l, const struct instance *instance, struct vector origin, float u1, float u2, struct hitRecord *rec, float *pdf_area) {
+	float cos_max, one_minus_cos_max;
+	if (!sphere_cone(l, origin, &cos_max, &one_minus_cos_max)) return false;
+	const float dist = vec_length(vec_sub(l->center, origin));
+	const struct vector wc = vec_scale(vec_sub(l->center, origin), 1.0f / dist);
+	const struct base frame = baseWithVec(wc);
+
+	// Direction from origin within the cone, then the point on the sphere it hits first
+	const float cos_theta = 1.0f - u1 * one_minus_cos_max;
+	const float sin2_theta = max(0.0f, 1.0f - cos_theta * cos_theta);
+	const float radius_sq = l->radius * l->radius;
+	const float ds = dist * cos_theta - sqrtf(max(0.0f, radius_sq - dist * dist * sin2_theta));
+	const float cos_alpha = clamp((dist * dist + radius_sq - ds * ds) / (2.0f * dist * l->radius), -1.0f, 1.0f);
+	const float sin_alpha = sqrtf(max(0.0f, 1.0f - cos_alpha * cos_alpha));
+	const float phi = 2.0f * PI * u2;
+	// Angle alpha is measured at the center, from the direction back towards origin
+	const struct vector dir = vec_add(vec_add(vec_scale(frame.j, sin_alpha * cosf(phi)), vec_scale(frame.k, sin_alpha * sinf(phi))), vec_scale(wc, -cos_alpha));
+	sphere_point(l, instance, vec_normalize(dir), rec);
+	*pdf_area = solid_angle_to_area(sphere_cone_pdf(one_minus_cos_max), origin, rec->hitPoint, rec->geometricNormal);
+	return *pdf_area > 0.0f;
+}
+
+#define POWER_ESTIMATE_SAMPLES 16
+
+// Rough emitted power of a light, averaged over a few points since emission may be textured
+static float light_power(const struct light *l, const struct instance *instance, sampler *sampler, size_t idx) {
+	float sum = 0.0f;
+	for (size_t i = 0; i < POWER_ESTIMATE_SAMPLES; ++i) {
+		initSampler(sampler, Halton, (int)i, POWER_ESTIMATE_SAMPLES, (uint32_t)idx);
+		struct hitRecord rec;
+		light_point(l, instance, getDimension(sampler), getDimension(sampler), &rec);
+		struct lightRay incident = { .start = vec_add(rec.hitPoint, rec.surfaceNormal), .direction = vec_negate(rec.surfaceNormal) };
+		rec.incident = &incident;
+		const struct bsdfSample s = rec.bsdf->sample(rec.bsdf, sampler, &rec);
+		const float opacity = light_opacity(l, sampler, &rec);
+		sum += opacity * max(0.0f, 0.2126f * s.emitted.red + 0.7152f * s.emitted.green + 0.0722f * s.emitted.blue);
+	}
+	return l->area * sum / (float)POWER_ESTIMATE_SAMPLES;
+}
+
+static struct light_bounds light_bounds(const struct light *l, float power) {
+	if (l->polygon) {
+		return (struct light_bounds){
+			.min = vec_min(l->v0, vec_min(l->v1, l->v2)),
+			.max = vec_max(l->v0, vec_max(l->v1, l->v2)),
+			.axis = vec_normalize(vec_cross(vec_sub(l->v1, l->v0), vec_sub(l->v2, l->v0))),
+			.theta_o = 0.0f,
+			.power = power
+		};
+	}
+	const struct vector r = { l->radius, l->radius, l->radius };
+	return (struct light_bounds){
+		.min = vec_sub(l->center, r),
+		.max = vec_add(l->center, r),
+		.axis = { 0.0f, 0.0f, 1.0f },
+		.theta_o = PI / 2.0f,
+		.power = power
+	};
+}
+
+void lights_build(struct light_list *list, struct world *scene) {
+	lights_free(list);
+	list->spans = calloc(scene->instances.count, sizeof(*list->spans));
+	for (size_t i = 0; i < scene->instances.count; ++i) {
+		struct instance *instance = &scene->instances.items[i];
+		instance->emits_light = false;
+		list->spans[i].first = list->lights.count;
+		if (!instance->object_arr || !instance->bbuf) continue; // Volumes
+		if (isMesh(instance)) {
+			add_mesh_lights(list, instance, i);
+		} else {
+			add_sphere_light(list, instance, i);
+		}
+		list->spans[i].count = list->lights.count - list->spans[i].first;
+	}
+	if (!list->lights.count) return;
+	struct light_bounds *bounds = malloc(list->lights.count * sizeof(*bounds));
+	struct sampler sampler_state = { 0 };
+	sampler *sampler = &sampler_state;
+	float total_power = 0.0f;
+	for (size_t i = 0; i < list->lights.count; ++i) {
+		const struct light *l = &list->lights.items[i];
+		const float power = light_power(l, &scene->instances.items[l->instance], sampler, i);
+		bounds[i] = light_bounds(l, power);
+		total_power += power;
+	}
+	list->bvh = build_light_bvh(bounds, list->lights.count);
+	free(bounds);
+	logr(debug, "Found %zu emissive primitives, total power %.2f\n", list->lights.count, (double)total_power);
+}
+
+bool lights_sample(const struct light_list *list, const struct world *scene, sampler *sampler, struct vector origin, struct light_sample *out) {
+	size_t idx;
+	float pmf;
+	if (!light_bvh_sample(list->bvh, origin, getDimension(sampler), &idx, &pmf)) return false;
+	const struct light *l = &list->lights.items[idx];
+	const struct instance *instance = &scene->instances.items[l->instance];
+	const float u1 = getDimension(sampler);
+	const float u2 = getDimension(sampler);
+	float pdf_area;
+	if (!l->polygon && sphere_sample_cone(l, instance, origin, u1, u2, &out->record, &pdf_area)) {
+		out->pdf_area = pmf * pdf_area;
+	} else {
+		light_point(l, instance, u1, u2, &out->record);
+		out->pdf_area = pmf / l->area;
+	}
+	out->opacity = light_opacity(l, sampler, &out->record);
+	return true;
+}
+
+// Find the light a hit landed on. Mesh lights are in polygon order, so binary search the instance's span.
+static const struct light *find_light(const struct light_list *list, const struct hitRecord *isect) {
+	if (!list->spans || isect->instIndex < 0) return NULL;
+	const struct light_span span = list->spans[isect->instIndex];
+	if (!span.count) return NULL;
+	if (!isect->polygon) return &list->lights.items[span.first];
+	size_t lo = span.first;
+	size_t hi = span.first + span.count;
+	while (lo < hi) {
+		const size_t mid = (lo + hi) / 2;
+		const struct poly *p = list->lights.items[mid].polygon;
+		if (p == isect->polygon) return &list->lights.items[mid];
+		if (p < isect->polygon) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return NULL;
+}
+
+float lights_pdf_area(const struct light_list *list, struct vector origin, const struct hitRecord *isect) {
+	const struct light *l = find_light(list, isect);
+	if (!l) return 0.0f;
+	const float pmf = light_bvh_pmf(list->bvh, origin, l - list->lights.items);
+	float cos_max, one_minus_cos_max;
+	if (!l->polygon && sphere_cone(l, origin, &cos_max, &one_minus_cos_max)) {
+		return pmf * solid_angle_to_area(sphere_cone_pdf(one_minus_cos_max), origin, isect->hitPoint, isect->geometricNormal);
+	}
+	return pmf / l->area;
+}
+
+void lights_free(struct light_list *list) {
+	if (!list) return;
+	light_arr_free(&list->lights);
+	free(list->spans);
+	destroy_light_bvh(list->bvh);
+	*list = (struct light_list){ 0 };
+}
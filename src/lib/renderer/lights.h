@@ -0,0 +1,75 @@
+//
+//  lights.h
+//  c-ray
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include "../../common/vector.h"
+#include "../../common/dyn_array.h"
+#include "../datatypes/hitrecord.h"
+#include "samplers/sampler.h"
+
+struct world;
+struct poly;
+struct light_bvh;
+struct valueNode;
+
+// An emissive primitive, in world space
+struct light {
+	size_t instance;
+	struct poly *polygon; // NULL for spheres
+	struct vector v0, v1, v2; // Triangle vertices
+	struct vector center; // Sphere center
+	float radius;
+	float area;
+	const struct valueNode *mask; // Cut-out opacity of the material, NULL if solid
+};
+
+typedef struct light light;
+dyn_array_def(light)
+
+// Lights of one instance, mesh lights are stored in polygon order
+struct light_span {
+	size_t first;
+	size_t count;
+};
+
+// All emissive primitives in a scene, gathered at render start for next event estimation
+struct light_list {
+	struct light_arr lights;
+	struct light_span *spans; // One per instance
+	struct light_bvh *bvh; // Lights are picked in proportion to their estimated contribution
+};
+
+// A point on a light. record is ready to be shaded, except for incident
+struct light_sample {
+	struct hitRecord record;
+	float pdf_area; // Includes the chance of picking the light
+	// Chance that a ray reaching the point hits it instead of passing through a cut-out.
+	// Emission seen through next event estimation is scaled by this, other rays test the mask in traversal.
+	float opacity;
+};
+
+// Gather emissive triangles and spheres from scene instances, and flag those instances with emits_light
+void lights_build(struct light_list *list, struct world *scene);
+
+// Pick a point on a light, for shading the point origin
+bool lights_sample(const struct light_list *list, const struct world *scene, sampler *sampler, struct vector origin, struct light_sample *out);
+
+// Area pdf of lights_sample() picking the surface point in isect, which must be on a light, when shading origin
+float lights_pdf_area(const struct light_list *list, struct vector origin, const struct hitRecord *isect);
+
+// Convert an area pdf of the light point in rec to a solid angle pdf as seen from origin. This goes by the
+// geometric normal, light_point() has no other. Shading normals of smooth meshes would make light sampling
+// and BSDF sampling disagree about the same point, and their MIS weights wouldn't add up to one.
+static inline float lights_pdf_solid_angle(float pdf_area, struct vector origin, const struct hitRecord *rec) {
+	const struct vector to_light = vec_sub(rec->hitPoint, origin);
+	const float dist_sq = vec_length_squared(to_light);
+	const float cos_light = fabsf(vec_dot(rec->geometricNormal, to_light)) / sqrtf(dist_sq);
+	if (!(cos_light > 0.0f)) return 0.0f;
+	return pdf_area * dist_sq / cos_light;
+}
+
+void lights_free(struct light_list *list);
@@ -18,50 +18,440 @@
 #include "../accelerators/bvh.h"
 #include "../../common/texture.h"
 #include "../../common/transforms.h"
+#include "../../common/assert.h"
 #include "samplers/sampler.h"
 #include "sky.h"
 #include "../renderer/instance.h"
 #include "../nodes/shaders/background.h"
+#include "lights.h"
+#include "guiding.h"
+#include "differentials.h"
 
-static inline struct hitRecord getClosestIsect(struct lightRay *incidentRay, const struct world *scene, sampler *sampler) {
+// Shadow rays stop this much short of the light, so they don't hit the emitter itself
+#define SHADOW_RAY_EPSILON 0.001f
+
+// Chance of sampling a guided direction at a bounce that has a learned distribution, BSDF sampling gets the rest
+#define GUIDE_FRACTION 0.25f
+
+// Deepest bounce that still trains the path guide
+#define GUIDE_MAX_VERTICES 16
+
+// Sampler dimension layout. cam_get_ray() uses the first ones for pixel jitter and the lens,
+// and every bounce after that starts at a fixed offset. Shaders draw a varying amount of
+// numbers, so without this, light sampling on one bounce would line up with BSDF sampling
+// on another depending on which materials the path happened to hit.
+enum path_dimension {
+	dim_camera = 4,
+	dim_bsdf = 0, // Volumes and BSDF sampling, relative to the bounce
+	dim_light = 8,
+	dim_environment = 11,
+	dim_russian_roulette = 13,
+	dim_guide = 16, // Strategy pick, bin, and the position within the bin
+	dims_per_bounce = 20
+};
+
+// Find the closest hit, and build the shading context for it. Misses get one for the background.
+static inline void getClosestIsect(struct lightRay *incidentRay, const struct world *scene, sampler *sampler, struct hitRecord *isect) {
 	//TODO: Consider passing in last instance idx + polygon to detect self-intersections?
-	struct hitRecord isect = { .incident = incidentRay, .instIndex = -1, .distance = FLT_MAX, .polygon = NULL };
-	traverse_top_level_bvh(scene->instances.items, scene->topLevel, incidentRay, &isect, sampler);
-	return isect;
+	struct hit hit = { .instIndex = -1, .distance = FLT_MAX, .polygon = NULL };
+	traverse_top_level_bvh(scene->instances.items, scene->topLevel, incidentRay, &hit, sampler);
+	if (hit.instIndex < 0) {
+		background_record(scene->background, sampler, incidentRay, isect);
+		return;
+	}
+	const struct instance *instance = &scene->instances.items[hit.instIndex];
+	*isect = (struct hitRecord){ .incident = incidentRay, .polygon = hit.polygon, .distance = hit.distance, .instIndex = hit.instIndex };
+	instance->getShadingFn(instance, incidentRay, &hit, isect);
+	hit_differentials(isect, incidentRay);
+}
+
+// Light sampling and BSDF sampling can both find the same emitter, weight them so they add up to one
+static inline float power_heuristic(float pdf_a, float pdf_b) {
+	const float a2 = pdf_a * pdf_a;
+	const float b2 = pdf_b * pdf_b;
+	return a2 + b2 > 0.0f ? a2 / (a2 + b2) : 0.0f;
+}
+
+// Solid angle pdf of light sampling picking the emitter point in isect, as seen from origin
+static inline float light_pdf(const struct world *scene, const struct hitRecord *isect, struct vector origin) {
+	return lights_pdf_solid_angle(lights_pdf_area(&scene->lights, origin, isect), origin, isect);
+}
+
+// Solid angle pdf of picking the scattering direction dir at isect, with guiding mixed in if cell is set
+static inline float scatter_pdf(const struct hitRecord *isect, const struct guide_cell *cell, sampler *sampler, struct vector dir) {
+	const float pdf_bsdf = isect->bsdf->pdf(isect->bsdf, sampler, isect, dir);
+	if (!cell) return pdf_bsdf;
+	return GUIDE_FRACTION * guide_pdf(cell, dir) + (1.0f - GUIDE_FRACTION) * pdf_bsdf;
 }
 
-struct color path_trace(struct lightRay incident, const struct world *scene, int max_bounces, sampler *sampler) {
-	struct color path_weight = g_white_color;
-	struct color path_radiance = g_black_color; // Final path contribution "color"
-	struct lightRay currentRay = incident;
+// Sample a direction towards the bright parts of the background
+static struct color sample_environment(const struct world *scene, const struct hitRecord *isect, const struct guide_cell *cell, sampler *sampler) {
+	struct vector dir;
+	float pdf_env;
+	if (!env_map_sample(&scene->env, sampler, &dir, &pdf_env)) return g_black_color;
+
+	const struct color f = isect->bsdf->eval(isect->bsdf, sampler, isect, dir);
+	if (f.red == 0.0f && f.green == 0.0f && f.blue == 0.0f) return g_black_color;
+
+	struct lightRay shadow = { .start = isect->hitPoint, .direction = dir, .type = rt_shadow };
+	if (traverse_top_level_bvh_occluded(scene->instances.items, scene->topLevel, &shadow, FLT_MAX, sampler))
+		return g_black_color;
+
+	struct hitRecord miss;
+	background_record(scene->background, sampler, &shadow, &miss);
+	const struct color emitted = scene->background->sample(scene->background, sampler, &miss).weight;
+	const float pdf_scatter = scatter_pdf(isect, cell, sampler, dir);
+	const float weight = power_heuristic(pdf_env, pdf_scatter) / pdf_env;
+	return colorCoef(weight, colorMul(f, emitted));
+}
+
+// Next event estimation: Sample a point on an emitter, and if it's visible,
+// return its contribution through the BSDF at isect, MIS weighted against BSDF sampling.
+static struct color sample_light(const struct world *scene, const struct hitRecord *isect, const struct guide_cell *cell, sampler *sampler) {
+	struct light_sample ls;
+	if (!lights_sample(&scene->lights, scene, sampler, isect->hitPoint, &ls)) return g_black_color;
+	struct vector to_light = vec_sub(ls.record.hitPoint, isect->hitPoint);
+	const float dist = vec_length(to_light);
+	if (dist <= 0.0f) return g_black_color;
+	to_light = vec_scale(to_light, 1.0f / dist);
+
+	// Emission doesn't care which side it's hit from, same as when BSDF sampling finds it
+	float cos_light = -vec_dot(ls.record.geometricNormal, to_light);
+	if (cos_light < 0.0f) {
+		ls.record.surfaceNormal = vec_negate(ls.record.surfaceNormal);
+		ls.record.geometricNormal = vec_negate(ls.record.geometricNormal);
+		cos_light = -cos_light;
+	}
+	if (cos_light <= 0.0f || ls.opacity <= 0.0f) return g_black_color;
+
+	const struct color f = isect->bsdf->eval(isect->bsdf, sampler, isect, to_light);
+	if (f.red == 0.0f && f.green == 0.0f && f.blue == 0.0f) return g_black_color;
+
+	struct lightRay shadow = { .start = isect->hitPoint, .direction = to_light, .type = rt_shadow };
+	if (traverse_top_level_bvh_occluded(scene->instances.items, scene->topLevel, &shadow, dist * (1.0f - SHADOW_RAY_EPSILON), sampler))
+		return g_black_color;
+
+	ls.record.incident = &shadow;
+	const struct color emitted = ls.record.bsdf->sample(ls.record.bsdf, sampler, &ls.record).emitted;
+	const float pdf_light = lights_pdf_solid_angle(ls.pdf_area, isect->hitPoint, &ls.record);
+	const float pdf_scatter = scatter_pdf(isect, cell, sampler, to_light);
+	const float weight = ls.opacity * power_heuristic(pdf_light, pdf_scatter) / pdf_light;
+	return colorCoef(weight, colorMul(f, emitted));
+}
 
-	for (int bounce = 0; bounce <= max_bounces; ++bounce) {
-		const struct hitRecord isect = getClosestIsect(&currentRay, scene, sampler);
-		if (isect.instIndex < 0) {
-			path_radiance = colorAdd(path_radiance, colorMul(path_weight, scene->background->sample(scene->background, sampler, &isect).weight));
-			break;
+// Guided directions aren't drawn from a lobe, and eval() doesn't say which lobe it evaluated. The geometric
+// normal faces the incident ray, so its side tells reflection from transmission, and the lobe comes from
+// the sample the BSDF drew at this same vertex. Bounce limits and light_path see the same type either way.
+static enum ray_type guided_type(const struct hitRecord *isect, struct vector dir, enum ray_type bsdf_type) {
+	const enum ray_type side = vec_dot(dir, isect->geometricNormal) >= 0.0f ? rt_reflection : rt_transmission;
+	const enum ray_type lobe = bsdf_type & (rt_diffuse | rt_glossy);
+	return side | (lobe ? lobe : rt_diffuse);
+}
+
+// Pick the next direction at a bounce with a learned distribution. This is a one-sample mixture of guiding
+// and BSDF sampling, so each is weighted by the pdf of the mixture. Singular lobes can only come from the BSDF.
+static struct bsdfSample guided_scatter(const struct hitRecord *isect, const struct guide_cell *cell, struct bsdfSample sample, sampler *sampler) {
+	if (getDimension(sampler) >= GUIDE_FRACTION) {
+		if (sample.pdf <= 0.0f) {
+			sample.weight = colorCoef(1.0f / (1.0f - GUIDE_FRACTION), sample.weight);
+			return sample;
 		}
-		
-		const struct bsdfSample sample = isect.bsdf->sample(isect.bsdf, sampler, &isect);
-		//TODO: emission contribution needs to be adjusted down by probability of randomly hitting it
-		//FIXME: emits_light only gets set if the root node of a shader graph is emissive, so maybe fix that
-		// if (true || scene->instances[isect.instIndex].emits_light) {
-			path_radiance = colorAdd(path_radiance, colorMul(path_weight, sample.emitted));
-		// }
-		if (bounce == max_bounces) break;
-
-		currentRay = sample.out;
-		const struct color attenuation = sample.weight;
-		
-		// Russian Roulette - Abort a path early if it won't contribute much to the final image
-		float rr_continue_probability = 1.0f;
-		if (bounce >= 4) {
-			rr_continue_probability = max(attenuation.red, max(attenuation.green, attenuation.blue));
-			if (getDimension(sampler) > rr_continue_probability)
-				break;
+		const float pdf = scatter_pdf(isect, cell, sampler, sample.out.direction);
+		sample.weight = colorCoef(sample.pdf / pdf, sample.weight);
+		sample.pdf = pdf;
+		return sample;
+	}
+	const float u0 = getDimension(sampler);
+	const float u1 = getDimension(sampler);
+	const float u2 = getDimension(sampler);
+	float pdf_guide;
+	const struct vector dir = guide_sample_dir(cell, u0, u1, u2, &pdf_guide);
+	const float pdf = GUIDE_FRACTION * pdf_guide + (1.0f - GUIDE_FRACTION) * isect->bsdf->pdf(isect->bsdf, sampler, isect, dir);
+	const struct color f = isect->bsdf->eval(isect->bsdf, sampler, isect, dir);
+	sample.out = (struct lightRay){ .start = isect->hitPoint, .direction = dir, .type = guided_type(isect, dir, sample.out.type) };
+	sample.weight = pdf > 0.0f ? colorCoef(1.0f / pdf, f) : g_black_color;
+	sample.pdf = pdf;
+	return sample;
+}
+
+static inline float luminance(struct color c) {
+	return 0.2126f * c.red + 0.7152f * c.green + 0.0722f * c.blue;
+}
+
+// Add light that hit surfaces before reaching the camera to the path radiance. Past the first surface it's
+// indirect light, where caustics and unlikely paths cause fireflies, so clamping it trades a bit of energy
+// for a lot less noise.
+static inline struct color add_light(struct color radiance, struct color light, int surfaces, float indirect_clamp) {
+	if (indirect_clamp > 0.0f && surfaces > 1) {
+		const float lum = luminance(light);
+		if (lum > indirect_clamp) light = colorCoef(indirect_clamp / lum, light);
+	}
+	return colorAdd(radiance, light);
+}
+
+// A bounce that trains the path guide once the path is done
+struct guide_vertex {
+	struct vector point;
+	struct vector dir;
+	float pdf;
+	float cos_theta;
+	float radiance_before; // Luminance of path_radiance before anything arrived through dir
+	float weight_after; // Luminance of path_weight for the rest of the path
+};
+
+static inline struct color clamp_albedo(struct color c) {
+	return (struct color){ clamp(c.red, 0.0f, 1.0f), clamp(c.green, 0.0f, 1.0f), clamp(c.blue, 0.0f, 1.0f), 1.0f };
+}
+
+// Bounce types with limits of their own, same split as Cycles uses
+enum bounce_kind {
+	bounce_diffuse,
+	bounce_glossy,
+	bounce_transmission,
+	bounce_kinds
+};
+
+static inline enum bounce_kind bounce_kind(enum ray_type type) {
+	if (type & rt_diffuse) return bounce_diffuse;
+	if (type & rt_transmission) return bounce_transmission;
+	return bounce_glossy;
+}
+
+// One path in flight. path_trace() keeps one on the stack, batches keep one per pixel
+// and advance them all a bounce at a time.
+struct path_state {
+	sampler *sampler;
+	struct lightRay ray;
+	struct hitRecord isect;
+	struct color weight;
+	struct color radiance; // Final path contribution "color"
+	float last_bsdf_pdf; // 0 if the previous bounce didn't sample lights, or took a singular lobe
+	int bounce;
+	int type_bounces[bounce_kinds];
+	bool done;
+	bool need_aov;
+	struct path_aov aov;
+	size_t vertex_count;
+	struct guide_vertex vertices[GUIDE_MAX_VERTICES];
+};
+
+static void path_begin(struct path_state *p, struct lightRay incident, sampler *sampler, bool need_aov) {
+	p->sampler = sampler;
+	p->ray = incident;
+	p->weight = g_white_color;
+	p->radiance = g_black_color;
+	p->last_bsdf_pdf = 0.0f;
+	p->bounce = 0;
+	for (int i = 0; i < bounce_kinds; ++i) p->type_bounces[i] = 0;
+	p->done = false;
+	p->need_aov = need_aov;
+	p->aov = (struct path_aov){ 0 };
+	p->vertex_count = 0;
+}
+
+// Find the next hit. Paths that leave the scene pick up the background and end here.
+static void path_intersect(struct path_state *p, const struct world *scene, const struct path_limits *limits) {
+	const unsigned dim = dim_camera + (unsigned)p->bounce * dims_per_bounce;
+	setDimension(p->sampler, dim + dim_bsdf);
+	getClosestIsect(&p->ray, scene, p->sampler, &p->isect);
+	if (p->isect.instIndex >= 0) return;
+	// The background is sampled directly too, so weight it like emitters below
+	float background_weight = 1.0f;
+	if (p->last_bsdf_pdf > 0.0f && env_map_active(&scene->env)) {
+		background_weight = power_heuristic(p->last_bsdf_pdf, env_map_pdf(&scene->env, p->ray.direction));
+	}
+	const struct color background = scene->background->sample(scene->background, p->sampler, &p->isect).weight;
+	if (p->need_aov) p->aov.albedo = clamp_albedo(colorMul(p->weight, background));
+	p->radiance = add_light(p->radiance, colorMul(p->weight, colorCoef(background_weight, background)), p->bounce, limits->indirect_clamp);
+	p->done = true;
+}
+
+// Shade the hit path_intersect() found, and pick the ray for the next bounce
+static void path_shade(struct path_state *p, const struct world *scene, const struct path_limits *limits, struct guide_recorder *guide) {
+	const struct hitRecord *isect = &p->isect;
+	sampler *sampler = p->sampler;
+	const int bounce = p->bounce;
+	const unsigned dim = dim_camera + (unsigned)bounce * dims_per_bounce;
+	const bool sample_lights = scene->lights.lights.count > 0 || env_map_active(&scene->env);
+
+	struct bsdfSample sample = isect->bsdf->sample(isect->bsdf, sampler, isect);
+	// Emitters are also sampled directly from the previous bounce, so only count the BSDF sampling share here
+	float emission_weight = 1.0f;
+	if (p->last_bsdf_pdf > 0.0f && scene->instances.items[isect->instIndex].emits_light) {
+		emission_weight = power_heuristic(p->last_bsdf_pdf, light_pdf(scene, isect, p->ray.start));
+	}
+	p->radiance = add_light(p->radiance, colorMul(p->weight, colorCoef(emission_weight, sample.emitted)), bounce, limits->indirect_clamp);
+	// Diffuse sampling weights are the surface color, and for mixed materials they average out to it
+	if (p->need_aov && (isect->bsdf->eval || bounce == limits->max_bounces)) {
+		p->aov.albedo = clamp_albedo(colorMul(p->weight, colorAdd(sample.weight, sample.emitted)));
+		p->aov.normal = isect->surfaceNormal;
+		p->need_aov = false;
+	}
+	if (bounce == limits->max_bounces) {
+		p->done = true;
+		return;
+	}
+
+	// Only bounces that can evaluate arbitrary directions can be guided, which leaves out mirrors and smooth glass
+	const bool guidable = guide && isect->bsdf->eval;
+	const struct guide_cell *cell = guidable ? guide_lookup(guide, isect->hitPoint) : NULL;
+
+	p->last_bsdf_pdf = 0.0f;
+	if (sample_lights && isect->bsdf->eval) {
+		// Lights and the background are sampled separately, so neither needs a random pick
+		// between them. Each strategy is only MIS weighted against BSDF sampling.
+		if (scene->lights.lights.count) {
+			setDimension(sampler, dim + dim_light);
+			p->radiance = add_light(p->radiance, colorMul(p->weight, sample_light(scene, isect, cell, sampler)), bounce + 1, limits->indirect_clamp);
+		}
+		if (env_map_active(&scene->env)) {
+			setDimension(sampler, dim + dim_environment);
+			p->radiance = add_light(p->radiance, colorMul(p->weight, sample_environment(scene, isect, cell, sampler)), bounce + 1, limits->indirect_clamp);
+		}
+	}
+
+	if (cell) {
+		setDimension(sampler, dim + dim_guide);
+		sample = guided_scatter(isect, cell, sample, sampler);
+	}
+	if (sample_lights && isect->bsdf->eval) p->last_bsdf_pdf = sample.pdf;
+
+	// Per-type limits are checked once the bounce type is known, so direct light at this bounce still counts
+	const int type_limits[bounce_kinds] = { limits->diffuse_bounces, limits->glossy_bounces, limits->transmission_bounces };
+	const enum bounce_kind kind = bounce_kind(sample.out.type);
+	if (type_limits[kind] && ++p->type_bounces[kind] > type_limits[kind]) {
+		p->done = true;
+		return;
+	}
+
+	scatter_differentials(isect, &p->ray, &sample.out);
+	p->ray = sample.out;
+	const struct color attenuation = sample.weight;
+	if (attenuation.red == 0.0f && attenuation.green == 0.0f && attenuation.blue == 0.0f) {
+		p->done = true;
+		return;
+	}
+	p->weight = colorMul(attenuation, p->weight);
+
+	// Russian Roulette - Abort a path early if it won't contribute much to the final image.
+	// This goes by the throughput of the whole path, so a path that is already dim ends soon,
+	// but one bounce losing some energy doesn't cut off a bright path through glass.
+	if (bounce >= limits->rr_start_depth) {
+		// Guided and MIS weighted paths can have throughputs above one, that still means "keep going"
+		const float throughput = max(p->weight.red, max(p->weight.green, p->weight.blue));
+		const float rr_continue_probability = clamp(throughput, limits->rr_min_probability, 1.0f);
+		setDimension(sampler, dim + dim_russian_roulette);
+		if (getDimension(sampler) >= rr_continue_probability) {
+			p->done = true;
+			return;
+		}
+		p->weight = colorCoef(1.0f / rr_continue_probability, p->weight);
+	}
+
+	if (guidable && sample.pdf > 0.0f && p->vertex_count < GUIDE_MAX_VERTICES) {
+		p->vertices[p->vertex_count++] = (struct guide_vertex){
+			.point = isect->hitPoint,
+			.dir = sample.out.direction,
+			.pdf = sample.pdf,
+			.cos_theta = fabsf(vec_dot(isect->surfaceNormal, sample.out.direction)),
+			.radiance_before = luminance(p->radiance),
+			.weight_after = luminance(p->weight)
+		};
+	}
+	p->bounce++;
+}
+
+static void path_finish(const struct path_state *p, struct guide_recorder *guide) {
+	// Whatever the path picked up after a bounce arrived there through the direction it took.
+	// The guide learns incident radiance times the cosine, which is what a diffuse surface scatters.
+	if (p->vertex_count) {
+		const float radiance = luminance(p->radiance);
+		for (size_t i = 0; i < p->vertex_count; ++i) {
+			const struct guide_vertex *v = &p->vertices[i];
+			if (v->weight_after <= 0.0f) continue;
+			const float incident = (radiance - v->radiance_before) / v->weight_after;
+			guide_record(guide, v->point, v->dir, incident * v->cos_theta, v->pdf);
 		}
-		
-		path_weight = colorCoef(1.0f / rr_continue_probability, colorMul(attenuation, path_weight));
 	}
-	return path_radiance;
+}
+
+struct color path_trace(struct lightRay incident, const struct world *scene, const struct path_limits *limits, sampler *sampler, struct guide_recorder *guide, struct path_aov *aov) {
+	struct path_state path;
+	path_begin(&path, incident, sampler, aov);
+	while (true) {
+		path_intersect(&path, scene, limits);
+		if (path.done) break;
+		path_shade(&path, scene, limits, guide);
+		if (path.done) break;
+	}
+	path_finish(&path, guide);
+	if (aov) *aov = path.aov;
+	return path.radiance;
+}
+
+void path_batch_reset(struct path_batch *b, size_t capacity, bool aov) {
+	if (capacity > b->capacity) {
+		free(b->paths);
+		free(b->samplers);
+		free(b->order);
+		b->paths = malloc(capacity * sizeof(*b->paths));
+		b->samplers = malloc(capacity * sizeof(*b->samplers));
+		b->order = malloc(capacity * sizeof(*b->order));
+		b->capacity = capacity;
+	}
+	b->count = 0;
+	b->aov = aov;
+}
+
+void path_batch_add(struct path_batch *b, struct lightRay incident, const sampler *sampler) {
+	ASSERT(b->count < b->capacity);
+	b->samplers[b->count] = *sampler;
+	path_begin(&b->paths[b->count], incident, &b->samplers[b->count], b->aov);
+	b->count++;
+}
+
+// Materials are hash-consed, so paths that hit the same one share a bsdf pointer.
+// Ties go by position in the batch, so the shading order doesn't depend on qsort.
+static int compare_materials(const void *A, const void *B) {
+	const struct path_state *a = *(struct path_state *const *)A;
+	const struct path_state *b = *(struct path_state *const *)B;
+	const uintptr_t bsdf_a = (uintptr_t)a->isect.bsdf;
+	const uintptr_t bsdf_b = (uintptr_t)b->isect.bsdf;
+	if (bsdf_a != bsdf_b) return bsdf_a < bsdf_b ? -1 : 1;
+	return (a > b) - (a < b);
+}
+
+void path_batch_trace(struct path_batch *b, const struct world *scene, const struct path_limits *limits, struct guide_recorder *guide) {
+	size_t active = b->count;
+	for (size_t i = 0; i < b->count; ++i) b->order[i] = &b->paths[i];
+	while (active) {
+		// Trace everything first, then shade the hits grouped by material. Each path has a
+		// sampler of its own, so the order doesn't change what any single path draws.
+		size_t hits = 0;
+		for (size_t i = 0; i < active; ++i) {
+			struct path_state *p = b->order[i];
+			path_intersect(p, scene, limits);
+			if (!p->done) b->order[hits++] = p;
+		}
+		qsort(b->order, hits, sizeof(*b->order), compare_materials);
+		active = 0;
+		for (size_t i = 0; i < hits; ++i) {
+			struct path_state *p = b->order[i];
+			path_shade(p, scene, limits, guide);
+			if (!p->done) b->order[active++] = p;
+		}
+	}
+	for (size_t i = 0; i < b->count; ++i) path_finish(&b->paths[i], guide);
+}
+
+struct color path_batch_result(const struct path_batch *b, size_t i, struct path_aov *aov) {
+	if (aov) *aov = b->paths[i].aov;
+	return b->paths[i].radiance;
+}
+
+void path_batch_free(struct path_batch *b) {
+	free(b->paths);
+	free(b->samplers);
+	free(b->order);
+	*b = (struct path_batch){ 0 };
 }
@@ -27,11 +27,20 @@
 #include "../protocol/server.h"
 #include "../accelerators/bvh.h"
 #include "samplers/sampler.h"
+#include "accumulator.h"
+#include "guiding.h"
+#include "denoise.h"
+#include "../nodes/cache.h"
 
 //Main thread loop speeds
 #define paused_msec 100
 #define active_msec  16
 
+// Adaptive sampling: samples a block needs before its variance estimate is trusted,
+// and how far past sampleCount a noisy block can go with samples saved elsewhere.
+#define ADAPTIVE_MIN_SAMPLES 16
+#define ADAPTIVE_MAX_FACTOR 4
+
 static bool g_aborted = false;
 
 void sigHandler(int sig) {
@@ -72,8 +81,10 @@ void update_cb_info(struct renderer *r, struct tile_set *set, struct cr_renderer
 	static uint64_t ctr = 1;
 	static uint64_t avg_per_sample_us = 0;
 	static uint64_t avg_tile_pass_us = 0;
-	// Notice: Casting away const here
-	memcpy((struct cr_tile *)i->tiles, set->tiles.items, sizeof(*i->tiles) * i->tiles_count);
+	// Notice: Casting away const here. struct render_tile starts with the fields of struct cr_tile, but is larger.
+	for (size_t t = 0; t < i->tiles_count; ++t) {
+		memcpy((struct cr_tile *)&i->tiles[t], &set->tiles.items[t], sizeof(*i->tiles));
+	}
 	if (!r->state.workers.count) return;
 	//Gather and maintain this average constantly.
 	size_t remote_threads = 0;
@@ -96,12 +107,17 @@ void update_cb_info(struct renderer *r, struct tile_set *set, struct cr_renderer
 	uint64_t eta_ms_till_done = (avg_tile_pass_us * remainingTileSamples) / 1000;
 	eta_ms_till_done /= (r->prefs.threads + remote_threads);
 	uint64_t sps = (1000000 / avg_per_ray_us) * (r->prefs.threads + remote_threads);
+	if (r->prefs.time_limit_ms) {
+		long elapsed_ms = timer_get_ms(r->state.render_timer);
+		uint64_t limit_left_ms = (uint64_t)elapsed_ms < r->prefs.time_limit_ms ? r->prefs.time_limit_ms - elapsed_ms : 0;
+		eta_ms_till_done = min(eta_ms_till_done, limit_left_ms);
+	}
 
 	i->paused = r->state.workers.items[0].paused;
 	i->avg_per_ray_us = avg_per_ray_us;
 	i->samples_per_sec = sps;
 	i->eta_ms = eta_ms_till_done;
-	i->completion = r->prefs.iterative ?
+	i->completion = r->prefs.iterative || r->prefs.progressive ?
 		((double)r->state.finishedPasses / (double)r->prefs.sampleCount) :
 		((double)set->finished / (double)set->tiles.count);
 
@@ -113,6 +129,43 @@ static void *thread_stub(void *arg) {
 	return NULL;
 }
 
+struct cr_thread_pool *renderer_thread_pool(struct renderer *r) {
+	// Every local render thread needs a pool thread of its own, grow if prefs.threads went up
+	const size_t wanted = max(r->prefs.threads, 1);
+	if (r->state.pool && r->state.pool_threads >= wanted) return r->state.pool;
+	if (r->state.pool) thread_pool_destroy(r->state.pool);
+	r->state.pool = thread_pool_create(wanted);
+	r->state.pool_threads = wanted;
+	return r->state.pool;
+}
+
+// Make sure *buf is a cleared float texture of the given size
+static void prepare_buffer(struct texture **buf, size_t width, size_t height, size_t channels) {
+	if (*buf && (*buf)->width == width && (*buf)->height == height && (*buf)->channels == channels) {
+		tex_clear(*buf);
+		return;
+	}
+	destroyTexture(*buf);
+	*buf = newTexture(float_p, width, height, channels);
+}
+
+// Fold the denoiser inputs of a sample into pixel (x, y), which already averages samples_before of them.
+// Only for interactive mode, where a pixel gets one sample per pass anyway. Tiles sum them up in their tile_accum.
+static inline void store_aov(struct renderer *r, size_t x, size_t y, size_t samples_before, const struct path_aov *aov) {
+	const float t = 1.0f / (float)(samples_before + 1);
+	const struct color albedo = textureGetPixel(r->state.albedo_buf, x, y, false);
+	setPixel(r->state.albedo_buf, colorAdd(colorCoef(1.0f - t, albedo), colorCoef(t, aov->albedo)), x, y);
+	const struct color normal = textureGetPixel(r->state.normal_buf, x, y, false);
+	const struct color sample_normal = { aov->normal.x, aov->normal.y, aov->normal.z, 1.0f };
+	setPixel(r->state.normal_buf, colorAdd(colorCoef(1.0f - t, normal), colorCoef(t, sample_normal)), x, y);
+}
+
+// Render threads run as thread pool tasks
+static void render_task(void *arg) {
+	struct worker *worker = arg;
+	worker->thread.thread_fn(worker);
+}
+
 // Nonblocking function to make python happy, just shove the normal loop in a
 // background thread.
 void renderer_start_interactive(struct renderer *r) {
@@ -169,7 +222,7 @@ void renderer_render(struct renderer *r) {
 
 	// Do some pre-render preparations
 	// Compute BVH acceleration structures for all meshes in the scene
-	compute_accels(r->scene->meshes);
+	compute_accels(renderer_thread_pool(r), r->scene->meshes);
 
 	// And then compute a single top-level BVH that contains all the objects
 	if (r->scene->instances_dirty) {
@@ -183,6 +236,17 @@ void renderer_render(struct renderer *r) {
 		r->scene->instances_dirty = false;
 	}
 
+	// Materials may have changed even if instances didn't, so always regather lights
+	lights_build(&r->scene->lights, r->scene);
+	env_map_build(&r->scene->env, env_map_wanted(r->scene->bg_desc) ? r->scene->background : NULL);
+
+	// Only local render threads use the guide, network workers render without one
+	guide_destroy(r->state.guide);
+	r->state.guide = NULL;
+	if (r->prefs.path_guiding && r->scene->topLevel) {
+		r->state.guide = guide_new(get_root_bbox(r->scene->topLevel));
+	}
+
 	print_stats(r->scene);
 
 	for (size_t i = 0; i < set.tiles.count; ++i)
@@ -196,16 +260,21 @@ void renderer_render(struct renderer *r) {
 	}
 
 	// Render buffer is used to store accurate color values for the renderers' internal use
-	if (!r->state.result_buf) {
-		// Allocate
-		r->state.result_buf = newTexture(float_p, camera->width, camera->height, 4);
-	} else if (r->state.result_buf->width != (size_t)camera->width || r->state.result_buf->height != (size_t)camera->height) {
-		// Resize
-		if (r->state.result_buf) destroyTexture(r->state.result_buf);
-		r->state.result_buf = newTexture(float_p, camera->width, camera->height, 4);
+	prepare_buffer(&r->state.result_buf, camera->width, camera->height, 4);
+
+	// Network workers only send back color, so the denoiser wouldn't have anything to go on for their tiles
+	if (r->prefs.denoise && r->state.clients.count) {
+		logr(warning, "Denoising is not supported with network rendering, skipping it\n");
+		r->prefs.denoise = false;
+	}
+	if (r->prefs.denoise) {
+		prepare_buffer(&r->state.albedo_buf, camera->width, camera->height, 3);
+		prepare_buffer(&r->state.normal_buf, camera->width, camera->height, 3);
 	} else {
-		// Clear
-		tex_clear(r->state.result_buf);
+		destroyTexture(r->state.albedo_buf);
+		destroyTexture(r->state.normal_buf);
+		r->state.albedo_buf = NULL;
+		r->state.normal_buf = NULL;
 	}
 
 	struct texture **result = &r->state.result_buf;
@@ -217,26 +286,45 @@ void renderer_render(struct renderer *r) {
 		.fb = (const struct cr_bitmap **)result,
 	};
 	
+	// The time limit and ETA read this from the very first callback on
+	timer_start(&r->state.render_timer);
 	struct callback start = r->state.callbacks[cr_cb_on_start];
 	if (start.fn) {
 		update_cb_info(r, &set, &cb_info);
 		start.fn(&cb_info, start.user_data);
 	}
 
-	logr(info, "Pathtracing%s...\n", r->prefs.iterative ? " iteratively" : "");
+	// Progressive mode shares the interactive pass loop, which is incompatible with network rendering at the moment
+	if (r->prefs.progressive && r->state.clients.count) {
+		logr(warning, "Progressive mode is not supported with network rendering, rendering tile by tile instead\n");
+		r->prefs.progressive = false;
+	}
+	// Progressive passes go over every tile in lockstep, there's no per-block sample count to adapt
+	if (r->prefs.progressive && r->prefs.noise_threshold > 0.0f) {
+		logr(error, "Adaptive sampling (noise threshold) is not supported in progressive mode\n");
+	}
+
+	logr(info, "Pathtracing%s...\n", r->prefs.iterative ? " iteratively" : r->prefs.progressive ? " progressively" : "");
 	
 	r->state.rendering = true;
 	r->state.render_aborted = false;
+	r->state.finishedPasses = 1;
+	if (r->prefs.time_limit_ms && !r->prefs.iterative) {
+		char buf[64];
+		logr(info, "Time limit is %s, sample counts will be adjusted to fit\n", ms_to_readable(r->prefs.time_limit_ms, buf));
+	}
 	
 	if (r->state.clients.count) logr(info, "Using %lu render worker%s totaling %lu thread%s.\n", r->state.clients.count, PLURAL(r->state.clients.count), r->state.clients.count, PLURAL(r->state.clients.count));
 	
 	// Select the appropriate renderer type for local use
 	void *(*local_render_thread)(void *) = render_thread;
 	// Iterative mode is incompatible with network rendering at the moment
-	if (r->prefs.iterative && !r->state.clients.count) local_render_thread = render_thread_interactive;
+	if ((r->prefs.iterative || r->prefs.progressive) && !r->state.clients.count) local_render_thread = render_thread_interactive;
 	
 	// Create & boot workers (Nonblocking)
-	// Local render threads + one thread for every client
+	// Local render threads run in the thread pool, and every client gets a thread of its own
+	struct cr_thread_pool *pool = renderer_thread_pool(r);
+	r->state.workers.count = 0;
 	for (size_t t = 0; t < r->prefs.threads; ++t) {
 		worker_arr_add(&r->state.workers, (struct worker){
 			.renderer = r,
@@ -259,10 +347,15 @@ void renderer_render(struct renderer *r) {
 		});
 	}
 	for (size_t w = 0; w < r->state.workers.count; ++w) {
-		r->state.workers.items[w].thread.user_data = &r->state.workers.items[w];
-		r->state.workers.items[w].tiles = &set;
-		if (thread_start(&r->state.workers.items[w].thread))
+		struct worker *worker = &r->state.workers.items[w];
+		worker->thread.user_data = worker;
+		worker->tiles = &set;
+		if (worker->client) {
+			if (thread_start(&worker->thread))
+				logr(error, "Failed to start worker %zu\n", w);
+		} else if (!thread_pool_enqueue(pool, render_task, worker)) {
 			logr(error, "Failed to start worker %zu\n", w);
+		}
 	}
 
 	//Start main thread loop to handle renderer feedback and state management
@@ -290,7 +383,19 @@ void renderer_render(struct renderer *r) {
 	
 	//Make sure render threads are terminated before continuing (This blocks)
 	for (size_t w = 0; w < r->state.workers.count; ++w) {
-		thread_wait(&r->state.workers.items[w].thread);
+		if (r->state.workers.items[w].client) thread_wait(&r->state.workers.items[w].thread);
+	}
+	thread_pool_wait(pool);
+	guide_destroy(r->state.guide);
+	r->state.guide = NULL;
+
+	if (r->state.albedo_buf) {
+		logr(info, "Denoising: ");
+		struct timeval denoise_timer = { 0 };
+		timer_start(&denoise_timer);
+		denoise(pool, r->state.result_buf, r->state.albedo_buf, r->state.normal_buf);
+		printSmartTime(timer_get_ms(denoise_timer));
+		logr(plain, "\n");
 	}
 	struct callback stop = r->state.callbacks[cr_cb_on_stop];
 	if (stop.fn) {
@@ -303,15 +408,67 @@ void renderer_render(struct renderer *r) {
 	r->state.exit_done = true;
 }
 
+static int64_t time_remaining_us(const struct renderer *r) {
+	return ((int64_t)r->prefs.time_limit_ms - timer_get_ms(r->state.render_timer)) * 1000;
+}
+
+// Check if a whole pass over every tile is expected to finish before prefs.time_limit_ms runs out.
+// The estimate uses the latest single tile pass time of each worker.
+bool renderer_has_time_for_pass(const struct renderer *r, const struct tile_set *set) {
+	if (!r->prefs.time_limit_ms) return true;
+	const int64_t remaining_us = time_remaining_us(r);
+	if (remaining_us <= 0) return false;
+	uint64_t tile_pass_us = 0;
+	size_t measured = 0;
+	for (size_t w = 0; w < r->state.workers.count; ++w) {
+		if (!r->state.workers.items[w].avg_per_sample_us) continue;
+		tile_pass_us += r->state.workers.items[w].avg_per_sample_us;
+		measured++;
+	}
+	if (!measured) return true;
+	const uint64_t pass_us = (tile_pass_us / measured) * set->tiles.count / r->state.workers.count;
+	return pass_us <= (uint64_t)remaining_us;
+}
+
+// Share of the remaining time budget one tile gets, assuming the tiles that
+// haven't been handed out yet are spread evenly over all threads.
+static int64_t tile_time_budget_us(const struct renderer *r, const struct tile_set *set) {
+	const int64_t remaining_us = time_remaining_us(r);
+	if (remaining_us <= 0) return 0;
+	// set->finished already counts the tile we're about to render
+	const double remaining_tiles = (double)(set->tiles.count - set->finished + 1);
+	const double tiles_per_thread = max(remaining_tiles / (double)r->prefs.threads, 1.0);
+	return (int64_t)((double)remaining_us / tiles_per_thread);
+}
+
+// How many samples the current tile can have within budget_us, given spent_us on the samples done so far.
+// Never drops below what's already done, so the running average stays valid, and every tile gets at least one sample.
+static size_t tile_samples_in_budget(const struct renderer *r, const struct render_tile *tile, int64_t budget_us, long spent_us) {
+	const size_t done = tile->completed_samples;
+	if (!done) return 1;
+	const int64_t per_sample_us = max(spent_us / (long)done, 1);
+	const int64_t left_us = budget_us - spent_us;
+	const size_t affordable = done + (left_us > 0 ? (size_t)(left_us / per_sample_us) : 0);
+	return min(affordable, r->prefs.sampleCount);
+}
+
 // An interactive render thread that progressively
-// renders samples up to a limit
+// renders samples up to a limit. Every tile is rendered at pass n before any
+// tile gets pass n + 1, so stopping early still leaves a uniformly converged frame.
 void *render_thread_interactive(void *arg) {
 	block_signals();
 	struct worker *threadState = arg;
 	threadState->in_pause_loop = false;
 	struct renderer *r = threadState->renderer;
 	struct texture **buf = threadState->buf;
-	sampler *sampler = newSampler();
+	struct sampler sampler_state = { .node_cache = r->scene->has_cache_nodes ? node_cache_new() : NULL };
+	sampler *sampler = &sampler_state;
+	struct guide_recorder guide_state;
+	guide_recorder_init(&guide_state, r->state.guide);
+	struct guide_recorder *guide = r->state.guide ? &guide_state : NULL;
+	struct path_aov aov_state;
+	struct path_aov *aov = r->state.albedo_buf ? &aov_state : NULL;
+	const struct path_limits limits = path_limits_from_prefs(&r->prefs);
 
 	struct camera *cam = threadState->cam;
 	
@@ -323,26 +480,27 @@ void *render_thread_interactive(void *arg) {
 	
 	while (tile && r->state.rendering) {
 		long total_us = 0;
+		// tile_next_interactive() records the pass this tile was handed out for.
+		// Don't use finishedPasses here, it advances as soon as the last tile of a pass is dispatched.
+		const size_t pass = tile->pass + 1;
 
 		timer_start(&timer);
 		for (int y = tile->end.y - 1; y > tile->begin.y - 1; --y) {
 			for (int x = tile->begin.x; x < tile->end.x; ++x) {
 				if (r->state.render_aborted) goto exit;
 				uint32_t pixIdx = (uint32_t)(y * (*buf)->width + x);
-				//FIXME: This does not converge to the same result as with regular renderThread.
-				//I assume that's because we'd have to init the sampler differently when we render all
-				//the tiles in one go per sample, instead of the other way around.
-				initSampler(sampler, SAMPLING_STRATEGY, r->state.finishedPasses, r->prefs.sampleCount, pixIdx);
+				initSampler(sampler, r->prefs.sampler, pass - 1, r->prefs.sampleCount, pixIdx);
 				
 				struct color output = textureGetPixel(*buf, x, y, false);
-				struct color sample = path_trace(cam_get_ray(cam, x, y, sampler), r->scene, r->prefs.bounces, sampler);
+				struct color sample = path_trace(cam_get_ray(cam, x, y, sampler), r->scene, &limits, sampler, guide, aov);
+				if (aov) store_aov(r, x, y, pass - 1, aov);
 
 				nan_clamp(&sample, &output);
 				
 				//And process the running average
-				output = colorCoef((float)(r->state.finishedPasses - 1), output);
+				output = colorCoef((float)(pass - 1), output);
 				output = colorAdd(output, sample);
-				float t = 1.0f / r->state.finishedPasses;
+				float t = 1.0f / pass;
 				output = colorCoef(t, output);
 				
 				//Store internal render buffer (float precision)
@@ -352,9 +510,11 @@ void *render_thread_interactive(void *arg) {
 		//For performance metrics
 		total_us += timer_get_us(timer);
 		threadState->totalSamples++;
-		threadState->avg_per_sample_us = total_us / r->state.finishedPasses;
+		threadState->avg_per_sample_us = total_us;
+		if (guide) guide_recorder_commit(guide);
 		
 		//Tile has finished rendering, get a new one and start rendering it.
+		tile->completed_samples = pass;
 		tile->state = finished;
 		threadState->currentTile = NULL;
 		tile = tile_next_interactive(r, threadState->tiles);
@@ -369,7 +529,8 @@ void *render_thread_interactive(void *arg) {
 		threadState->currentTile = tile;
 	}
 exit:
-	destroySampler(sampler);
+	node_cache_free(sampler_state.node_cache);
+	guide_recorder_free(&guide_state);
 	//No more tiles to render, exit thread. (render done)
 	threadState->thread_complete = true;
 	threadState->currentTile = NULL;
@@ -387,7 +548,17 @@ void *render_thread(void *arg) {
 	struct worker *threadState = arg;
 	struct renderer *r = threadState->renderer;
 	struct texture **buf = threadState->buf;
-	sampler *sampler = newSampler();
+	struct sampler sampler_state = { .node_cache = r->scene->has_cache_nodes ? node_cache_new() : NULL };
+	sampler *sampler = &sampler_state;
+	struct tile_accum accum = { 0 };
+	struct guide_recorder guide_state;
+	guide_recorder_init(&guide_state, r->state.guide);
+	struct guide_recorder *guide = r->state.guide ? &guide_state : NULL;
+	struct path_aov aov_state;
+	struct path_aov *aov = r->state.albedo_buf ? &aov_state : NULL;
+	const struct path_limits limits = path_limits_from_prefs(&r->prefs);
+	struct path_batch batch_state = { 0 };
+	struct path_batch *batch = r->prefs.sort_shading ? &batch_state : NULL;
 
 	struct camera *cam = threadState->cam;
 
@@ -396,55 +567,92 @@ void *render_thread(void *arg) {
 	threadState->currentTile = tile;
 	
 	struct timeval timer = { 0 };
-	size_t samples = 1;
 	
+	const bool adaptive = r->prefs.noise_threshold > 0.0f;
+	// Blocks that converge early hand their samples over to noisy ones, up to this many per pixel
+	const size_t max_samples = adaptive ? r->prefs.sampleCount * ADAPTIVE_MAX_FACTOR : r->prefs.sampleCount;
+
 	while (tile && r->state.rendering) {
 		long total_us = 0;
+		const int64_t tile_budget_us = r->prefs.time_limit_ms ? tile_time_budget_us(r, threadState->tiles) : 0;
+		const size_t pixels = tile->width * tile->height;
+		size_t taken = 0; // Pixel samples so far, the tile may spend pixels * tile->total_samples
+		accum_reset(&accum, tile->width, tile->height, adaptive, r->prefs.median_of_means, aov);
 		
-		while (samples < r->prefs.sampleCount + 1 && r->state.rendering) {
+		while (accum.active_blocks && taken < pixels * tile->total_samples && r->state.rendering) {
 			timer_start(&timer);
-			for (int y = tile->end.y - 1; y > tile->begin.y - 1; --y) {
-				for (int x = tile->begin.x; x < tile->end.x; ++x) {
-					if (r->state.render_aborted) goto exit;
-					uint32_t pixIdx = (uint32_t)(y * (*buf)->width + x);
-					initSampler(sampler, SAMPLING_STRATEGY, samples - 1, r->prefs.sampleCount, pixIdx);
-					
-					struct color output = textureGetPixel(*buf, x, y, false);
-					struct color sample = path_trace(cam_get_ray(cam, x, y, sampler), r->scene, r->prefs.bounces, sampler);
-					
-					// Clamp out fireflies - This is probably not a good way to do that.
-					nan_clamp(&sample, &output);
-
-					//And process the running average
-					output = colorCoef((float)(samples - 1), output);
-					output = colorAdd(output, sample);
-					float t = 1.0f / samples;
-					output = colorCoef(t, output);
-					
-					//Store internal render buffer (float precision)
-					setPixel(*buf, output, x, y);
+			if (batch) path_batch_reset(batch, pixels, aov);
+			for (size_t i = 0; i < accum.blocks_x * accum.blocks_y; ++i) {
+				const struct accum_block *b = &accum.blocks[i];
+				if (!b->active) continue;
+				for (unsigned by = b->begin_y; by < b->end_y; ++by) {
+					const int y = tile->begin.y + by;
+					for (unsigned bx = b->begin_x; bx < b->end_x; ++bx) {
+						if (r->state.render_aborted) goto exit;
+						const int x = tile->begin.x + bx;
+						uint32_t pixIdx = (uint32_t)(y * (*buf)->width + x);
+						// The sequence is laid out for the configured sample count, adaptive
+						// sampling only changes how far along it a block gets
+						initSampler(sampler, r->prefs.sampler, b->samples, r->prefs.sampleCount, pixIdx);
+						if (batch) {
+							path_batch_add(batch, cam_get_ray(cam, x, y, sampler), sampler);
+							continue;
+						}
+						struct color sample = path_trace(cam_get_ray(cam, x, y, sampler), r->scene, &limits, sampler, guide, aov);
+						if (aov) accum_add_aov(&accum, bx, by, aov->albedo, aov->normal);
+						accum_add(&accum, b, bx, by, sample);
+					}
+				}
+			}
+			if (batch) {
+				path_batch_trace(batch, r->scene, &limits, guide);
+				// Same pixel order as they were added in
+				size_t path = 0;
+				for (size_t i = 0; i < accum.blocks_x * accum.blocks_y; ++i) {
+					const struct accum_block *b = &accum.blocks[i];
+					if (!b->active) continue;
+					for (unsigned by = b->begin_y; by < b->end_y; ++by) {
+						for (unsigned bx = b->begin_x; bx < b->end_x; ++bx) {
+							struct color sample = path_batch_result(batch, path++, aov);
+							if (aov) accum_add_aov(&accum, bx, by, aov->albedo, aov->normal);
+							accum_add(&accum, b, bx, by, sample);
+						}
+					}
 				}
 			}
+			taken += accum_pass_done(&accum);
+			if (guide) guide_recorder_commit(guide);
+			if (adaptive) accum_retire_blocks(&accum, r->prefs.noise_threshold, ADAPTIVE_MIN_SAMPLES, max_samples);
+			//Store internal render buffer (float precision)
+			if (aov) accum_flush_aov(&accum, r->state.albedo_buf, r->state.normal_buf, tile->begin.x, tile->begin.y);
+			accum_flush(&accum, *buf, tile->begin.x, tile->begin.y);
 			//For performance metrics
 			total_us += timer_get_us(timer);
 			threadState->totalSamples++;
-			samples++;
-			tile->completed_samples++;
+			// With adaptive sampling, this counts samples spent, averaged over the tile
+			tile->completed_samples = min(taken / pixels, tile->total_samples);
 			//Pause rendering when bool is set
 			while (threadState->paused && !r->state.render_aborted) {
 				timer_sleep_ms(100);
 			}
-			threadState->avg_per_sample_us = total_us / samples;
+			threadState->avg_per_sample_us = total_us / max(tile->completed_samples, 1);
+			if (r->prefs.time_limit_ms) {
+				tile->total_samples = tile_samples_in_budget(r, tile, tile_budget_us, total_us);
+			}
 		}
+		// Converged early, the tile is done as far as progress is concerned
+		if (r->state.rendering) tile->completed_samples = tile->total_samples;
 		//Tile has finished rendering, get a new one and start rendering it.
 		tile->state = finished;
 		threadState->currentTile = NULL;
-		samples = 1;
 		tile = tile_next(threadState->tiles);
 		threadState->currentTile = tile;
 	}
 exit:
-	destroySampler(sampler);
+	node_cache_free(sampler_state.node_cache);
+	accum_free(&accum);
+	path_batch_free(&batch_state);
+	guide_recorder_free(&guide_state);
 	//No more tiles to render, exit thread. (render done)
 	threadState->thread_complete = true;
 	threadState->currentTile = NULL;
@@ -454,9 +662,12 @@ exit:
 struct prefs default_prefs(void) {
 	return (struct prefs){
 			.tileOrder = ro_from_middle,
+			.sampler = SAMPLING_STRATEGY,
 			.threads = sys_get_cores() + 2,
 			.sampleCount = 25,
 			.bounces = 20,
+			.rr_start_depth = 4,
+			.rr_min_probability = 0.05f,
 			.tileWidth = 32,
 			.tileHeight = 32,
 			.imgFilePath = stringCopy("./"),
@@ -465,6 +676,18 @@ struct prefs default_prefs(void) {
 	};
 }
 
+struct path_limits path_limits_from_prefs(const struct prefs *prefs) {
+	return (struct path_limits){
+		.max_bounces = (int)prefs->bounces,
+		.diffuse_bounces = (int)prefs->diffuse_bounces,
+		.glossy_bounces = (int)prefs->glossy_bounces,
+		.transmission_bounces = (int)prefs->transmission_bounces,
+		.rr_start_depth = (int)prefs->rr_start_depth,
+		.rr_min_probability = prefs->rr_min_probability,
+		.indirect_clamp = prefs->indirect_clamp
+	};
+}
+
 struct renderer *renderer_new(void) {
 	struct renderer *r = calloc(1, sizeof(*r));
 	r->prefs = default_prefs();
@@ -488,5 +711,8 @@ void renderer_destroy(struct renderer *r) {
 	free(r->prefs.imgFilePath);
 	if (r->prefs.node_list) free(r->prefs.node_list);
 	if (r->state.result_buf) destroyTexture(r->state.result_buf);
+	destroyTexture(r->state.albedo_buf);
+	destroyTexture(r->state.normal_buf);
+	thread_pool_destroy(r->state.pool);
 	free(r);
 }
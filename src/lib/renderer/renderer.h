@@ -12,7 +12,9 @@
 #include "../datatypes/tile.h"
 #include "../../common/timer.h"
 #include "../../common/platform/thread.h"
+#include "../../common/platform/thread_pool.h"
 #include "../protocol/server.h"
+#include "samplers/sampler.h"
 
 struct worker {
 	struct cr_thread thread;
@@ -53,7 +55,15 @@ struct state {
 	struct callback callbacks[5];
 
 	struct texture *result_buf;
+	// Denoiser inputs, averaged like result_buf. Only allocated when prefs.denoise is set
+	struct texture *albedo_buf;
+	struct texture *normal_buf;
 	struct tile_set *current_set;
+	struct timeval render_timer; // Started before the first callback, for prefs.time_limit_ms and the ETA
+	// Kept alive between renders, so animation batches and interactive restarts don't spawn new threads
+	struct cr_thread_pool *pool;
+	size_t pool_threads;
+	struct path_guide *guide; // Trained during a render if prefs.path_guiding is set
 };
 
 /// Preferences data (Set by user)
@@ -62,7 +72,21 @@ struct prefs {
 	
 	size_t threads; //Amount of threads to render with
 	size_t sampleCount;
+	uint64_t time_limit_ms; // 0 = no limit, otherwise sample counts are adapted to finish in time
+	float noise_threshold; // 0 = off, otherwise max relative error a pixel block can stop sampling at
+	enum samplerType sampler;
+	bool path_guiding; // Learn where light comes from while rendering, and aim diffuse bounces there
+	bool denoise; // Gather albedo and normals while rendering, and filter the result with them once done
 	size_t bounces;
+	// 0 = only bounces applies, otherwise max bounces of each type, counted like in Cycles
+	size_t diffuse_bounces;
+	size_t glossy_bounces;
+	size_t transmission_bounces;
+	size_t rr_start_depth; // Bounce Russian roulette starts on
+	float rr_min_probability; // Lowest survival probability roulette gives a path
+	float indirect_clamp; // 0 = off, otherwise max luminance a single sample of indirect light can add
+	bool median_of_means; // Write out the median of batch means instead of the mean, so single fireflies are left out
+	bool sort_shading; // Experimental, off by default. Trace a tile's paths a bounce at a time, and shade hits grouped by material
 	unsigned tileWidth;
 	unsigned tileHeight;
 	
@@ -75,6 +99,7 @@ struct prefs {
 	size_t imgCount;
 	char *node_list;
 	bool iterative;
+	bool progressive; // Render all tiles one pass at a time, then exit
 	bool blender_mode;
 };
 
@@ -89,4 +114,12 @@ void renderer_render(struct renderer *r);
 void renderer_start_interactive(struct renderer *r);
 void renderer_destroy(struct renderer *r);
 
+// Long-lived pool for render threads and other parallel pre-render work, sized from prefs.threads
+struct cr_thread_pool *renderer_thread_pool(struct renderer *r);
+
+bool renderer_has_time_for_pass(const struct renderer *r, const struct tile_set *set);
+
 struct prefs default_prefs(void); // TODO: Remove
+
+struct path_limits;
+struct path_limits path_limits_from_prefs(const struct prefs *prefs);
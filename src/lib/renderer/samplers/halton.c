@@ -10,22 +10,92 @@
 #include "halton.h"
 
 #include "common.h"
-#include "../../../common/assert.h"
-#include "../../../common/vector.h"
 
-static const unsigned int primes[] = {2, 3, 5, 7, 11, 13};
-static const unsigned int primesCount = 6;
+// Generated: entry i is the digit-reversed i, with each digit passed through the Faure permutation of its base
+const uint16_t halton_table_2[256] = {
+	0, 128, 64, 192, 32, 160, 96, 224, 16, 144, 80, 208, 48, 176, 112, 240,
+	8, 136, 72, 200, 40, 168, 104, 232, 24, 152, 88, 216, 56, 184, 120, 248,
+	4, 132, 68, 196, 36, 164, 100, 228, 20, 148, 84, 212, 52, 180, 116, 244,
+	12, 140, 76, 204, 44, 172, 108, 236, 28, 156, 92, 220, 60, 188, 124, 252,
+	2, 130, 66, 194, 34, 162, 98, 226, 18, 146, 82, 210, 50, 178, 114, 242,
+	10, 138, 74, 202, 42, 170, 106, 234, 26, 154, 90, 218, 58, 186, 122, 250,
+	6, 134, 70, 198, 38, 166, 102, 230, 22, 150, 86, 214, 54, 182, 118, 246,
+	14, 142, 78, 206, 46, 174, 110, 238, 30, 158, 94, 222, 62, 190, 126, 254,
+	1, 129, 65, 193, 33, 161, 97, 225, 17, 145, 81, 209, 49, 177, 113, 241,
+	9, 137, 73, 201, 41, 169, 105, 233, 25, 153, 89, 217, 57, 185, 121, 249,
+	5, 133, 69, 197, 37, 165, 101, 229, 21, 149, 85, 213, 53, 181, 117, 245,
+	13, 141, 77, 205, 45, 173, 109, 237, 29, 157, 93, 221, 61, 189, 125, 253,
+	3, 131, 67, 195, 35, 163, 99, 227, 19, 147, 83, 211, 51, 179, 115, 243,
+	11, 139, 75, 203, 43, 171, 107, 235, 27, 155, 91, 219, 59, 187, 123, 251,
+	7, 135, 71, 199, 39, 167, 103, 231, 23, 151, 87, 215, 55, 183, 119, 247,
+	15, 143, 79, 207, 47, 175, 111, 239, 31, 159, 95, 223, 63, 191, 127, 255
+};
+
+const uint16_t halton_table_3[243] = {
+	0, 81, 162, 27, 108, 189, 54, 135, 216, 9, 90, 171, 36, 117, 198, 63,
+	144, 225, 18, 99, 180, 45, 126, 207, 72, 153, 234, 3, 84, 165, 30, 111,
+	192, 57, 138, 219, 12, 93, 174, 39, 120, 201, 66, 147, 228, 21, 102, 183,
+	48, 129, 210, 75, 156, 237, 6, 87, 168, 33, 114, 195, 60, 141, 222, 15,
+	96, 177, 42, 123, 204, 69, 150, 231, 24, 105, 186, 51, 132, 213, 78, 159,
+	240, 1, 82, 163, 28, 109, 190, 55, 136, 217, 10, 91, 172, 37, 118, 199,
+	64, 145, 226, 19, 100, 181, 46, 127, 208, 73, 154, 235, 4, 85, 166, 31,
+	112, 193, 58, 139, 220, 13, 94, 175, 40, 121, 202, 67, 148, 229, 22, 103,
+	184, 49, 130, 211, 76, 157, 238, 7, 88, 169, 34, 115, 196, 61, 142, 223,
+	16, 97, 178, 43, 124, 205, 70, 151, 232, 25, 106, 187, 52, 133, 214, 79,
+	160, 241, 2, 83, 164, 29, 110, 191, 56, 137, 218, 11, 92, 173, 38, 119,
+	200, 65, 146, 227, 20, 101, 182, 47, 128, 209, 74, 155, 236, 5, 86, 167,
+	32, 113, 194, 59, 140, 221, 14, 95, 176, 41, 122, 203, 68, 149, 230, 23,
+	104, 185, 50, 131, 212, 77, 158, 239, 8, 89, 170, 35, 116, 197, 62, 143,
+	224, 17, 98, 179, 44, 125, 206, 71, 152, 233, 26, 107, 188, 53, 134, 215,
+	80, 161, 242
+};
+
+const uint16_t halton_table_5[125] = {
+	0, 75, 50, 25, 100, 15, 90, 65, 40, 115, 10, 85, 60, 35, 110, 5,
+	80, 55, 30, 105, 20, 95, 70, 45, 120, 3, 78, 53, 28, 103, 18, 93,
+	68, 43, 118, 13, 88, 63, 38, 113, 8, 83, 58, 33, 108, 23, 98, 73,
+	48, 123, 2, 77, 52, 27, 102, 17, 92, 67, 42, 117, 12, 87, 62, 37,
+	112, 7, 82, 57, 32, 107, 22, 97, 72, 47, 122, 1, 76, 51, 26, 101,
+	16, 91, 66, 41, 116, 11, 86, 61, 36, 111, 6, 81, 56, 31, 106, 21,
+	96, 71, 46, 121, 4, 79, 54, 29, 104, 19, 94, 69, 44, 119, 14, 89,
+	64, 39, 114, 9, 84, 59, 34, 109, 24, 99, 74, 49, 124
+};
+
+const uint16_t halton_table_7[49] = {
+	0, 14, 35, 21, 7, 28, 42, 2, 16, 37, 23, 9, 30, 44, 5, 19,
+	40, 26, 12, 33, 47, 3, 17, 38, 24, 10, 31, 45, 1, 15, 36, 22,
+	8, 29, 43, 4, 18, 39, 25, 11, 32, 46, 6, 20, 41, 27, 13, 34,
+	48
+};
+
+const uint16_t halton_table_11[121] = {
+	0, 77, 44, 22, 99, 55, 11, 88, 66, 33, 110, 7, 84, 51, 29, 106,
+	62, 18, 95, 73, 40, 117, 4, 81, 48, 26, 103, 59, 15, 92, 70, 37,
+	114, 2, 79, 46, 24, 101, 57, 13, 90, 68, 35, 112, 9, 86, 53, 31,
+	108, 64, 20, 97, 75, 42, 119, 5, 82, 49, 27, 104, 60, 16, 93, 71,
+	38, 115, 1, 78, 45, 23, 100, 56, 12, 89, 67, 34, 111, 8, 85, 52,
+	30, 107, 63, 19, 96, 74, 41, 118, 6, 83, 50, 28, 105, 61, 17, 94,
+	72, 39, 116, 3, 80, 47, 25, 102, 58, 14, 91, 69, 36, 113, 10, 87,
+	54, 32, 109, 65, 21, 98, 76, 43, 120
+};
+
+const uint16_t halton_table_13[169] = {
+	0, 52, 117, 26, 91, 143, 78, 13, 65, 130, 39, 104, 156, 4, 56, 121,
+	30, 95, 147, 82, 17, 69, 134, 43, 108, 160, 9, 61, 126, 35, 100, 152,
+	87, 22, 74, 139, 48, 113, 165, 2, 54, 119, 28, 93, 145, 80, 15, 67,
+	132, 41, 106, 158, 7, 59, 124, 33, 98, 150, 85, 20, 72, 137, 46, 111,
+	163, 11, 63, 128, 37, 102, 154, 89, 24, 76, 141, 50, 115, 167, 6, 58,
+	123, 32, 97, 149, 84, 19, 71, 136, 45, 110, 162, 1, 53, 118, 27, 92,
+	144, 79, 14, 66, 131, 40, 105, 157, 5, 57, 122, 31, 96, 148, 83, 18,
+	70, 135, 44, 109, 161, 10, 62, 127, 36, 101, 153, 88, 23, 75, 140, 49,
+	114, 166, 3, 55, 120, 29, 94, 146, 81, 16, 68, 133, 42, 107, 159, 8,
+	60, 125, 34, 99, 151, 86, 21, 73, 138, 47, 112, 164, 12, 64, 129, 38,
+	103, 155, 90, 25, 77, 142, 51, 116, 168
+};
 
 void initHalton(haltonSampler *s, int pass, uint32_t seed) {
 	s->rndOffset = uintToUnitReal(seed);
+	s->seed = seed;
 	s->currPass = pass;
 	s->currPrime = 0;
 }
-
-float getHalton(haltonSampler *s) {
-	// Wrapping around trick by @lycium
-	float v = wrapAdd(radicalInverse(s->currPass, primes[s->currPrime++ % primesCount]), s->rndOffset);
-	ASSERT(v >= 0.0f);
-	ASSERT(v < 1.0f);
-	return v;
-}
@@ -8,13 +8,67 @@
 
 #pragma once
 
+#include <stdint.h>
+#include "common.h"
+
 struct haltonSampler {
 	float rndOffset;
+	uint32_t seed;
 	unsigned currPrime;
 	int currPass;
 };
 
 typedef struct haltonSampler haltonSampler;
 
+#define HALTON_DIMENSIONS 6
+
+// Faure-permuted radical inverses of all numbers up to a few digits, one table per prime.
+// Looking up several digits at once replaces most of the divisions in the digit loop,
+// and the permutation breaks up the linear patterns Halton has in the higher bases.
+extern const uint16_t halton_table_2[256];
+extern const uint16_t halton_table_3[243];
+extern const uint16_t halton_table_5[125];
+extern const uint16_t halton_table_7[49];
+extern const uint16_t halton_table_11[121];
+extern const uint16_t halton_table_13[169];
+
+// size is a power of the base, so chunks of the index map to chunks of digits.
+// Kept inline so size is a constant in each caller below, and the division by it turns into a multiply.
+static inline float halton_lookup(const uint16_t *table, uint32_t size, uint32_t n) {
+	const float inv_size = 1.0f / (float)size;
+	float scale = inv_size;
+	float v = 0.0f;
+	while (n) {
+		v += (float)table[n % size] * scale;
+		n /= size;
+		scale *= inv_size;
+	}
+	return min(v, 0.99999994f);
+}
+
+// Radical inverse of n in the base of the given dimension, which must be below HALTON_DIMENSIONS
+static inline float halton_radical_inverse(uint32_t n, unsigned dimension) {
+	switch (dimension) {
+		case 0: return halton_lookup(halton_table_2, 256, n);
+		case 1: return halton_lookup(halton_table_3, 243, n);
+		case 2: return halton_lookup(halton_table_5, 125, n);
+		case 3: return halton_lookup(halton_table_7, 49, n);
+		case 4: return halton_lookup(halton_table_11, 121, n);
+		default: return halton_lookup(halton_table_13, 169, n);
+	}
+}
+
+// Past the prime table, reusing the same bases would give every pass the exact same
+// numbers again, correlating later bounces with earlier ones. Hash instead.
+static inline float halton_hashed(uint32_t seed, int pass, unsigned dimension) {
+	return uintToUnitReal(sampler_hash(seed ^ sampler_hash((uint32_t)pass * 0x9e3779b9u + dimension)));
+}
+
 void initHalton(haltonSampler *s, int pass, uint32_t seed);
-float getHalton(haltonSampler *s);
+
+static inline float getHalton(haltonSampler *s) {
+	const unsigned dimension = s->currPrime++;
+	if (dimension >= HALTON_DIMENSIONS) return halton_hashed(s->seed, s->currPass, dimension);
+	// Wrapping around trick by @lycium
+	return wrapAdd(halton_radical_inverse((uint32_t)s->currPass, dimension), s->rndOffset);
+}
@@ -9,9 +9,13 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+#include "halton.h"
 
 struct hammersleySampler {
 	float rndOffset;
+	uint32_t seed;
 	unsigned currPrime;
 	int currPass;
 	int maxPasses;
@@ -20,4 +24,18 @@ struct hammersleySampler {
 typedef struct hammersleySampler hammersleySampler;
 
 void initHammersley(hammersleySampler *s, int pass, int maxPasses, uint32_t seed);
-float getHammersley(hammersleySampler *s);
+
+// Wrong
+static inline float getHammersley(hammersleySampler *s) {
+	const unsigned dimension = s->currPrime++;
+	// Same as Halton, wrapping around the bases would repeat earlier dimensions
+	if (dimension >= HALTON_DIMENSIONS) return halton_hashed(s->seed, s->currPass, dimension);
+	// Wrapping around trick by Thomas Ludwig (@lycium)
+	float u;
+	if (s->currPass > 0) {
+		u = halton_radical_inverse((uint32_t)s->currPass, dimension);
+	} else {
+		u = s->currPass / s->maxPasses;
+	}
+	return wrapAdd(u, s->rndOffset);
+}
@@ -18,4 +18,12 @@ typedef struct randomSampler randomSampler;
 
 void initRandom(randomSampler *s, uint64_t seed);
 
-float getRandom(randomSampler *s);
+static inline float getRandom(randomSampler *s) {
+	// pcg32_random_r(), inlined
+	const uint64_t oldstate = s->rng.state;
+	s->rng.state = oldstate * 6364136223846793005ULL + s->rng.inc;
+	const uint32_t xorshifted = (uint32_t)(((oldstate >> 18u) ^ oldstate) >> 27u);
+	const uint32_t rot = (uint32_t)(oldstate >> 59u);
+	const uint32_t bits = (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+	return (1.0f / (1ull << 32)) * bits;
+}
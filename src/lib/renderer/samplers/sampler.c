@@ -8,54 +8,36 @@
 
 #include <stdint.h>
 #include <stdlib.h>
-#include "halton.h"
-#include "hammersley.h"
-#include "random.h"
 #include "sampler.h"
 #include "common.h"
 
-struct sampler {
-	enum samplerType type;
-	union {
-		hammersleySampler hammersley;
-		haltonSampler halton;
-		randomSampler random;
-	} sampler;
-};
-
 struct sampler *newSampler() {
 	return calloc(1, sizeof(struct sampler));
 }
 
 void initSampler(sampler *sampler, enum samplerType type, int pass, int maxPasses, uint32_t pixelIndex) {
+	sampler->has_reused = false;
 	switch (type) {
 		case Halton:
-			initHalton(&sampler->sampler.halton, pass, hash(pixelIndex));
+			initHalton(&sampler->sampler.halton, pass, sampler_hash(pixelIndex));
 			sampler->type = Halton;
 			break;
 		case Hammersley:
-			initHammersley(&sampler->sampler.hammersley, pass, maxPasses, hash(pixelIndex));
+			initHammersley(&sampler->sampler.hammersley, pass, maxPasses, sampler_hash(pixelIndex));
 			sampler->type = Hammersley;
 			break;
 		case Random:
-			initRandom(&sampler->sampler.random, hash64(pixelIndex * maxPasses + pass));
+			// Adaptive sampling can go past maxPasses, keep pixels from sharing seeds
+			initRandom(&sampler->sampler.random, sampler_hash64(((uint64_t)pixelIndex << 32) | (uint32_t)pass));
 			sampler->type = Random;
 			break;
+		case Sobol:
+			initSobol(&sampler->sampler.sobol, pass, sampler_hash(pixelIndex));
+			sampler->type = Sobol;
+			break;
 	}
 }
 
-float getDimension(struct sampler *sampler) {
-	switch (sampler->type) {
-		case Hammersley:
-			return getHammersley(&sampler->sampler.hammersley);
-		case Halton:
-			return getHalton(&sampler->sampler.halton);
-		case Random:
-			return getRandom(&sampler->sampler.random);
-	}
-	return 0;
-}
-
 void destroySampler(struct sampler *sampler) {
 	free(sampler);
 }
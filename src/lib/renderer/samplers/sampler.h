@@ -9,20 +9,86 @@
 #pragma once
 
 #include <stdint.h>
-
-struct sampler;
-typedef struct sampler sampler;
+#include <stdbool.h>
+#include "../../../includes.h"
+#include "halton.h"
+#include "hammersley.h"
+#include "random.h"
+#include "sobol.h"
 
 enum samplerType {
 	Halton = 0,
 	Hammersley,
-	Random
+	Random,
+	Sobol
+};
+
+// Samplers are drawn from a few dozen times per path, so the whole thing lives in this header.
+// Render threads keep one on the stack, and getDimension() inlines down to the variant's few instructions.
+// The type doesn't change for the duration of a render, so the switch is always predicted.
+struct sampler {
+	enum samplerType type;
+	union {
+		hammersleySampler hammersley;
+		haltonSampler halton;
+		randomSampler random;
+		sobolSampler sobol;
+	} sampler;
+	float reused; // Returned by the next getDimension() if has_reused is set, see reuseDimension()
+	bool has_reused;
+	struct node_cache *node_cache; // Owned by the render thread, NULL elsewhere. initSampler() leaves it be
 };
 
+typedef struct sampler sampler;
+
+// Heap allocated sampler, for callers that can't keep one around by value
 struct sampler *newSampler(void);
 
 void initSampler(struct sampler *sampler, enum samplerType type, int pass, int maxPasses, uint32_t pixelIndex);
 
-float getDimension(struct sampler *sampler);
+static inline float getDimension(struct sampler *sampler) {
+	if (unlikely(sampler->has_reused)) {
+		sampler->has_reused = false;
+		return sampler->reused;
+	}
+	switch (sampler->type) {
+		case Hammersley:
+			return getHammersley(&sampler->sampler.hammersley);
+		case Halton:
+			return getHalton(&sampler->sampler.halton);
+		case Random:
+			return getRandom(&sampler->sampler.random);
+		case Sobol:
+			return getSobol(&sampler->sampler.sobol);
+	}
+	return 0;
+}
+
+// Jump to a fixed dimension, so a varying amount of earlier draws doesn't shift later ones around.
+// Random ignores this, it has no dimensions to speak of.
+static inline void setDimension(struct sampler *sampler, unsigned dimension) {
+	sampler->has_reused = false;
+	switch (sampler->type) {
+		case Hammersley:
+			sampler->sampler.hammersley.currPrime = dimension;
+			break;
+		case Halton:
+			sampler->sampler.halton.currPrime = dimension;
+			break;
+		case Random:
+			break;
+		case Sobol:
+			sampler->sampler.sobol.dimension = dimension;
+			break;
+	}
+}
+
+// Hand back a number in [0, 1) for the next getDimension() to return, instead of drawing a new dimension.
+// A node that used a number to pick between things remaps it for whatever it picked, so picks don't
+// push the dimensions of the picked node further out, however deeply they nest.
+static inline void reuseDimension(struct sampler *sampler, float value) {
+	sampler->reused = value;
+	sampler->has_reused = true;
+}
 
 void destroySampler(struct sampler *sampler);
@@ -0,0 +1,66 @@
+//
+//  sobol.h
+//  c-ray
+//
+
+#pragma once
+
+#include <stdint.h>
+#include "common.h"
+
+struct sobolSampler {
+	uint32_t seed;
+	uint32_t index;
+	unsigned dimension;
+	unsigned cached_group; // Dimensions come in groups of four, which are computed together
+	uint32_t cache[4];
+};
+
+typedef struct sobolSampler sobolSampler;
+
+void initSobol(sobolSampler *s, int pass, uint32_t seed);
+
+// Joe & Kuo direction numbers for the first four dimensions
+extern const uint32_t sobol_directions[4][32];
+
+// All four dimensions at once. The shuffled index uses all 32 bits, so this is branchless.
+static inline void sobol4(uint32_t index, uint32_t out[4]) {
+	out[0] = out[1] = out[2] = out[3] = 0;
+	for (unsigned bit = 0; bit < 32; ++bit) {
+		const uint32_t mask = 0u - ((index >> bit) & 1u);
+		out[0] ^= sobol_directions[0][bit] & mask;
+		out[1] ^= sobol_directions[1][bit] & mask;
+		out[2] ^= sobol_directions[2][bit] & mask;
+		out[3] ^= sobol_directions[3][bit] & mask;
+	}
+}
+
+static inline uint32_t sobol_reverse_bits(uint32_t x) {
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+	x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+// Hash that only lets bits affect bits above them, applied to the reversed value
+static inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+	x = sobol_reverse_bits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return sobol_reverse_bits(x);
+}
+
+static inline float getSobol(sobolSampler *s) {
+	const unsigned dimension = s->dimension++;
+	const unsigned group = dimension / 4;
+	if (group != s->cached_group) {
+		sobol4(nested_uniform_scramble(s->index, sampler_hash(s->seed ^ sampler_hash(group))), s->cache);
+		s->cached_group = group;
+	}
+	const uint32_t x = nested_uniform_scramble(s->cache[dimension % 4], sampler_hash(s->seed + dimension));
+	return (float)(x >> 8) * (1.0f / (float)(1u << 24));
+}
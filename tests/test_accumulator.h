@@ -0,0 +1,134 @@
+//
+//  test_accumulator.h
+//  c-ray
+//
+
+#pragma once
+
+#include "../src/lib/renderer/accumulator.h"
+#include "../src/common/texture.h"
+
+bool accumulator_retire(void) {
+	struct tile_accum a = { 0 };
+	// 16x8 tile, a flat left block and a noisy right block
+	accum_reset(&a, 16, 8, true, false, false);
+	test_assert(a.blocks_x == 2 && a.blocks_y == 1);
+	for (size_t pass = 0; pass < 32; ++pass) {
+		for (unsigned y = 0; y < 8; ++y) {
+			for (unsigned x = 0; x < 16; ++x) {
+				const struct accum_block *b = &a.blocks[x / ACCUM_BLOCK_SIZE];
+				if (!b->active) continue;
+				const float v = x < 8 ? 0.5f : (float)((pass + x + y) % 2);
+				accum_add(&a, b, x, y, (struct color){ v, v, v, 1.0f });
+			}
+		}
+		accum_pass_done(&a);
+		accum_retire_blocks(&a, 0.01f, 4, 64);
+	}
+	test_assert(!a.blocks[0].active);
+	test_assert(a.blocks[0].samples == 4);
+	test_assert(a.blocks[1].active);
+	test_assert(a.blocks[1].samples == 32);
+	test_assert(a.active_blocks == 1);
+
+	// Blocks keep their own sample counts, so averages still come out right
+	struct texture *t = newTexture(float_p, 16, 8, 3);
+	accum_flush(&a, t, 0, 0);
+	roughly_equals(t->data.float_p[0], 0.5f);
+	roughly_equals(t->data.float_p[8 * 3], 0.5f);
+
+	// Only blocks that got samples since the last flush are written again
+	t->data.float_p[0] = 2.0f;
+	t->data.float_p[8 * 3] = 2.0f;
+	accum_add(&a, &a.blocks[1], 8, 0, (struct color){ 0.5f, 0.5f, 0.5f, 1.0f });
+	accum_pass_done(&a);
+	accum_flush(&a, t, 0, 0);
+	roughly_equals(t->data.float_p[0], 2.0f);
+	test_assert(t->data.float_p[8 * 3] != 2.0f);
+	destroyTexture(t);
+	accum_free(&a);
+	return true;
+}
+
+bool accumulator_max_samples(void) {
+	struct tile_accum a = { 0 };
+	accum_reset(&a, 8, 8, true, false, false);
+	size_t passes = 0;
+	while (a.active_blocks) {
+		for (unsigned y = 0; y < 8; ++y) {
+			for (unsigned x = 0; x < 8; ++x) {
+				const float v = (float)((passes + x) % 2);
+				accum_add(&a, &a.blocks[0], x, y, (struct color){ v, v, v, 1.0f });
+			}
+		}
+		accum_pass_done(&a);
+		accum_retire_blocks(&a, 0.001f, 4, 16);
+		passes++;
+	}
+	test_assert(passes == 16);
+	accum_free(&a);
+	return true;
+}
+
+bool accumulator_median_of_means(void) {
+	struct tile_accum a = { 0 };
+	accum_reset(&a, 8, 8, false, true, false);
+	for (size_t pass = 0; pass < 20; ++pass) {
+		for (unsigned y = 0; y < 8; ++y) {
+			for (unsigned x = 0; x < 8; ++x) {
+				// One firefly in the first pixel
+				const float v = !x && !y && pass == 7 ? 1000.0f : 0.5f;
+				accum_add(&a, &a.blocks[0], x, y, (struct color){ v, v, v, 1.0f });
+			}
+		}
+		accum_pass_done(&a);
+	}
+	struct texture *t = newTexture(float_p, 8, 8, 4);
+	accum_flush(&a, t, 0, 0);
+	const struct color firefly = textureGetPixel(t, 0, 0, false);
+	roughly_equals(firefly.red, 0.5f);
+	roughly_equals(firefly.alpha, 1.0f);
+	roughly_equals(textureGetPixel(t, 3, 5, false).green, 0.5f);
+
+	// Below ACCUM_MOM_BATCHES samples it's a plain mean
+	accum_reset(&a, 8, 8, false, true, false);
+	accum_add(&a, &a.blocks[0], 0, 0, (struct color){ 1.0f, 1.0f, 1.0f, 1.0f });
+	accum_pass_done(&a);
+	accum_add(&a, &a.blocks[0], 0, 0, (struct color){ 0.0f, 0.0f, 0.0f, 1.0f });
+	accum_pass_done(&a);
+	accum_flush(&a, t, 0, 0);
+	roughly_equals(textureGetPixel(t, 0, 0, false).red, 0.5f);
+	destroyTexture(t);
+	accum_free(&a);
+	return true;
+}
+
+bool accumulator_aov(void) {
+	struct tile_accum a = { 0 };
+	accum_reset(&a, 4, 4, false, false, true);
+	const struct vector up = { 0.0f, 1.0f, 0.0f };
+	const struct vector right = { 1.0f, 0.0f, 0.0f };
+	for (size_t pass = 0; pass < 4; ++pass) {
+		const float v = pass % 2 ? 1.0f : 0.0f;
+		accum_add(&a, &a.blocks[0], 1, 2, (struct color){ v, v, v, 1.0f });
+		accum_add_aov(&a, 1, 2, (struct color){ v, 0.5f, 0.0f, 1.0f }, pass < 2 ? up : right);
+		accum_pass_done(&a);
+	}
+	// Tile at (2, 1) in a bigger frame
+	struct texture *albedo = newTexture(float_p, 8, 8, 3);
+	struct texture *normal = newTexture(float_p, 8, 8, 3);
+	accum_flush_aov(&a, albedo, normal, 2, 1);
+	const struct color c = textureGetPixel(albedo, 3, 3, false);
+	roughly_equals(c.red, 0.5f);
+	roughly_equals(c.green, 0.5f);
+	roughly_equals(c.blue, 0.0f);
+	const struct color n = textureGetPixel(normal, 3, 3, false);
+	roughly_equals(n.red, 0.5f);
+	roughly_equals(n.green, 0.5f);
+	roughly_equals(n.blue, 0.0f);
+	roughly_equals(textureGetPixel(albedo, 2, 1, false).green, 0.0f);
+	destroyTexture(albedo);
+	destroyTexture(normal);
+	accum_free(&a);
+	return true;
+}
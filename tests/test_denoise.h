@@ -0,0 +1,56 @@
+//
+//  test_denoise.h
+//  c-ray
+//
+
+#pragma once
+
+#include "../src/lib/renderer/denoise.h"
+#include "../src/common/texture.h"
+#include "../src/common/platform/thread_pool.h"
+
+#define DENOISE_TEST_SIZE 64
+
+// Left half faces up and is dark, right half faces sideways and is bright. Both have noise on top.
+static void denoise_test_scene(struct texture *color, struct texture *albedo, struct texture *normal) {
+	uint32_t state = 1234;
+	for (size_t y = 0; y < DENOISE_TEST_SIZE; ++y) {
+		for (size_t x = 0; x < DENOISE_TEST_SIZE; ++x) {
+			const bool left = x < DENOISE_TEST_SIZE / 2;
+			state = state * 1664525u + 1013904223u;
+			const float noise = ((float)(state >> 8) / (float)(1u << 24) - 0.5f) * 0.2f;
+			const float base = left ? 0.2f : 0.8f;
+			setPixel(color, (struct color){ base + noise, base + noise, base + noise, 1.0f }, x, y);
+			setPixel(albedo, (struct color){ 0.5f, 0.5f, 0.5f, 1.0f }, x, y);
+			setPixel(normal, left ? (struct color){ 0.0f, 1.0f, 0.0f, 1.0f } : (struct color){ 1.0f, 0.0f, 0.0f, 1.0f }, x, y);
+		}
+	}
+}
+
+bool denoise_smooths_and_keeps_edges(void) {
+	struct texture *color = newTexture(float_p, DENOISE_TEST_SIZE, DENOISE_TEST_SIZE, 4);
+	struct texture *albedo = newTexture(float_p, DENOISE_TEST_SIZE, DENOISE_TEST_SIZE, 3);
+	struct texture *normal = newTexture(float_p, DENOISE_TEST_SIZE, DENOISE_TEST_SIZE, 3);
+	denoise_test_scene(color, albedo, normal);
+	struct cr_thread_pool *pool = thread_pool_create(2);
+	denoise(pool, color, albedo, normal);
+	thread_pool_destroy(pool);
+
+	float max_error = 0.0f;
+	for (size_t y = 0; y < DENOISE_TEST_SIZE; ++y) {
+		for (size_t x = 0; x < DENOISE_TEST_SIZE; ++x) {
+			const float expected = x < DENOISE_TEST_SIZE / 2 ? 0.2f : 0.8f;
+			const struct color c = textureGetPixel(color, x, y, false);
+			max_error = max(max_error, fabsf(c.red - expected));
+			// Alpha isn't touched
+			test_assert(c.alpha == 1.0f);
+		}
+	}
+	// Noise was up to 0.1 either way, and nothing bled over the edge
+	test_assert(max_error < 0.04f);
+
+	destroyTexture(color);
+	destroyTexture(albedo);
+	destroyTexture(normal);
+	return true;
+}
@@ -0,0 +1,79 @@
+//
+//  test_guiding.h
+//  c-ray
+//
+
+#pragma once
+
+#include "../src/lib/renderer/guiding.h"
+
+static struct path_guide *test_guide(void) {
+	return guide_new((struct boundingBox){ .min = { 0.0f, 0.0f, 0.0f }, .max = { 1.0f, 1.0f, 1.0f } });
+}
+
+bool guiding_learns(void) {
+	struct path_guide *guide = test_guide();
+	struct guide_recorder rec;
+	guide_recorder_init(&rec, guide);
+	const struct vector p = { 0.5f, 0.5f, 0.5f };
+	test_assert(!guide_lookup(&rec, p));
+
+	// All light comes from straight up
+	const struct vector up = { 0.0f, 1.0f, 0.0f };
+	const struct vector side = { 1.0f, 0.0f, 0.0f };
+	for (size_t i = 0; i < 8192; ++i) {
+		guide_record(&rec, p, up, 1.0f, 1.0f);
+		guide_record(&rec, p, side, 0.0f, 1.0f);
+	}
+	guide_recorder_commit(&rec);
+	const struct guide_cell *cell = guide_lookup(&rec, p);
+	test_assert(cell);
+	test_assert(guide_pdf(cell, up) > 100.0f * guide_pdf(cell, side));
+	// Other cells haven't seen anything
+	test_assert(!guide_lookup(&rec, (struct vector){ 0.0f, 0.0f, 0.0f }));
+
+	guide_recorder_free(&rec);
+	guide_destroy(guide);
+	return true;
+}
+
+bool guiding_sample_pdf(void) {
+	struct path_guide *guide = test_guide();
+	struct guide_recorder rec;
+	guide_recorder_init(&rec, guide);
+	const struct vector p = { 0.5f, 0.5f, 0.5f };
+	for (size_t i = 0; i < 8192; ++i) {
+		const float phi = 2.0f * PI * (float)(i % 64) / 64.0f;
+		const struct vector dir = { cosf(phi) * 0.6f, 0.8f, sinf(phi) * 0.6f };
+		guide_record(&rec, p, dir, 1.0f + cosf(phi), 1.0f);
+	}
+	guide_recorder_commit(&rec);
+	const struct guide_cell *cell = guide_lookup(&rec, p);
+	test_assert(cell);
+
+	// Sampled directions report the same pdf guide_pdf() does
+	for (size_t i = 0; i < 256; ++i) {
+		float pdf;
+		const struct vector dir = guide_sample_dir(cell, ((float)i + 0.5f) / 256.0f, 0.3f, 0.7f, &pdf);
+		very_roughly_equals(vec_length(dir), 1.0f);
+		test_assert(pdf > 0.0f);
+		roughly_equals(pdf, guide_pdf(cell, dir));
+	}
+
+	// And the pdf integrates to one over the sphere. The grid lines up with the bins, so this is exact.
+	const size_t n = 64;
+	float integral = 0.0f;
+	for (size_t y = 0; y < n; ++y) {
+		const float cos_theta = 1.0f - 2.0f * ((float)y + 0.5f) / (float)n;
+		const float sin_theta = sqrtf(1.0f - cos_theta * cos_theta);
+		for (size_t x = 0; x < n; ++x) {
+			const float phi = 2.0f * PI * ((float)x + 0.5f) / (float)n;
+			integral += guide_pdf(cell, (struct vector){ sin_theta * cosf(phi), cos_theta, sin_theta * sinf(phi) });
+		}
+	}
+	very_roughly_equals(integral * 4.0f * PI / (float)(n * n), 1.0f);
+
+	guide_recorder_free(&rec);
+	guide_destroy(guide);
+	return true;
+}
@@ -0,0 +1,69 @@
+//
+//  test_light_bvh.h
+//  c-ray
+//
+
+#pragma once
+
+#include "../src/lib/accelerators/light_bvh.h"
+
+static struct light_bounds test_light(float x, float y, float z, float power) {
+	return (struct light_bounds){
+		.min = { x - 0.5f, y, z - 0.5f },
+		.max = { x + 0.5f, y, z + 0.5f },
+		.axis = { 0.0f, 1.0f, 0.0f },
+		.theta_o = 0.0f,
+		.power = power
+	};
+}
+
+bool light_bvh_pmf_sum(void) {
+	struct light_bounds lights[7];
+	for (size_t i = 0; i < 7; ++i) lights[i] = test_light((float)i * 3.0f, 5.0f, (float)(i % 3), 1.0f + (float)i);
+	struct light_bvh *bvh = build_light_bvh(lights, 7);
+	test_assert(bvh);
+	const struct vector p = { 1.0f, 0.0f, 0.0f };
+	float sum = 0.0f;
+	for (size_t i = 0; i < 7; ++i) sum += light_bvh_pmf(bvh, p, i);
+	roughly_equals(sum, 1.0f);
+
+	// Sampling has to agree with the pmf
+	for (size_t i = 0; i < 64; ++i) {
+		size_t light;
+		float pmf;
+		test_assert(light_bvh_sample(bvh, p, ((float)i + 0.5f) / 64.0f, &light, &pmf));
+		test_assert(light < 7);
+		roughly_equals(pmf, light_bvh_pmf(bvh, p, light));
+	}
+	destroy_light_bvh(bvh);
+	return true;
+}
+
+bool light_bvh_nearby(void) {
+	// Two equal lights far apart, the one next to the shading point should be picked far more often
+	struct light_bounds lights[2] = { test_light(0.0f, 1.0f, 0.0f, 1.0f), test_light(100.0f, 1.0f, 0.0f, 1.0f) };
+	struct light_bvh *bvh = build_light_bvh(lights, 2);
+	const struct vector p = { 0.0f, 0.0f, 0.0f };
+	test_assert(light_bvh_pmf(bvh, p, 0) > 0.99f);
+	// Both sides of a light are lit
+	const struct vector below = { 100.0f, -1.0f, 0.0f };
+	test_assert(light_bvh_pmf(bvh, below, 1) > 0.99f);
+	destroy_light_bvh(bvh);
+	return true;
+}
+
+bool light_bvh_edge_on(void) {
+	// A light seen exactly edge-on from far away can't contribute, but shouldn't stop the other one from being picked
+	struct light_bounds lights[2] = { test_light(0.0f, 0.0f, 0.0f, 1.0f), test_light(0.0f, 5.0f, 0.0f, 1.0f) };
+	lights[1].axis = (struct vector){ 1.0f, 0.0f, 0.0f };
+	struct light_bvh *bvh = build_light_bvh(lights, 2);
+	const struct vector p = { 1e8f, 0.0f, 0.0f };
+	size_t light;
+	float pmf;
+	test_assert(light_bvh_sample(bvh, p, 0.5f, &light, &pmf));
+	test_assert(light == 1);
+	roughly_equals(pmf, 1.0f);
+	roughly_equals(light_bvh_pmf(bvh, p, 0), 0.0f);
+	destroy_light_bvh(bvh);
+	return true;
+}
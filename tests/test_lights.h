@@ -0,0 +1,82 @@
+//
+//  test_lights.h
+//  c-ray
+//
+
+#pragma once
+
+#include <float.h>
+#include "../include/c-ray/c-ray.h"
+#include "../src/lib/datatypes/scene.h"
+#include "../src/lib/datatypes/mesh.h"
+#include "../src/lib/accelerators/bvh.h"
+#include "../src/lib/renderer/lights.h"
+#include "../src/lib/renderer/instance.h"
+#include "../src/lib/renderer/samplers/sampler.h"
+
+// Same as in pathtrace.c
+static float test_power_heuristic(float pdf_a, float pdf_b) {
+	return (pdf_a * pdf_a) / (pdf_a * pdf_a + pdf_b * pdf_b);
+}
+
+bool lights_mis_smooth_mesh(void) {
+	struct cr_renderer *ext = cr_new_renderer();
+	struct cr_scene *s_ext = cr_renderer_scene_get(ext);
+	struct world *scene = (struct world *)s_ext;
+
+	// An emissive triangle above the origin, with vertex normals tilted well away from the face normal
+	struct cr_vector vertices[] = { { -1.0f, 1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f }, { 0.0f, 1.0f, 1.0f } };
+	struct cr_vector normal = { 0.6f, -0.8f, 0.0f };
+	cr_vertex_buf vbuf = cr_scene_vertex_buf_new(s_ext, (struct cr_vertex_buf_param){
+		.vertices = vertices, .vertex_count = 3, .normals = &normal, .normal_count = 1 });
+	cr_mesh mesh = cr_scene_mesh_new(s_ext, "light");
+	cr_mesh_bind_vertex_buf(s_ext, mesh, vbuf);
+	struct cr_face face = { .vertex_idx = { 0, 1, 2 }, .normal_idx = { 0, 0, 0 }, .has_normals = true };
+	cr_mesh_bind_faces(s_ext, mesh, &face, 1);
+
+	struct cr_color_node white = { .type = cr_cn_constant, .arg.constant = { 1.0f, 1.0f, 1.0f, 1.0f } };
+	struct cr_value_node strength = { .type = cr_vn_constant, .arg.constant = 4.0 };
+	struct cr_shader_node emission = { .type = cr_bsdf_emissive, .arg.emissive = { .color = &white, .strength = &strength } };
+	cr_material_set set = cr_scene_new_material_set(s_ext);
+	cr_material_set_add(s_ext, set, &emission);
+	cr_instance inst = cr_instance_new(s_ext, mesh, cr_object_mesh);
+	test_assert(cr_instance_bind_material_set(s_ext, inst, set));
+
+	// Same setup as renderer_render() does
+	struct instance *instance = &scene->instances.items[inst];
+	instance->bbuf = &scene->shader_buffers.items[instance->bbuf_idx];
+	struct mesh *m = &scene->meshes.items[mesh];
+	m->vbuf = &scene->v_buffers.items[m->vbuf_idx];
+	m->bvh = build_mesh_bvh(m);
+	scene->topLevel = build_top_level_bvh(scene->instances);
+	lights_build(&scene->lights, scene);
+	test_assert(scene->lights.lights.count == 1);
+
+	sampler *sampler = newSampler();
+	const struct vector origin = { 0.3f, 0.0f, 0.1f };
+	// Any BSDF pdf will do, the weights have to add up to one regardless
+	const float pdf_scatter = 0.25f;
+	for (int i = 0; i < 16; ++i) {
+		initSampler(sampler, Halton, i, 16, 0);
+		struct light_sample ls;
+		test_assert(lights_sample(&scene->lights, scene, sampler, origin, &ls));
+		const float pdf_light = lights_pdf_solid_angle(ls.pdf_area, origin, &ls.record);
+
+		// BSDF sampling finds the same point by tracing a ray towards it
+		struct lightRay ray = { .start = origin, .direction = vec_normalize(vec_sub(ls.record.hitPoint, origin)) };
+		struct hit hit = { .instIndex = -1, .distance = FLT_MAX };
+		test_assert(traverse_top_level_bvh(scene->instances.items, scene->topLevel, &ray, &hit, sampler));
+		struct hitRecord isect = { .incident = &ray, .polygon = hit.polygon, .distance = hit.distance, .instIndex = hit.instIndex };
+		instance->getShadingFn(instance, &ray, &hit, &isect);
+		// Shading normal really is off the face normal here
+		test_assert(fabsf(vec_dot(isect.surfaceNormal, isect.geometricNormal)) < 0.9f);
+		const float pdf_bsdf_light = lights_pdf_solid_angle(lights_pdf_area(&scene->lights, origin, &isect), origin, &isect);
+
+		very_roughly_equals(pdf_bsdf_light / pdf_light, 1.0f);
+		very_roughly_equals(test_power_heuristic(pdf_light, pdf_scatter) + test_power_heuristic(pdf_scatter, pdf_bsdf_light), 1.0f);
+	}
+
+	destroySampler(sampler);
+	cr_destroy_renderer(ext);
+	return true;
+}
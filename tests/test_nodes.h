@@ -16,7 +16,12 @@
 #include "../src/lib/nodes/vectornode.h"
 #include "../src/lib/nodes/converter/math.h"
 #include "../src/lib/nodes/converter/map_range.h"
+#include "../src/lib/nodes/colornode.h"
+#include "../src/lib/nodes/program.h"
+#include "../src/lib/nodes/cache.h"
+#include "../src/lib/nodes/textures/alpha.h"
 #include "../src/lib/renderer/samplers/sampler.h"
+#include "../src/lib/renderer/envmap.h"
 
 struct node_storage *make_storage() {
 	struct node_storage *storage = calloc(1, sizeof(*storage));
@@ -919,3 +924,603 @@ bool map_range(void) {
 	destroySampler(sampler);
 	return true;
 }
+
+bool bsdfnode_eval_pdf(void) {
+	struct node_storage *s = make_storage();
+	struct sampler *sampler = newSampler();
+	struct lightRay incident = { .start = { 0.0f, 1.0f, 0.0f }, .direction = { 0.0f, -1.0f, 0.0f } };
+	const struct hitRecord record = { .incident = &incident, .surfaceNormal = { 0.0f, 1.0f, 0.0f } };
+	const struct colorNode *color = newConstantTexture(s, (struct color){ 0.5f, 0.25f, 0.125f, 1.0f });
+	const struct bsdfNode *diffuse = newDiffuse(s, color);
+	const struct bsdfNode *mix = newMix(s, diffuse, newMetal(s, color, NULL), newConstantValue(s, 0.25f));
+	test_assert(mix->eval && mix->pdf);
+
+	for (int i = 0; i < 64; ++i) {
+		initSampler(sampler, Halton, i, 64, 128);
+		struct bsdfSample sample = diffuse->sample(diffuse, sampler, &record);
+		const float pdf = diffuse->pdf(diffuse, sampler, &record, sample.out.direction);
+		roughly_equals(sample.pdf, pdf);
+		if (pdf < 0.01f) continue;
+		// Cosine weighted sampling, so eval / pdf gives back the sample weight
+		const struct color f = diffuse->eval(diffuse, sampler, &record, sample.out.direction);
+		very_roughly_equals(f.red / pdf, sample.weight.red);
+		very_roughly_equals(f.blue / pdf, sample.weight.blue);
+
+		// Singular metal samples have no pdf, diffuse ones report the pdf of the whole mix
+		sample = mix->sample(mix, sampler, &record);
+		if (sample.pdf > 0.0f) roughly_equals(sample.pdf, mix->pdf(mix, sampler, &record, sample.out.direction));
+	}
+	// Below the surface
+	test_assert(diffuse->pdf(diffuse, sampler, &record, (struct vector){ 0.0f, -1.0f, 0.0f }) == 0.0f);
+
+	delete_storage(s);
+	destroySampler(sampler);
+	return true;
+}
+
+bool bsdfnode_microfacet(void) {
+	struct node_storage *s = make_storage();
+	struct sampler *sampler = newSampler();
+	struct lightRay incident = { .start = { -1.0f, 1.0f, 0.0f }, .direction = vec_normalize((struct vector){ 1.0f, -1.0f, 0.2f }) };
+	const struct hitRecord record = {
+		.incident = &incident,
+		.surfaceNormal = { 0.0f, 1.0f, 0.0f },
+		.tangent = { 1.0f, 0.0f, 0.0f },
+		.bitangent = { 0.0f, 0.0f, -1.0f },
+	};
+	const struct colorNode *white = newConstantTexture(s, g_white_color);
+	const struct valueNode *roughness = newConstantValue(s, 0.5f);
+	// Mirrors can only be sampled
+	test_assert(!newMetal(s, white, NULL)->eval);
+	test_assert(!newGlass(s, white, NULL, NULL)->eval);
+
+	const struct bsdfNode *bsdfs[] = { newMetal(s, white, roughness), newGlass(s, white, roughness, NULL), newPlastic(s, white, roughness, NULL) };
+	for (size_t b = 0; b < sizeof(bsdfs) / sizeof(bsdfs[0]); ++b) {
+		const struct bsdfNode *bsdf = bsdfs[b];
+		test_assert(bsdf->eval && bsdf->pdf);
+		float weight_sum = 0.0f;
+		const int samples = 256;
+		for (int i = 0; i < samples; ++i) {
+			initSampler(sampler, Halton, i, samples, 128);
+			const struct bsdfSample sample = bsdf->sample(bsdf, sampler, &record);
+			weight_sum += sample.weight.red;
+			if (sample.pdf <= 0.0f) continue;
+			const float pdf = bsdf->pdf(bsdf, sampler, &record, sample.out.direction);
+			test_assert(fabsf(sample.pdf - pdf) <= 1e-3f * pdf);
+			// The plastic lobes are weighted separately, metal and glass sample their whole BSDF
+			if (b == 2) continue;
+			const struct color f = bsdf->eval(bsdf, sampler, &record, sample.out.direction);
+			test_assert(fabsf(f.red / pdf - sample.weight.red) <= 1e-2f * sample.weight.red);
+		}
+		// White, so only masking loses energy, and not much of it at this roughness
+		const float average = weight_sum / samples;
+		test_assert(average <= 1.0f && average > 0.85f);
+	}
+
+	delete_storage(s);
+	destroySampler(sampler);
+	return true;
+}
+
+bool bsdfnode_mix_dimensions(void) {
+	struct node_storage *s = make_storage();
+	struct sampler *sampler = newSampler();
+	struct lightRay incident = { .start = { 0.0f, 1.0f, 0.0f }, .direction = { 0.0f, -1.0f, 0.0f } };
+	const struct hitRecord record = { .incident = &incident, .surfaceNormal = { 0.0f, 1.0f, 0.0f } };
+	const struct bsdfNode *red = newDiffuse(s, newConstantTexture(s, (struct color){ 1.0f, 0.0f, 0.0f, 1.0f }));
+	const struct bsdfNode *green = newDiffuse(s, newConstantTexture(s, (struct color){ 0.0f, 1.0f, 0.0f, 1.0f }));
+	const struct bsdfNode *blue = newDiffuse(s, newConstantTexture(s, (struct color){ 0.0f, 0.0f, 1.0f, 1.0f }));
+	const struct bsdfNode *nested = newMix(s, newMix(s, red, green, newConstantValue(s, 0.3f)), blue, newConstantValue(s, 0.6f));
+
+	struct color sum = g_black_color;
+	const int samples = 256;
+	for (int i = 0; i < samples; ++i) {
+		// However deep the mix, the picked BSDF uses the numbers it would use on its own
+		initSampler(sampler, Halton, i, samples, 7);
+		setDimension(sampler, 0);
+		red->sample(red, sampler, &record);
+		const float after_diffuse = getDimension(sampler);
+
+		initSampler(sampler, Halton, i, samples, 7);
+		setDimension(sampler, 0);
+		const struct bsdfSample sample = nested->sample(nested, sampler, &record);
+		test_assert(getDimension(sampler) == after_diffuse);
+		sum = colorAdd(sum, sample.weight);
+	}
+	// The picks still follow the mix factors
+	very_roughly_equals(sum.red / samples, 0.4f * 0.7f);
+	very_roughly_equals(sum.green / samples, 0.4f * 0.3f);
+	very_roughly_equals(sum.blue / samples, 0.6f);
+
+	delete_storage(s);
+	destroySampler(sampler);
+	return true;
+}
+
+bool bsdfnode_add_emission(void) {
+	struct node_storage *s = make_storage();
+	struct sampler *sampler = newSampler();
+	struct lightRay incident = { .start = { 0.0f, 1.0f, 0.0f }, .direction = { 0.0f, -1.0f, 0.0f } };
+	const struct hitRecord record = { .incident = &incident, .surfaceNormal = { 0.0f, 1.0f, 0.0f } };
+	const struct color orange = { 1.0f, 0.5f, 0.0f, 1.0f };
+	const struct bsdfNode *light = newEmission(s, newConstantTexture(s, orange), newConstantValue(s, 2.0f));
+	const struct bsdfNode *diffuse = newDiffuse(s, newConstantTexture(s, g_white_color));
+
+	// lights.c counts an add with an emissive side as a light, so hitting it has to show that emission too
+	const struct bsdfNode *lit_a = newAdd(s, light, diffuse);
+	const struct bsdfNode *lit_b = newAdd(s, diffuse, light);
+	initSampler(sampler, Halton, 0, 1, 0);
+	const struct bsdfSample a = lit_a->sample(lit_a, sampler, &record);
+	roughly_equals(a.emitted.red, 2.0f);
+	roughly_equals(a.emitted.green, 1.0f);
+	initSampler(sampler, Halton, 0, 1, 0);
+	const struct bsdfSample b = lit_b->sample(lit_b, sampler, &record);
+	roughly_equals(b.emitted.red, 2.0f);
+
+	delete_storage(s);
+	destroySampler(sampler);
+	return true;
+}
+
+bool alpha_mask(void) {
+	struct node_storage *s = make_storage();
+	const struct coord uv = { 0.5f, 0.5f };
+	struct lightRay ray = { .start = { 0.0f, 1.0f, 0.0f }, .direction = { 0.0f, -1.0f, 0.0f } };
+	test_assert(alpha_mask_test(newConstantValue(s, 1.0f), uv, &ray, 0));
+	test_assert(!alpha_mask_test(newConstantValue(s, 0.0f), uv, &ray, 0));
+
+	// Partial coverage lets through the right share of rays, and the same ray always gets the same answer
+	const struct valueNode *half = newConstantValue(s, 0.25f);
+	int solid = 0;
+	const int rays = 16384;
+	for (int i = 0; i < rays; ++i) {
+		ray.start.x = (float)i / rays;
+		const bool hit = alpha_mask_test(half, uv, &ray, 7);
+		test_assert(hit == alpha_mask_test(half, uv, &ray, 7));
+		if (hit) solid++;
+	}
+	very_roughly_equals((float)solid / rays, 0.25f);
+
+	delete_storage(s);
+	return true;
+}
+
+bool envmap_sample_pdf(void) {
+	struct node_storage *s = make_storage();
+	struct sampler *sampler = newSampler();
+	const struct colorNode *sky = newGradientTexture(s, (struct color){ 0.1f, 0.1f, 0.1f, 1.0f }, (struct color){ 4.0f, 4.0f, 4.0f, 1.0f });
+	const struct bsdfNode *background = newBackground(s, sky, NULL, NULL, false);
+	struct env_map env = { 0 };
+	env_map_build(&env, background);
+	test_assert(env_map_active(&env));
+
+	size_t up = 0;
+	for (int i = 0; i < 256; ++i) {
+		initSampler(sampler, Random, i, 256, 0);
+		struct vector dir;
+		float pdf;
+		test_assert(env_map_sample(&env, sampler, &dir, &pdf));
+		very_roughly_equals(pdf, env_map_pdf(&env, dir));
+		if (dir.y > 0.0f) up++;
+	}
+	test_assert(up > 160);
+
+	// The pdf integrates to one over the sphere
+	float sum = 0.0f;
+	const int count = 4096;
+	for (int i = 0; i < count; ++i) {
+		initSampler(sampler, Random, i, count, 1);
+		const float z = 1.0f - 2.0f * getDimension(sampler);
+		const float r = sqrtf(max(0.0f, 1.0f - z * z));
+		const float phi = 2.0f * PI * getDimension(sampler);
+		sum += env_map_pdf(&env, (struct vector){ r * cosf(phi), z, r * sinf(phi) }) * 4.0f * PI;
+	}
+	test_assert(fabsf(sum / (float)count - 1.0f) < 0.05f);
+
+	env_map_free(&env);
+	delete_storage(s);
+	destroySampler(sampler);
+	return true;
+}
+
+bool envmap_wanted(void) {
+	// Only image backgrounds get importance sampled
+	struct cr_color_node sky = { .type = cr_cn_constant, .arg.constant = { 0.5f, 0.6f, 1.0f, 1.0f } };
+	struct cr_color_node hdr = { .type = cr_cn_image, .arg.image = { .full_path = "sky.hdr" } };
+	struct cr_shader_node background = { .type = cr_bsdf_background, .arg.background = { .color = &sky } };
+	test_assert(!env_map_wanted(NULL));
+	test_assert(!env_map_wanted(&background));
+	background.arg.background.color = &hdr;
+	test_assert(env_map_wanted(&background));
+	struct cr_color_node tinted = { .type = cr_cn_color_mix, .arg.color_mix = { .a = &sky, .b = &hdr } };
+	background.arg.background.color = &tinted;
+	test_assert(env_map_wanted(&background));
+	return true;
+}
+
+static struct cr_scene *program_test_scene(struct world *scene) {
+	*scene = (struct world){ 0 };
+	scene->storage.node_pool = newBlock(NULL, 1024);
+	scene->storage.node_table = newHashtable(compareNodes, &scene->storage.node_pool);
+	return (struct cr_scene *)scene;
+}
+
+bool program_compile(void) {
+	struct world scene;
+	struct cr_scene *s_ext = program_test_scene(&scene);
+	struct sampler *sampler = newSampler();
+
+	// Constant subtrees fold down to one constant node
+	struct cr_value_node one = { .type = cr_vn_constant, .arg.constant = 1.0 };
+	struct cr_value_node two = { .type = cr_vn_constant, .arg.constant = 2.0 };
+	struct cr_value_node sum = { .type = cr_vn_math, .arg.math = { .A = &one, .B = &two, .op = Add } };
+	const struct valueNode *folded = build_value_node(s_ext, &sum);
+	test_assert(folded->constant);
+	test_assert(folded->eval(folded, sampler, NULL) == 3.0f);
+
+	// (u + 1 + 2) * 2, the constant part is still folded
+	struct cr_vector_node uv = { .type = cr_vec_uv };
+	struct cr_value_node u = { .type = cr_vn_vec_to_value, .arg.vec_to_value = { .comp = U, .vec = &uv } };
+	struct cr_value_node shifted = { .type = cr_vn_math, .arg.math = { .A = &u, .B = &sum, .op = Add } };
+	struct cr_value_node scaled = { .type = cr_vn_math, .arg.math = { .A = &shifted, .B = &two, .op = Multiply } };
+	const struct valueNode *program = build_value_node(s_ext, &scaled);
+	test_assert(!program->constant);
+	const struct hitRecord record = { .uv = { 0.25f, 0.75f } };
+	test_assert(program->eval(program, sampler, &record) == 6.5f);
+	// Same program, same node
+	test_assert(build_value_node(s_ext, &scaled) == program);
+
+	// Mixes pick the same inputs off the same random numbers as the node they replace
+	struct cr_color_node red = { .type = cr_cn_constant, .arg.constant = { 1.0f, 0.0f, 0.0f, 1.0f } };
+	struct cr_color_node blue = { .type = cr_cn_constant, .arg.constant = { 0.0f, 0.0f, 1.0f, 1.0f } };
+	struct cr_value_node v = { .type = cr_vn_vec_to_value, .arg.vec_to_value = { .comp = V, .vec = &uv } };
+	struct cr_color_node mix = { .type = cr_cn_color_mix, .arg.color_mix = { .a = &red, .b = &blue, .factor = &v } };
+	const struct colorNode *compiled = build_color_node(s_ext, &mix);
+	const struct colorNode *reference = new_color_mix(&scene.storage,
+		newConstantTexture(&scene.storage, (struct color){ 1.0f, 0.0f, 0.0f, 1.0f }),
+		newConstantTexture(&scene.storage, (struct color){ 0.0f, 0.0f, 1.0f, 1.0f }),
+		newVecToValue(&scene.storage, newUV(&scene.storage), V));
+	size_t picked_blue = 0;
+	for (int i = 0; i < 64; ++i) {
+		initSampler(sampler, Halton, i, 64, 7);
+		const struct color a = compiled->eval(compiled, sampler, &record);
+		initSampler(sampler, Halton, i, 64, 7);
+		const struct color b = reference->eval(reference, sampler, &record);
+		test_assert(a.red == b.red && a.blue == b.blue);
+		if (a.blue == 1.0f) picked_blue++;
+	}
+	test_assert(picked_blue > 32);
+
+	destroySampler(sampler);
+	destroyHashtable(scene.storage.node_table);
+	destroyBlocks(scene.storage.node_pool);
+	return true;
+}
+
+bool program_fold(void) {
+	struct world scene;
+	struct cr_scene *s_ext = program_test_scene(&scene);
+	const struct node_storage *s = &scene.storage;
+	const struct color red = { 1.0f, 0.0f, 0.0f, 1.0f };
+	const struct color blue = { 0.0f, 0.0f, 1.0f, 1.0f };
+	struct cr_color_node red_desc = { .type = cr_cn_constant, .arg.constant = { 1.0f, 0.0f, 0.0f, 1.0f } };
+	struct cr_color_node blue_desc = { .type = cr_cn_constant, .arg.constant = { 0.0f, 0.0f, 1.0f, 1.0f } };
+
+	// Blackbody and HSV transform nodes with constant inputs become the color they'd always return
+	struct cr_value_node kelvin = { .type = cr_vn_constant, .arg.constant = 2000.0 };
+	struct cr_color_node blackbody = { .type = cr_cn_blackbody, .arg.blackbody.degrees = &kelvin };
+	test_assert(build_color_node(s_ext, &blackbody) == newConstantTexture(s, colorForKelvin(2000.0f)));
+	struct cr_value_node half = { .type = cr_vn_constant, .arg.constant = 0.5 };
+	struct cr_color_node tform = { .type = cr_cn_hsv_tform, .arg.hsv_tform = { .tex = &red_desc, .H = &half } };
+	const struct colorNode *folded = build_color_node(s_ext, &tform);
+	const struct colorNode *reference = newHSVTransform(s, newConstantTexture(s, red), NULL, NULL, NULL, NULL);
+	const struct color expected = reference->eval(reference, NULL, NULL);
+	test_assert(folded == newConstantTexture(s, expected));
+
+	// Mixes with a factor of 0 or 1 are just one of their inputs
+	struct cr_value_node one = { .type = cr_vn_constant, .arg.constant = 1.0 };
+	struct cr_value_node zero = { .type = cr_vn_constant, .arg.constant = 0.0 };
+	struct cr_color_node mix = { .type = cr_cn_color_mix, .arg.color_mix = { .a = &red_desc, .b = &blue_desc, .factor = &one } };
+	test_assert(build_color_node(s_ext, &mix) == newConstantTexture(s, blue));
+	mix.arg.color_mix.factor = &zero;
+	test_assert(build_color_node(s_ext, &mix) == newConstantTexture(s, red));
+
+	// So are mixes of two identical inputs, and the factor isn't evaluated at all
+	struct cr_vector_node uv = { .type = cr_vec_uv };
+	struct cr_vector_node normal = { .type = cr_vec_normal };
+	struct cr_value_node u = { .type = cr_vn_vec_to_value, .arg.vec_to_value = { .comp = U, .vec = &uv } };
+	struct cr_value_node v = { .type = cr_vn_vec_to_value, .arg.vec_to_value = { .comp = V, .vec = &uv } };
+	struct cr_color_node uv_color = { .type = cr_cn_rgb, .arg.rgb = { .red = &u, .green = &v } };
+	struct cr_color_node uv_color_copy = uv_color;
+	struct cr_value_node noisy = { .type = cr_vn_vec_to_value, .arg.vec_to_value = { .comp = Y, .vec = &normal } };
+	mix = (struct cr_color_node){ .type = cr_cn_color_mix, .arg.color_mix = { .a = &uv_color, .b = &uv_color_copy, .factor = &noisy } };
+	test_assert(build_color_node(s_ext, &mix) == build_color_node(s_ext, &uv_color));
+	// Different inputs still mix
+	struct cr_color_node vu_color = { .type = cr_cn_rgb, .arg.rgb = { .red = &v, .green = &u } };
+	mix.arg.color_mix.b = &vu_color;
+	test_assert(build_color_node(s_ext, &mix) != build_color_node(s_ext, &uv_color));
+
+	// Folding goes by the nodes the inputs built into, so deep chains don't compile their inputs over and over
+	struct cr_color_node chain[40];
+	for (size_t i = 0; i < 40; ++i) {
+		chain[i] = (struct cr_color_node){ .type = cr_cn_hsv_tform, .arg.hsv_tform = { .tex = i ? &chain[i - 1] : &red_desc, .H = &half } };
+	}
+	test_assert(build_color_node(s_ext, &chain[39])->constant);
+	chain[0].arg.hsv_tform.tex = &uv_color;
+	test_assert(!build_color_node(s_ext, &chain[39])->constant);
+
+	// Same goes for BSDF mixes
+	struct cr_shader_node diffuse = { .type = cr_bsdf_diffuse, .arg.diffuse.color = &red_desc };
+	struct cr_shader_node metal = { .type = cr_bsdf_metal, .arg.metal.color = &blue_desc };
+	struct cr_shader_node bsdf_mix = { .type = cr_bsdf_mix, .arg.mix = { .A = &diffuse, .B = &metal, .factor = &zero } };
+	test_assert(build_bsdf_node(s_ext, &bsdf_mix) == build_bsdf_node(s_ext, &diffuse));
+	bsdf_mix.arg.mix.factor = &one;
+	test_assert(build_bsdf_node(s_ext, &bsdf_mix) == build_bsdf_node(s_ext, &metal));
+	bsdf_mix.arg.mix.factor = &half;
+	const struct bsdfNode *both = build_bsdf_node(s_ext, &bsdf_mix);
+	test_assert(both != build_bsdf_node(s_ext, &diffuse) && both != build_bsdf_node(s_ext, &metal));
+
+	destroyHashtable(scene.storage.node_table);
+	destroyBlocks(scene.storage.node_pool);
+	return true;
+}
+
+bool color_ramp_lut(void) {
+	struct world scene;
+	program_test_scene(&scene);
+	const struct node_storage *s = &scene.storage;
+	struct ramp_element elements[] = {
+		{ .color = { 1.0f, 0.0f, 0.0f, 1.0f }, .position = 0.25f },
+		{ .color = { 0.0f, 0.0f, 1.0f, 1.0f }, .position = 0.75f },
+	};
+
+	// Ends clamp to the first and last control point, and the middle interpolates between them
+	const struct colorNode *ramp = new_color_ramp(s, newConstantValue(s, -1.0f), cr_mode_rgb, cr_linear, elements, 2);
+	test_assert(colorEquals(ramp->eval(ramp, NULL, NULL), (struct color){ 1.0f, 0.0f, 0.0f, 1.0f }));
+	ramp = new_color_ramp(s, newConstantValue(s, 2.0f), cr_mode_rgb, cr_linear, elements, 2);
+	test_assert(colorEquals(ramp->eval(ramp, NULL, NULL), (struct color){ 0.0f, 0.0f, 1.0f, 1.0f }));
+	ramp = new_color_ramp(s, newConstantValue(s, 0.5f), cr_mode_rgb, cr_linear, elements, 2);
+	struct color result = ramp->eval(ramp, NULL, NULL);
+	very_roughly_equals(result.red, 0.5f);
+	very_roughly_equals(result.blue, 0.5f);
+	ramp = new_color_ramp(s, newConstantValue(s, 0.4f), cr_mode_rgb, cr_constant, elements, 2);
+	test_assert(colorEquals(ramp->eval(ramp, NULL, NULL), (struct color){ 1.0f, 0.0f, 0.0f, 1.0f }));
+
+	// Blackbody follows colorForKelvin() between table entries, and clamps at the ends
+	const float temperatures[] = { -100.0f, 1234.5f, 5432.1f, 6650.0f, 39999.0f, 80000.0f };
+	for (size_t i = 0; i < sizeof(temperatures) / sizeof(temperatures[0]); ++i) {
+		const struct colorNode *blackbody = newBlackbody(s, newConstantValue(s, temperatures[i]));
+		result = blackbody->eval(blackbody, NULL, NULL);
+		const struct color expected = colorForKelvin(temperatures[i] < 0.0f ? 0.0f : temperatures[i]);
+		very_roughly_equals(result.red, expected.red);
+		very_roughly_equals(result.green, expected.green);
+		very_roughly_equals(result.blue, expected.blue);
+	}
+
+	destroyHashtable(scene.storage.node_table);
+	destroyBlocks(scene.storage.node_pool);
+	return true;
+}
+
+static struct color ramp_at(const struct node_storage *s, enum cr_interpolation interpolation, struct ramp_element *elements, int count, float pos) {
+	const struct colorNode *ramp = new_color_ramp(s, newConstantValue(s, pos), cr_mode_rgb, interpolation, elements, count);
+	return ramp->eval(ramp, NULL, NULL);
+}
+
+bool color_ramp_stops(void) {
+	struct world scene;
+	program_test_scene(&scene);
+	const struct node_storage *s = &scene.storage;
+	const struct color red = { 1.0f, 0.0f, 0.0f, 1.0f };
+	const struct color green = { 0.0f, 1.0f, 0.0f, 1.0f };
+	const struct color blue = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+	// Constant ramps switch exactly at the stop, not at the table cell around it
+	struct ramp_element steps[] = {
+		{ .color = { 1.0f, 0.0f, 0.0f, 1.0f }, .position = 0.0f },
+		{ .color = { 0.0f, 1.0f, 0.0f, 1.0f }, .position = 0.5f },
+		{ .color = { 0.0f, 0.0f, 1.0f, 1.0f }, .position = 0.7f },
+	};
+	test_assert(colorEquals(ramp_at(s, cr_constant, steps, 3, 0.4999f), red));
+	test_assert(colorEquals(ramp_at(s, cr_constant, steps, 3, 0.5f), green));
+	test_assert(colorEquals(ramp_at(s, cr_constant, steps, 3, 0.5001f), green));
+	test_assert(colorEquals(ramp_at(s, cr_constant, steps, 3, 0.6999f), green));
+	test_assert(colorEquals(ramp_at(s, cr_constant, steps, 3, 0.7f), blue));
+	// Linear ones hit the stop color exactly at the stop
+	const struct color at_stop = ramp_at(s, cr_linear, steps, 3, 0.5f);
+	roughly_equals(at_stop.red, 0.0f);
+	roughly_equals(at_stop.green, 1.0f);
+
+	// Coincident stops make a hard edge in linear mode, with nothing smeared over the cell around it
+	struct ramp_element edge[] = {
+		{ .color = { 1.0f, 0.0f, 0.0f, 1.0f }, .position = 0.0f },
+		{ .color = { 1.0f, 0.0f, 0.0f, 1.0f }, .position = 0.3f },
+		{ .color = { 0.0f, 0.0f, 1.0f, 1.0f }, .position = 0.3f },
+		{ .color = { 0.0f, 0.0f, 1.0f, 1.0f }, .position = 1.0f },
+	};
+	test_assert(colorEquals(ramp_at(s, cr_linear, edge, 4, 0.2999f), red));
+	test_assert(colorEquals(ramp_at(s, cr_linear, edge, 4, 0.3f), blue));
+	test_assert(colorEquals(ramp_at(s, cr_linear, edge, 4, 0.3001f), blue));
+
+	// Positions outside [0,1] clamp, and stops don't have to come in order
+	struct ramp_element unordered[] = {
+		{ .color = { 0.0f, 0.0f, 1.0f, 1.0f }, .position = 1.5f },
+		{ .color = { 1.0f, 0.0f, 0.0f, 1.0f }, .position = -0.5f },
+		{ .color = { 0.0f, 1.0f, 0.0f, 1.0f }, .position = 0.5f },
+	};
+	test_assert(colorEquals(ramp_at(s, cr_constant, unordered, 3, -1.0f), red));
+	test_assert(colorEquals(ramp_at(s, cr_constant, unordered, 3, 0.25f), red));
+	test_assert(colorEquals(ramp_at(s, cr_constant, unordered, 3, 0.75f), green));
+	test_assert(colorEquals(ramp_at(s, cr_constant, unordered, 3, 1.0f), blue));
+	test_assert(colorEquals(ramp_at(s, cr_linear, unordered, 3, 2.0f), blue));
+	const struct color quarter = ramp_at(s, cr_linear, unordered, 3, 0.25f);
+	roughly_equals(quarter.red, 0.5f);
+	roughly_equals(quarter.green, 0.5f);
+
+	// A single stop is the whole ramp
+	test_assert(colorEquals(ramp_at(s, cr_linear, steps + 1, 1, 0.1f), green));
+
+	destroyHashtable(scene.storage.node_table);
+	destroyBlocks(scene.storage.node_pool);
+	return true;
+}
+
+static int g_cache_test_evals = 0;
+
+static struct color cache_test_eval(const struct colorNode *node, sampler *sampler, const struct hitRecord *record) {
+	(void)node;
+	(void)sampler;
+	g_cache_test_evals++;
+	return (struct color){ record ? record->uv.x : 0.0f, record ? record->uv.y : 0.0f, 0.0f, 1.0f };
+}
+
+static bool cache_test_compare(const void *A, const void *B) {
+	return A == B;
+}
+
+bool cache_node(void) {
+	struct world scene;
+	struct cr_scene *s_ext = program_test_scene(&scene);
+	const struct colorNode counter = { .eval = cache_test_eval, .base = { .compare = cache_test_compare } };
+	g_cache_test_evals = 0;
+
+	// Render threads only allocate a node_cache for scenes that have cache nodes
+	test_assert(!scene.has_cache_nodes);
+	const struct colorNode *cache = new_color_cache(s_ext, &counter, 4);
+	test_assert(scene.has_cache_nodes);
+	test_assert(cache != &counter);
+	test_assert(new_color_cache(s_ext, &counter, 4) == cache);
+	test_assert(new_color_cache(s_ext, &counter, 8) != cache);
+
+	// Hits in the same UV cell of the same primitive get the first result
+	struct sampler thread_a = { .node_cache = node_cache_new() };
+	struct hitRecord record = { .uv = { 0.1f, 0.1f }, .has_uv = true, .instIndex = 0 };
+	struct color first = cache->eval(cache, &thread_a, &record);
+	test_assert(g_cache_test_evals == 1);
+	record.uv = (struct coord){ 0.2f, 0.2f };
+	test_assert(colorEquals(cache->eval(cache, &thread_a, &record), first));
+	test_assert(g_cache_test_evals == 1);
+
+	// Other cells, instances and primitives are evaluated again
+	record.uv = (struct coord){ 0.3f, 0.1f };
+	test_assert(cache->eval(cache, &thread_a, &record).red == 0.3f);
+	test_assert(g_cache_test_evals == 2);
+	record.instIndex = 1;
+	cache->eval(cache, &thread_a, &record);
+	test_assert(g_cache_test_evals == 3);
+	struct poly polygon = { 0 };
+	record.polygon = &polygon;
+	cache->eval(cache, &thread_a, &record);
+	test_assert(g_cache_test_evals == 4);
+	cache->eval(cache, &thread_a, &record);
+	test_assert(g_cache_test_evals == 4);
+
+	// Every render thread has its own results, and samplers without a cache don't cache
+	struct sampler thread_b = { .node_cache = node_cache_new() };
+	cache->eval(cache, &thread_b, &record);
+	test_assert(g_cache_test_evals == 5);
+	cache->eval(cache, &thread_a, &record);
+	test_assert(g_cache_test_evals == 5);
+	cache->eval(cache, &(struct sampler){ 0 }, &record);
+	cache->eval(cache, NULL, &record);
+	test_assert(g_cache_test_evals == 7);
+
+	// Hits without UVs, and evals without a hit at all, go straight to the input. (0, 0) is a valid UV,
+	// so it's the flag that counts.
+	record.uv = (struct coord){ 0.0f, 0.0f };
+	record.has_uv = false;
+	cache->eval(cache, &thread_a, &record);
+	cache->eval(cache, &thread_a, &record);
+	test_assert(g_cache_test_evals == 9);
+	cache->eval(cache, &thread_a, NULL);
+	test_assert(g_cache_test_evals == 10);
+	node_cache_free(thread_a.node_cache);
+	node_cache_free(thread_b.node_cache);
+
+	// Constant values don't need a cache
+	const struct valueNode *constant = newConstantValue(&scene.storage, 1.0f);
+	test_assert(new_value_cache(s_ext, constant, 0) == constant);
+
+	destroyHashtable(scene.storage.node_table);
+	destroyBlocks(scene.storage.node_pool);
+	return true;
+}
+
+bool image_srgb_mips(void) {
+	struct world scene;
+	struct cr_scene *s_ext = program_test_scene(&scene);
+	scene.asset_path = "input/";
+	struct cr_color_node linear = { .type = cr_cn_image, .arg.image = { .full_path = "shapes/grid.png" } };
+	struct cr_color_node srgb = { .type = cr_cn_image, .arg.image = { .full_path = "shapes/grid.png", .options = SRGB_TRANSFORM } };
+	test_assert(build_color_node(s_ext, &linear));
+	test_assert(build_color_node(s_ext, &srgb));
+	test_assert(build_color_node(s_ext, &srgb));
+
+	// The first node's flag doesn't decide the mips for everyone, each flag gets a texture of its own
+	test_assert(scene.textures.count == 2);
+	const struct texture *a = scene.textures.items[0].t;
+	const struct texture *b = scene.textures.items[1].t;
+	test_assert(a != b);
+	test_assert(!scene.textures.items[0].srgb && scene.textures.items[1].srgb);
+	test_assert(a->mip_count && a->mip_count == b->mip_count);
+	const struct texture *last_a = &a->mips[a->mip_count - 1];
+	const struct texture *last_b = &b->mips[b->mip_count - 1];
+	// Averaging a grid of lines in linear comes out brighter once encoded than averaging the encoded values
+	test_assert(last_b->data.byte_p[0] > last_a->data.byte_p[0]);
+
+	for (size_t i = 0; i < scene.textures.count; ++i) {
+		free(scene.textures.items[i].path);
+		destroyTexture(scene.textures.items[i].t);
+	}
+	texture_asset_arr_free(&scene.textures);
+	destroyHashtable(scene.storage.node_table);
+	destroyBlocks(scene.storage.node_pool);
+	return true;
+}
+
+bool alpha_cutout_procedural(void) {
+	struct world scene;
+	struct cr_scene *s_ext = program_test_scene(&scene);
+	scene.asset_path = "input/";
+	struct bsdf_buffer buf = { 0 };
+	struct cr_color_node white = { .type = cr_cn_constant, .arg.constant = { 1.0f, 1.0f, 1.0f, 1.0f } };
+	struct cr_color_node black = { .type = cr_cn_constant, .arg.constant = { 0.0f, 0.0f, 0.0f, 1.0f } };
+	struct cr_vector_node uv = { .type = cr_vec_uv };
+	struct cr_value_node u = { .type = cr_vn_vec_to_value, .arg.vec_to_value = { .comp = U, .vec = &uv } };
+	struct cr_color_node ramp = { .type = cr_cn_color_mix, .arg.color_mix = { .a = &white, .b = &black, .factor = &u } };
+	struct cr_value_node alpha = { .type = cr_vn_alpha, .arg.alpha = { .color = &ramp } };
+	struct cr_shader_node clear = { .type = cr_bsdf_transparent };
+	struct cr_shader_node diffuse = { .type = cr_bsdf_diffuse, .arg.diffuse = { .color = &white } };
+	struct cr_shader_node mix = { .type = cr_bsdf_mix, .arg.mix = { .A = &clear, .B = &diffuse, .factor = &alpha } };
+
+	// A procedural factor may draw from the sampler, which traversal doesn't have, so it stays a regular mix
+	bsdf_buffer_add(s_ext, &buf, &mix);
+	test_assert(!buf.masks.items[0]);
+	test_assert(!buf.has_masks);
+	test_assert(buf.bsdfs.items[0] == build_bsdf_node(s_ext, &mix));
+	struct sampler *sampler = newSampler();
+	initSampler(sampler, Halton, 0, 1, 0);
+	struct lightRay incident = { .start = { 0.0f, 1.0f, 0.0f }, .direction = { 0.0f, -1.0f, 0.0f } };
+	const struct hitRecord record = { .incident = &incident, .surfaceNormal = { 0.0f, 1.0f, 0.0f }, .uv = { 0.25f, 0.5f }, .has_uv = true };
+	buf.bsdfs.items[0]->sample(buf.bsdfs.items[0], sampler, &record);
+
+	// Image alpha only needs the uv, so that one is tested during traversal
+	struct cr_color_node image = { .type = cr_cn_image, .arg.image = { .full_path = "shapes/grid.png" } };
+	alpha.arg.alpha.color = &image;
+	bsdf_buffer_add(s_ext, &buf, &mix);
+	test_assert(buf.masks.items[1]);
+	test_assert(buf.bsdfs.items[1] == build_bsdf_node(s_ext, &diffuse));
+
+	destroySampler(sampler);
+	bsdf_node_ptr_arr_free(&buf.bsdfs);
+	value_node_ptr_arr_free(&buf.masks);
+	cr_shader_node_ptr_arr_free(&buf.descriptions);
+	for (size_t i = 0; i < scene.textures.count; ++i) {
+		free(scene.textures.items[i].path);
+		destroyTexture(scene.textures.items[i].t);
+	}
+	texture_asset_arr_free(&scene.textures);
+	destroyHashtable(scene.storage.node_table);
+	destroyBlocks(scene.storage.node_pool);
+	return true;
+}
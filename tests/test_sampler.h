@@ -4,7 +4,7 @@
 
 #pragma once
 
-#include "../src/renderer/samplers/sampler.h"
+#include "../src/lib/renderer/samplers/sampler.h"
 
 bool test_halton(void) {
 	struct sampler *sampler = newSampler();
@@ -39,4 +39,93 @@ bool test_pseudorandom(void) {
 		test_assert(first_run[i] == second_run[i]);
 	}
 	return true;
-}
\ No newline at end of file
+}
+
+// Mean absolute error of estimating the area under x + y < 1 (0.5) with
+// sample_count samples from dimensions (dimension, dimension + 1), over many pixels.
+static float integration_error(enum samplerType type, unsigned dimension, int sample_count) {
+	struct sampler *sampler = newSampler();
+	float error = 0.0f;
+	const uint32_t pixels = 256;
+	for (uint32_t pixel = 0; pixel < pixels; ++pixel) {
+		int inside = 0;
+		for (int pass = 0; pass < sample_count; ++pass) {
+			initSampler(sampler, type, pass, sample_count, pixel);
+			setDimension(sampler, dimension);
+			const float x = getDimension(sampler);
+			const float y = getDimension(sampler);
+			if (x + y < 1.0f) inside++;
+		}
+		error += fabsf((float)inside / (float)sample_count - 0.5f);
+	}
+	destroySampler(sampler);
+	return error / (float)pixels;
+}
+
+bool sampler_sobol(void) {
+	struct sampler *sampler = newSampler();
+	// Same sequence twice, and in range
+	for (int pass = 0; pass < RUNS; ++pass) {
+		initSampler(sampler, Sobol, pass, RUNS, 42);
+		setDimension(sampler, 7);
+		const float a = getDimension(sampler);
+		initSampler(sampler, Sobol, pass, RUNS, 42);
+		setDimension(sampler, 7);
+		test_assert(a == getDimension(sampler));
+		test_assert(a >= 0.0f && a < 1.0f);
+	}
+	// The first two dimensions of every padded group of four form a (0, 2)-sequence,
+	// so the first 4 points of a pixel land in 4 different quadrants
+	for (unsigned dim = 0; dim < 16; dim += 4) {
+		unsigned quadrants = 0;
+		for (int pass = 0; pass < 4; ++pass) {
+			initSampler(sampler, Sobol, pass, 4, 7);
+			setDimension(sampler, dim);
+			const unsigned x = getDimension(sampler) < 0.5f;
+			const unsigned y = getDimension(sampler) < 0.5f;
+			quadrants |= 1u << (x * 2 + y);
+		}
+		test_assert(quadrants == 0xF);
+	}
+	destroySampler(sampler);
+	return true;
+}
+
+bool sampler_halton_deep(void) {
+	// Paths start every bounce at a fixed dimension, well past the prime table.
+	// Those must not hand out the same numbers as the first bounce, or as any
+	// other dimension that lands on the same prime.
+	struct sampler *sampler = newSampler();
+	const enum samplerType types[] = { Halton, Hammersley };
+	for (size_t t = 0; t < sizeof(types) / sizeof(*types); ++t) {
+		for (int pass = 0; pass < RUNS; ++pass) {
+			for (unsigned dim = 0; dim < 2 * HALTON_DIMENSIONS; ++dim) {
+				initSampler(sampler, types[t], pass, RUNS, 3);
+				setDimension(sampler, dim);
+				const float shallow = getDimension(sampler);
+				setDimension(sampler, dim + HALTON_DIMENSIONS);
+				const float deep = getDimension(sampler);
+				test_assert(shallow != deep);
+				test_assert(deep >= 0.0f && deep < 1.0f);
+			}
+		}
+	}
+	destroySampler(sampler);
+	return true;
+}
+
+bool sampler_error_per_sample(void) {
+	// Early dimensions, where Halton still has its own primes
+	const float sobol_early = integration_error(Sobol, 0, 64);
+	const float halton_early = integration_error(Halton, 0, 64);
+	const float random_early = integration_error(Random, 0, 64);
+	// Deep in a path
+	const float sobol_deep = integration_error(Sobol, 36, 64);
+	const float halton_deep = integration_error(Halton, 36, 64);
+	logr(debug, "64 spp mean error, dimensions 0-1: sobol %.4f halton %.4f random %.4f\n", (double)sobol_early, (double)halton_early, (double)random_early);
+	logr(debug, "64 spp mean error, dimensions 36-37: sobol %.4f halton %.4f\n", (double)sobol_deep, (double)halton_deep);
+	test_assert(sobol_early < random_early);
+	test_assert(sobol_early < halton_early * 1.25f);
+	test_assert(sobol_deep < halton_deep);
+	return true;
+}
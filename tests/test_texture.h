@@ -0,0 +1,38 @@
+//
+//  test_texture.h
+//  c-ray
+//
+
+#pragma once
+
+#include "../src/common/texture.h"
+
+bool texture_mips(void) {
+	// 4x2 checker, every 2x2 block averages out to half gray
+	struct texture *t = newTexture(float_p, 4, 2, 3);
+	for (size_t y = 0; y < 2; ++y) {
+		for (size_t x = 0; x < 4; ++x) {
+			setPixel(t, (x + y) % 2 ? g_white_color : g_black_color, x, y);
+		}
+	}
+	texture_build_mips(t, false);
+	test_assert(t->mip_count == 2);
+	test_assert(t->mips[0].width == 2 && t->mips[0].height == 1);
+	test_assert(t->mips[1].width == 1 && t->mips[1].height == 1);
+
+	// Level 0 lookups match the plain ones
+	const struct color plain = textureGetPixel(t, 0.3f, 0.6f, true);
+	const struct color lod0 = textureGetPixelLOD(t, 0.3f, 0.6f, 0.0f, true, NULL);
+	roughly_equals(plain.red, lod0.red);
+	const struct color nearest = textureGetPixelLOD(t, 0.3f, 0.6f, 0.0f, false, NULL);
+	roughly_equals(nearest.red, textureGetPixel(t, 0.3f * 4, 0.6f * 2, false).red);
+
+	// Past the first level, the checker is gone
+	for (float lod = 1.0f; lod <= 3.0f; lod += 0.5f) {
+		const struct color c = textureGetPixelLOD(t, 0.3f, 0.6f, lod, true, NULL);
+		roughly_equals(c.red, 0.5f);
+		roughly_equals(textureGetPixelLOD(t, 0.8f, 0.1f, lod, false, NULL).green, 0.5f);
+	}
+	destroyTexture(t);
+	return true;
+}
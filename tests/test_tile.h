@@ -0,0 +1,60 @@
+//
+//  test_tile.h
+//  c-ray
+//
+
+#pragma once
+
+#include "../src/lib/datatypes/tile.h"
+
+// tile_quantize() logs, keep that out of the test output. silence_stdout() is in test_serializer.h
+static struct tile_set quiet_quantize(unsigned width, unsigned height, enum render_order order) {
+	int bak, new;
+	silence_stdout(&bak, &new);
+	struct tile_set set = tile_quantize(width, height, 16, 16, order);
+	resume_stdout(&bak, &new);
+	return set;
+}
+
+static bool tiles_cover_grid(const struct tile_set *set, unsigned tiles_x, unsigned tiles_y) {
+	if (set->tiles.count != tiles_x * tiles_y) return false;
+	bool *seen = calloc(set->tiles.count, sizeof(*seen));
+	bool ok = true;
+	for (size_t i = 0; i < set->tiles.count; ++i) {
+		size_t idx = (set->tiles.items[i].begin.y / 16) * tiles_x + set->tiles.items[i].begin.x / 16;
+		if (seen[idx]) ok = false;
+		seen[idx] = true;
+	}
+	free(seen);
+	return ok;
+}
+
+bool tile_hilbert(void) {
+	struct tile_set set = quiet_quantize(128, 128, ro_hilbert);
+	test_assert(tiles_cover_grid(&set, 8, 8));
+	// On a power of two grid, every step along the curve moves to an adjacent tile
+	for (size_t i = 1; i < set.tiles.count; ++i) {
+		const struct render_tile *a = &set.tiles.items[i - 1];
+		const struct render_tile *b = &set.tiles.items[i];
+		test_assert(abs(a->begin.x - b->begin.x) + abs(a->begin.y - b->begin.y) == 16);
+	}
+	tile_set_free(&set);
+
+	// Non-square grids still get every tile exactly once
+	set = quiet_quantize(200, 72, ro_hilbert);
+	test_assert(tiles_cover_grid(&set, 13, 5));
+	tile_set_free(&set);
+	return true;
+}
+
+bool tile_morton(void) {
+	struct tile_set set = quiet_quantize(64, 64, ro_morton);
+	test_assert(tiles_cover_grid(&set, 4, 4));
+	// First four tiles form the top-left 2x2 block
+	for (size_t i = 0; i < 4; ++i) {
+		test_assert(set.tiles.items[i].begin.x < 32);
+		test_assert(set.tiles.items[i].begin.y < 32);
+	}
+	tile_set_free(&set);
+	return true;
+}
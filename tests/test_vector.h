@@ -12,6 +12,7 @@
 #include "../src/common/transforms.h"
 #include "../src/lib/renderer/samplers/sampler.h"
 #include "../src/lib/renderer/samplers/vec.h"
+#include "../src/lib/datatypes/hitrecord.h"
 
 #define ATTEMPTS 1024
 
@@ -198,3 +199,26 @@ bool vector_reflect(void) {
 	roughly_equals(dot, 0.0f);
 	return true;
 }
+
+bool vector_tangent_frame(void) {
+	struct hitRecord record = {
+		.surfaceNormal = vec_normalize((struct vector){ 0.0f, 1.0f, 1.0f }),
+		.dpdu = (struct vector){ 2.0f, 0.5f, 0.0f }
+	};
+	hitrecord_tangent_frame(&record);
+	roughly_equals(vec_length(record.tangent), 1.0f);
+	roughly_equals(vec_length(record.bitangent), 1.0f);
+	roughly_equals(vec_dot(record.tangent, record.surfaceNormal), 0.0f);
+	roughly_equals(vec_dot(record.bitangent, record.surfaceNormal), 0.0f);
+	roughly_equals(vec_dot(record.tangent, record.bitangent), 0.0f);
+	// Tangent should lean towards dpdu
+	test_assert(vec_dot(record.tangent, record.dpdu) > 0.0f);
+
+	// dpdu along the normal leaves nothing to follow, but the frame should still be valid
+	record.dpdu = record.surfaceNormal;
+	hitrecord_tangent_frame(&record);
+	roughly_equals(vec_length(record.tangent), 1.0f);
+	roughly_equals(vec_dot(record.tangent, record.surfaceNormal), 0.0f);
+	roughly_equals(vec_dot(record.bitangent, record.surfaceNormal), 0.0f);
+	return true;
+}
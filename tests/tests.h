@@ -51,6 +51,14 @@ static char *failed_expression;
 #include "test_dyn_array.h"
 #include "test_serializer.h"
 #include "test_thread_pool.h"
+#include "test_tile.h"
+#include "test_accumulator.h"
+#include "test_light_bvh.h"
+#include "test_lights.h"
+#include "test_guiding.h"
+#include "test_denoise.h"
+#include "test_sampler.h"
+#include "test_texture.h"
 
 typedef struct {
 	char *test_name;
@@ -76,6 +84,7 @@ static test tests[] = {
 	{"vector::vecEquals", vector_vecequals},
 	{"vector::randomOnUnitSphere", vector_random_on_sphere},
 	{"vector::reflect", vector_reflect},
+	{"vector::tangentFrame", vector_tangent_frame},
 	
 	{"transforms::transpose", transform_transpose},
 	{"transforms::multiply", transform_multiply},
@@ -156,6 +165,13 @@ static test tests[] = {
 	{"mathnode::tangent", mathnode_tangent},
 	{"mathnode::toradians", mathnode_toradians},
 	{"mathnode::todegrees", mathnode_todegrees},
+	{"bsdfnode::eval_pdf", bsdfnode_eval_pdf},
+	{"bsdfnode::microfacet", bsdfnode_microfacet},
+	{"bsdfnode::mix_dimensions", bsdfnode_mix_dimensions},
+	{"bsdfnode::add_emission", bsdfnode_add_emission},
+	{"bsdfnode::alpha_mask", alpha_mask},
+	{"envmap::sample_pdf", envmap_sample_pdf},
+	{"envmap::wanted", envmap_wanted},
 	
 	{"vecmath::vecAdd", vecmath_vecAdd},
 	{"vecmath::vecSubtract", vecmath_vecSubtract},
@@ -169,6 +185,13 @@ static test tests[] = {
 	{"vecmath::vecScale", vecmath_vecScale},
 	
 	{"map_range::map", map_range},
+	{"program::compile", program_compile},
+	{"program::fold", program_fold},
+	{"color_ramp::lut", color_ramp_lut},
+	{"color_ramp::stops", color_ramp_stops},
+	{"cache::node", cache_node},
+	{"image::srgb_mips", image_srgb_mips},
+	{"alpha::cutout_procedural", alpha_cutout_procedural},
 
 	{"linked_list::basic", llist_basic},
 	{"linked_list::remove_cb", llist_remove_cb},
@@ -189,6 +212,26 @@ static test tests[] = {
 	{"serializer::serialize", serializer_serialize},
 
 	{"threadpool::basic", test_thread_pool},
+
+	{"tile::hilbert", tile_hilbert},
+	{"tile::morton", tile_morton},
+
+	{"accumulator::retire", accumulator_retire},
+	{"accumulator::max_samples", accumulator_max_samples},
+	{"accumulator::median_of_means", accumulator_median_of_means},
+	{"accumulator::aov", accumulator_aov},
+	{"light_bvh::pmf_sum", light_bvh_pmf_sum},
+	{"light_bvh::nearby", light_bvh_nearby},
+	{"light_bvh::edge_on", light_bvh_edge_on},
+	{"lights::mis_smooth_mesh", lights_mis_smooth_mesh},
+	{"sampler::pseudorandom", test_pseudorandom},
+	{"sampler::sobol", sampler_sobol},
+	{"sampler::halton_deep", sampler_halton_deep},
+	{"sampler::error_per_sample", sampler_error_per_sample},
+	{"guiding::learns", guiding_learns},
+	{"guiding::sample_pdf", guiding_sample_pdf},
+	{"denoise::smooths_and_keeps_edges", denoise_smooths_and_keeps_edges},
+	{"texture::mips", texture_mips},
 };
 
 #define testCount (sizeof(tests) / sizeof(test))